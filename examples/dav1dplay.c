@@ -561,7 +561,7 @@ static int decoder_thread_main(void *cookie)
 
     if ((res = input_open(&in_ctx, "ivf",
                           settings.inputfile,
-                          fps, &total, timebase)) < 0)
+                          fps, &total, timebase, 0)) < 0)
     {
         fprintf(stderr, "Failed to open demuxer\n");
         res = 1;
@@ -42,6 +42,7 @@ extern "C" {
 
 typedef struct Dav1dContext Dav1dContext;
 typedef struct Dav1dRef Dav1dRef;
+typedef struct Dav1dThreadPool Dav1dThreadPool;
 
 #define DAV1D_MAX_THREADS 256
 #define DAV1D_MAX_FRAME_DELAY 256
@@ -58,6 +59,67 @@ typedef struct Dav1dLogger {
     void (*callback)(void *cookie, const char *format, va_list ap);
 } Dav1dLogger;
 
+typedef struct Dav1dPictureNotifier {
+    void *cookie; ///< Custom data to pass to the callback.
+    /**
+     * Picture-ready callback. May be NULL to disable the callback.
+     *
+     * Called when a picture (or a decoding error) can be retrieved with
+     * dav1d_get_picture(), either from a worker thread, with internal locks
+     * held, or from within dav1d_send_data(). It must therefore return
+     * quickly and not call any function of the decoder instance; typically
+     * it wakes up the thread which does.
+     *
+     * @param cookie Custom pointer passed to all calls.
+     */
+    void (*callback)(void *cookie);
+} Dav1dPictureNotifier;
+
+enum Dav1dTaskTraceType {
+    DAV1D_TASKTRACE_INIT,
+    DAV1D_TASKTRACE_INIT_CDF,
+    DAV1D_TASKTRACE_TILE_ENTROPY,
+    DAV1D_TASKTRACE_ENTROPY_PROGRESS,
+    DAV1D_TASKTRACE_TILE_RECONSTRUCTION,
+    DAV1D_TASKTRACE_DEBLOCK_COLS,
+    DAV1D_TASKTRACE_DEBLOCK_ROWS,
+    DAV1D_TASKTRACE_CDEF,
+    DAV1D_TASKTRACE_SUPER_RESOLUTION,
+    DAV1D_TASKTRACE_LOOP_RESTORATION,
+    DAV1D_TASKTRACE_RECONSTRUCTION_PROGRESS,
+    DAV1D_TASKTRACE_FG_PREP,
+    DAV1D_TASKTRACE_FG_APPLY,
+};
+
+typedef struct Dav1dTaskTraceEvent {
+    uint64_t start; ///< start time of the task, in nanoseconds (monotonic clock)
+    uint64_t end; ///< end time of the task, in nanoseconds (monotonic clock)
+    unsigned thread_id; ///< index of the worker which executed the task
+    unsigned frame_idx; ///< frame thread slot of the frame the task belongs to
+                        ///< (UINT_MAX for film grain)
+    int sby; ///< superblock row of the task (-1 for film grain)
+    int64_t timestamp; ///< timestamp of the frame the task belongs to
+    enum Dav1dTaskTraceType type; ///< kind of work executed
+} Dav1dTaskTraceEvent;
+
+typedef struct Dav1dTaskTracer {
+    void *cookie; ///< Custom data to pass to the callback.
+    /**
+     * Trace callback, called once for each task executed by the worker
+     * threads, or for each decoding stage of an sbrow when decoding with a
+     * single thread. May be NULL to disable tracing. Only used if the library
+     * was built with tracing support (-Dtrace=true).
+     *
+     * @note This is called concurrently from all worker threads, possibly
+     *       while holding internal locks, so it must be thread-safe and
+     *       should return quickly.
+     *
+     * @param cookie Custom pointer passed to all calls.
+     * @param  event The task which was executed.
+     */
+    void (*callback)(void *cookie, const Dav1dTaskTraceEvent *event);
+} Dav1dTaskTracer;
+
 enum Dav1dInloopFilterType {
     DAV1D_INLOOPFILTER_NONE        = 0,
     DAV1D_INLOOPFILTER_DEBLOCK     = 1 << 0,
@@ -75,6 +137,26 @@ enum Dav1dDecodeFrameType {
     DAV1D_DECODEFRAMETYPE_KEY   = 3, ///< decode and return keyframes only
 };
 
+enum Dav1dThreadPlacement {
+    DAV1D_THREADPLACEMENT_NONE = 0, ///< let the OS schedule worker threads freely
+    DAV1D_THREADPLACEMENT_NUMA = 1, ///< group worker threads and frame memory per NUMA node
+    DAV1D_THREADPLACEMENT_L3   = 2, ///< group worker threads per shared last-level cache,
+                                    ///< and frame memory per NUMA node
+};
+
+enum Dav1dThreadPinning {
+    DAV1D_THREADPINNING_NONE = 0, ///< worker threads may run on any CPU of their set
+    DAV1D_THREADPINNING_CPU  = 1, ///< each worker thread is pinned to a single CPU of its set,
+                                  ///< assigned round-robin
+};
+
+enum Dav1dThreadPriority {
+    DAV1D_THREADPRIORITY_DEFAULT = 0, ///< same as the thread calling dav1d_open()
+    DAV1D_THREADPRIORITY_LOW     = 1, ///< below normal (nice +10 on Linux)
+    DAV1D_THREADPRIORITY_IDLE    = 2, ///< only run when the CPU is otherwise idle (SCHED_IDLE
+                                      ///< on Linux)
+};
+
 typedef struct Dav1dSettings {
     int n_threads; ///< number of threads (0 = number of logical cores in host system, default 0)
     int max_frame_delay; ///< Set to 1 for low-latency decoding (0 = ceil(sqrt(n_threads)), default 0)
@@ -95,6 +177,73 @@ typedef struct Dav1dSettings {
                                                ///< DAV1D_INLOOPFILTER_ALL)
     enum Dav1dDecodeFrameType decode_frame_type; ///< frame types to decode (default
                                                  ///< DAV1D_DECODEFRAMETYPE_ALL)
+    Dav1dThreadPool *thread_pool; ///< worker pool shared with other decoder instances, created
+                                  ///< with dav1d_thread_pool_create() (NULL = spawn dedicated
+                                  ///< worker threads, default NULL)
+    Dav1dTaskTracer tracer; ///< Task trace callback.
+    size_t picture_pool_limit; ///< maximum size in bytes of unused picture buffers kept for
+                               ///< reuse at resolutions other than the most recent one, which
+                               ///< avoids reallocations for streams switching between
+                               ///< several resolutions; only used by the default picture
+                               ///< allocator (0 = release them on resolution change, default 0)
+    size_t memory_budget; ///< upper bound in bytes of the memory held by the decoder, which
+                          ///< includes the input data allocated by dav1d_data_create() and
+                          ///< the metadata of output pictures until they are freed, but not
+                          ///< pictures from a custom allocator nor a shared thread_pool; the
+                          ///< frame delay, frame size limit (lower for high bit-depth content)
+                          ///< and picture pool retention are reduced to fit and allocations
+                          ///< that would exceed it fail with DAV1D_ERR(ENOMEM) (0 = unlimited,
+                          ///< default 0)
+    int output_downscale; ///< output pictures at a reduced resolution, downscaled by a factor of
+                          ///< 1 << output_downscale (0 = full resolution, 1 = 1/2, 2 = 1/4,
+                          ///< 3 = 1/8, default 0); film grain is not applied to such pictures
+    enum Dav1dThreadPlacement thread_placement; ///< topology-aware placement of worker threads,
+                                                ///< which are pinned to the CPUs of their group,
+                                                ///< and of the memory of the frames they decode;
+                                                ///< only supported on Linux and ignored with a
+                                                ///< thread_pool (default DAV1D_THREADPLACEMENT_NONE)
+    const int *thread_cpus; ///< indices of the CPUs worker threads may run on, intersected
+                            ///< with the affinity of the thread calling dav1d_open(); only
+                            ///< supported on Linux (NULL = no restriction, default NULL)
+    int n_thread_cpus; ///< number of entries in thread_cpus (default 0)
+    enum Dav1dThreadPinning thread_pinning; ///< whether to pin each worker thread to a single
+                                            ///< CPU; only supported on Linux (default
+                                            ///< DAV1D_THREADPINNING_NONE)
+    enum Dav1dThreadPriority thread_priority; ///< scheduling priority of worker threads, only
+                                              ///< supported on Linux and Windows (default
+                                              ///< DAV1D_THREADPRIORITY_DEFAULT)
+    unsigned latency_target_ms; ///< adapt the number of frames decoded in parallel, up to the
+                                ///< frame delay, to the measured decoding and input rates so
+                                ///< that pictures are output within this many milliseconds of
+                                ///< their data being sent (0 = disabled, default 0)
+    unsigned latency_target_frames; ///< same as latency_target_ms but expressed as a number of
+                                    ///< frames, both targets being met if both are set
+                                    ///< (0 = disabled, default 0)
+    unsigned min_fps; ///< throughput floor in frames per second when adapting to a latency
+                      ///< target, which is exceeded when needed to sustain it (0 = none,
+                      ///< default 0)
+    Dav1dPictureNotifier picture_notifier; ///< Picture-ready callback.
+    int picture_eventfd; ///< signal an eventfd, retrieved with dav1d_get_picture_fd(), when a
+                         ///< picture can be retrieved; only supported on Linux (default 0)
+    int early_output; ///< with frame threading, return pictures from dav1d_get_picture() while
+                      ///< they are still being decoded, as soon as their data was consumed;
+                      ///< dav1d_get_picture_progress() tells how much of them is final. Not
+                      ///< applied to pictures with film grain to apply, when downscaling or
+                      ///< when only outputting the highest spatial layer (default 0)
+    int early_tile_groups; ///< start decoding a frame as soon as its first tile group was
+                           ///< received, instead of waiting for the whole frame, so that the
+                           ///< tile groups can be sent with dav1d_send_data() as they arrive;
+                           ///< its picture is only output once all of them were received. Not
+                           ///< applied when skipping frames with decode_frame_type (default 0)
+    int step_decoding; ///< without threading, only decode frames in dav1d_decode_step() calls,
+                       ///< so that the caller controls how long each decoding call takes;
+                       ///< ignored when n_threads is not 1 (default 0)
+    int huge_pages; ///< back the pictures of the default allocator and the large per-frame
+                    ///< buffers with huge pages, which reduces TLB misses at high
+                    ///< resolutions; only supported on Linux, see
+                    ///< dav1d_get_huge_page_usage() (default 0)
+    int stage_times; ///< measure the time spent in each decoding stage, see
+                     ///< dav1d_get_stage_times() (default 0)
     uint8_t reserved[16]; ///< reserved for future use
 } Dav1dSettings;
 
@@ -154,6 +303,49 @@ DAV1D_API int dav1d_open(Dav1dContext **c_out, const Dav1dSettings *s);
 DAV1D_API int dav1d_parse_sequence_header(Dav1dSequenceHeader *out,
                                           const uint8_t *buf, const size_t sz);
 
+typedef struct Dav1dFrameInfo {
+    int temporal_id, spatial_id; ///< from the OBU extension header, or 0
+    int show_existing_frame;
+    int existing_frame_idx; ///< reference slot shown if show_existing_frame is set
+    /**
+     * The fields below are only valid if show_existing_frame is not set. The
+     * type of a shown existing frame is that of the frame which was stored in
+     * existing_frame_idx, and if that is a key frame, showing it refreshes
+     * all reference slots.
+     */
+    enum Dav1dFrameType frame_type;
+    int show_frame, showable_frame;
+    int frame_offset; ///< order hint
+    uint8_t refresh_frame_flags; ///< reference slots updated by this frame
+} Dav1dFrameInfo;
+
+/**
+ * Parse the first frame header from bitstream data, without decoding it and
+ * without requiring a decoder instance. This is meant for scanning a stream
+ * for random access points, e.g. to build a seek index.
+ *
+ * @param     out Output frame information.
+ * @param seq_hdr Sequence Header in effect for the data, e.g. as returned by
+ *                dav1d_parse_sequence_header().
+ * @param     buf The data to be parsed.
+ * @param      sz Size of the data.
+ *
+ * @return
+ *                 >0: Success, and out is filled with the frame information.
+ *                     The return value is the number of bytes up to the end
+ *                     of the OBU carrying the frame header, so that the next
+ *                     one can be parsed by calling this function again on the
+ *                     remaining data.
+ *  DAV1D_ERR(ENOENT): No Frame Header OBUs were found in the buffer.
+ *  Other negative DAV1D_ERR codes: Invalid data in the buffer, invalid passed-in
+ *                                  arguments, and other errors during parsing.
+ *
+ * @note Redundant Frame Header OBUs are skipped.
+ */
+DAV1D_API int dav1d_parse_frame_info(Dav1dFrameInfo *out,
+                                     const Dav1dSequenceHeader *seq_hdr,
+                                     const uint8_t *buf, size_t sz);
+
 /**
  * Feed bitstream data to the decoder, in the form of one or multiple AV1
  * Open Bitstream Units (OBUs).
@@ -225,6 +417,49 @@ DAV1D_API int dav1d_send_data(Dav1dContext *c, Dav1dData *in);
  */
 DAV1D_API int dav1d_get_picture(Dav1dContext *c, Dav1dPicture *out);
 
+/**
+ * Get the number of rows of a picture returned by dav1d_get_picture() which
+ * are final, including all post-filters, when early_output is set in the
+ * settings. Other pictures are always complete.
+ *
+ * The count is in luma rows, starting from the top of the picture; chroma
+ * rows are final up to the corresponding subsampled position. It increases
+ * as decoding progresses, by steps of one superblock row.
+ *
+ * @param p Picture returned by dav1d_get_picture().
+ *
+ * @return The number of final luma rows, equal to p->p.h once the picture is
+ *         complete, or DAV1D_ERR(EINVAL) on invalid argument or if decoding
+ *         the picture failed (the error is then also returned by a later call
+ *         to dav1d_get_picture()).
+ */
+DAV1D_API int dav1d_get_picture_progress(const Dav1dPicture *p);
+
+/**
+ * Decode the current frame for a limited time, when step_decoding is set in
+ * the settings.
+ *
+ * dav1d_send_data() then only parses the data of a frame and returns, and
+ * the frame is decoded by calling this function until it returns 0. Its
+ * picture can then be retrieved with dav1d_get_picture(), which returns
+ * DAV1D_ERR(EAGAIN) meanwhile, before the data of the next frame is parsed.
+ * Decoding stops at the end of a superblock row once the time budget is used
+ * up, and resumes from there in the next call; at least one superblock row is
+ * decoded in each call, so a call can exceed a budget which is too small.
+ *
+ * @param         c Input decoder instance.
+ * @param budget_us Time budget in microseconds.
+ *
+ * @return
+ *         1: The budget was used up before the frame was decoded, call this
+ *            function again to continue.
+ *         0: The frame was decoded, or no frame can be decoded until more
+ *            data is sent (e.g. its missing tile groups when
+ *            early_tile_groups is set).
+ *   other negative DAV1D_ERR codes: Decoding the frame failed.
+ */
+DAV1D_API int dav1d_decode_step(Dav1dContext *c, unsigned budget_us);
+
 /**
  * Apply film grain to a previously decoded picture. If the picture contains no
  * film grain metadata, then this function merely returns a new reference.
@@ -265,6 +500,36 @@ DAV1D_API void dav1d_close(Dav1dContext **c_out);
  */
 DAV1D_API void dav1d_flush(Dav1dContext *c);
 
+/**
+ * Change the threading settings of a decoder instance without resetting its
+ * decoding state, e.g. to adapt the thread count or frame delay to the load
+ * of the system while decoding a stream.
+ *
+ * The n_threads, max_frame_delay, thread_pool, thread_placement,
+ * thread_cpus, thread_pinning and thread_priority fields of s are applied.
+ * The other fields must hold the values which were passed to dav1d_open();
+ * the frame size limit and picture pool limit are derived from them again
+ * for the memory budget, which cannot be changed.
+ *
+ * The change can only be made once all data has been decoded and all
+ * pictures have been returned. Reference frames, entropy contexts and
+ * headers are kept, so decoding continues with the next temporal unit.
+ *
+ * @param c Input decoder instance.
+ * @param s Settings to apply.
+ *
+ * @return
+ *         0: Success, the new settings are in effect.
+ *  DAV1D_ERR(EAGAIN): Data or pictures are still pending; call
+ *                     dav1d_get_picture() until it returns DAV1D_ERR(EAGAIN)
+ *                     and retry.
+ *   Other negative DAV1D_ERR codes: Invalid settings or allocation failure.
+ *                                   After an allocation failure the decoder
+ *                                   falls back to a single thread, or can
+ *                                   only be closed if that fails too.
+ */
+DAV1D_API int dav1d_reconfigure(Dav1dContext *c, const Dav1dSettings *s);
+
 enum Dav1dEventFlags {
     /**
      * The last returned picture contains a reference to a new Sequence Header,
@@ -294,6 +559,26 @@ enum Dav1dEventFlags {
  */
 DAV1D_API int dav1d_get_event_flags(Dav1dContext *c, enum Dav1dEventFlags *flags);
 
+/**
+ * Get the eventfd signaled when a picture can be retrieved, for use in a
+ * poll()/epoll() based event loop (requires picture_eventfd in the settings).
+ *
+ * The descriptor is non-blocking and owned by the decoder, which closes it in
+ * dav1d_close(). It becomes readable whenever a picture (or a decoding error)
+ * is available, at the same times the picture_notifier callback is invoked.
+ * Read it to reset it, then call dav1d_get_picture() until it returns
+ * DAV1D_ERR(EAGAIN), since several pictures may be ready per notification.
+ *
+ * @note With frame threading, pictures of frames which have finished decoding
+ *       are returned by dav1d_get_picture() without waiting for the frame
+ *       delay to be reached if notifications are enabled.
+ *
+ * @param c Input decoder instance.
+ *
+ * @return The file descriptor, or < 0 (a negative DAV1D_ERR code) on error.
+ */
+DAV1D_API int dav1d_get_picture_fd(Dav1dContext *c);
+
 /**
  * Retrieve the user-provided metadata associated with the input data packet
  * for the last decoding error reported to the user, i.e. a negative return
@@ -322,6 +607,260 @@ DAV1D_API int dav1d_get_decode_error_data_props(Dav1dContext *c, Dav1dDataProps
  */
 DAV1D_API int dav1d_get_frame_delay(const Dav1dSettings *s);
 
+typedef struct Dav1dPicturePoolStats {
+    uint64_t hits; ///< picture allocations served with a buffer from the pool
+    uint64_t misses; ///< picture allocations which required a new buffer
+    size_t bytes_resident; ///< size of the unused buffers currently held by the pool
+} Dav1dPicturePoolStats;
+
+/**
+ * Get usage statistics of the picture buffer pool of the default picture
+ * allocator.
+ *
+ * @param   c Input decoder instance.
+ * @param out Where to write the statistics.
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error, e.g.
+ *         DAV1D_ERR(ENOENT) if the decoder uses a custom picture allocator.
+ */
+DAV1D_API int dav1d_get_picture_pool_stats(Dav1dContext *c, Dav1dPicturePoolStats *out);
+
+enum Dav1dMemoryType {
+    DAV1D_MEMORY_BLOCK,      ///< per-block mode info
+    DAV1D_MEMORY_CDEF,       ///< CDEF line buffers
+    DAV1D_MEMORY_CDF,        ///< CDF contexts
+    DAV1D_MEMORY_COEF,       ///< coefficient data
+    DAV1D_MEMORY_COMMON_CTX, ///< decoder context
+    DAV1D_MEMORY_DAV1DDATA,  ///< input data references
+    DAV1D_MEMORY_IPRED,      ///< intra prediction edges
+    DAV1D_MEMORY_LF,         ///< loopfilter masks and levels
+    DAV1D_MEMORY_LR,         ///< loop restoration line buffers
+    DAV1D_MEMORY_OBU_HDR,    ///< sequence and frame headers
+    DAV1D_MEMORY_OBU_META,   ///< metadata OBUs
+    DAV1D_MEMORY_PAL,        ///< palette data
+    DAV1D_MEMORY_PIC,        ///< picture buffers
+    DAV1D_MEMORY_PIC_CTX,    ///< picture contexts
+    DAV1D_MEMORY_REFMVS,     ///< motion vectors of reference frames
+    DAV1D_MEMORY_SEGMAP,     ///< segmentation maps
+    DAV1D_MEMORY_THREAD_CTX, ///< frame and task contexts
+    DAV1D_MEMORY_TILE,       ///< tile data
+    DAV1D_MEMORY_NUM_TYPES,
+};
+
+typedef struct Dav1dMemoryTypeStats {
+    size_t current; ///< accounted bytes
+    size_t peak; ///< highest value of current since the decoder was opened
+    uint64_t pool_hits; ///< allocations served with a buffer from a pool
+    uint64_t pool_misses; ///< pooled allocations which required a new buffer
+} Dav1dMemoryTypeStats;
+
+typedef struct Dav1dMemoryStats {
+    size_t current; ///< sum of all accounted memory
+    size_t peak; ///< highest value of current since the decoder was opened
+    Dav1dMemoryTypeStats type[DAV1D_MEMORY_NUM_TYPES]; ///< per enum Dav1dMemoryType
+} Dav1dMemoryStats;
+
+/**
+ * Get statistics of the memory accounted to the decoder, i.e. the memory
+ * bounded by Dav1dSettings.memory_budget, including the peak usage and the
+ * hit rate of the internal buffer pools. These are always collected, and
+ * retrieving them is cheap enough to be done periodically, e.g. to detect
+ * leaks or to tune Dav1dSettings.picture_pool_limit.
+ *
+ * @param   c Input decoder instance.
+ * @param out Where to write the statistics.
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error.
+ */
+DAV1D_API int dav1d_get_memory_stats(Dav1dContext *c, Dav1dMemoryStats *out);
+
+typedef struct Dav1dStageTimes {
+    uint64_t parse; ///< parsing of OBUs and headers by the thread calling the API
+    uint64_t task[DAV1D_TASKTRACE_FG_APPLY + 1]; ///< per enum Dav1dTaskTraceType
+} Dav1dStageTimes;
+
+/**
+ * Get the time spent in each decoding stage since the decoder was opened, in
+ * nanoseconds summed over all threads, whichever thread executed it. Only
+ * measured if Dav1dSettings.stage_times was set, and independent of tracing
+ * support. Film grain applied without worker threads is accounted entirely
+ * to DAV1D_TASKTRACE_FG_APPLY.
+ *
+ * @note The times are only exact when no decoding is in progress, e.g. after
+ *       the decoder was drained.
+ *
+ * @param   c Input decoder instance.
+ * @param out Where to write the times.
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error.
+ */
+DAV1D_API int dav1d_get_stage_times(Dav1dContext *c, Dav1dStageTimes *out);
+
+enum Dav1dTrimLevel {
+    DAV1D_TRIMLEVEL_POOLS, ///< unused buffers kept for reuse by the internal pools
+    DAV1D_TRIMLEVEL_FRAME_BUFFERS, ///< also the scratch buffers used to decode frames
+};
+
+/**
+ * Release memory held by a decoder instance which is idle, e.g. because its
+ * stream is paused, without losing its decoding state. Reference frames and
+ * entropy contexts are kept, and the released buffers are allocated again
+ * when decoding the next frames.
+ *
+ * @param     c Input decoder instance.
+ * @param level What to release.
+ *
+ * @return
+ *         0: Success.
+ *  DAV1D_ERR(EAGAIN): level is DAV1D_TRIMLEVEL_FRAME_BUFFERS and frames are
+ *                     still being decoded; only the pools were trimmed. Call
+ *                     dav1d_get_picture() until it returns DAV1D_ERR(EAGAIN)
+ *                     and retry.
+ *   Other negative DAV1D_ERR codes: Invalid arguments.
+ */
+DAV1D_API int dav1d_trim_memory(Dav1dContext *c, enum Dav1dTrimLevel level);
+
+/**
+ * Allocate and fault in the picture buffers, pools and per-frame buffers for
+ * a stream ahead of decoding it, so that the first frames are decoded at the
+ * same speed as the following ones. Buffers are sized for frames of the
+ * maximum dimensions, bit depth and chroma layout of the sequence header, and
+ * picture buffers are only prepared when using the default picture allocator.
+ *
+ * @param       c Input decoder instance.
+ * @param seq_hdr Sequence header of the stream, e.g. from container
+ *                extradata parsed with dav1d_parse_sequence_header().
+ *
+ * @return
+ *         0: Success.
+ *  DAV1D_ERR(EAGAIN): Frames are still being decoded. Call
+ *                     dav1d_get_picture() until it returns DAV1D_ERR(EAGAIN)
+ *                     and retry.
+ *  DAV1D_ERR(ERANGE): The maximum frame size exceeds frame_size_limit.
+ *  Other negative DAV1D_ERR codes: Invalid arguments or allocation failure.
+ */
+DAV1D_API int dav1d_prepare(Dav1dContext *c, const Dav1dSequenceHeader *seq_hdr);
+
+typedef struct Dav1dHugePageUsage {
+    size_t requested; ///< bytes of buffers allocated for huge pages
+    size_t backed; ///< part of requested actually backed by huge pages
+} Dav1dHugePageUsage;
+
+/**
+ * Get how much of the memory allocated for huge pages (see
+ * Dav1dSettings.huge_pages) by all decoder instances of the process is
+ * actually backed by huge pages. Transparent huge pages are only allocated
+ * when the memory is first touched and if the kernel finds free ones, so
+ * backed can be lower than requested. This queries the kernel, and is too
+ * slow to be called for every picture.
+ *
+ * @param out Where to write the usage in bytes.
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error.
+ */
+DAV1D_API int dav1d_get_huge_page_usage(Dav1dHugePageUsage *out);
+
+typedef struct Dav1dWorkerInfo {
+    int64_t os_thread_id; ///< thread id assigned by the OS (Linux TID), or 0 if unknown
+    int cpu; ///< CPU the worker is pinned to, or -1 if it may run on several
+    int n_cpus; ///< number of CPUs the worker may run on, or 0 if unknown
+    int node; ///< NUMA node of the frames the worker prefers, or -1 if none
+} Dav1dWorkerInfo;
+
+/**
+ * Get the placement of the worker threads of a decoder instance, as set up
+ * by the thread_cpus, thread_pinning and thread_placement settings.
+ *
+ * @param     c Input decoder instance.
+ * @param   out Array receiving information about each worker thread.
+ * @param n_out Number of entries in out.
+ *
+ * @return The number of worker threads (0 if the decoder is single-threaded
+ *         or uses a shared thread pool), of which the first min(n_out,
+ *         return value) are written to out, or < 0 (a negative DAV1D_ERR
+ *         code) on error.
+ */
+DAV1D_API int dav1d_get_worker_info(Dav1dContext *c, Dav1dWorkerInfo *out, int n_out);
+
+/**
+ * Create a pool of worker threads which can be shared by multiple decoder
+ * instances through Dav1dSettings.thread_pool. Tasks of all attached
+ * decoders are scheduled round-robin on the pool's workers, so that no
+ * single stream can starve the others.
+ *
+ * @param pool_out The pool to create. *pool_out will be set to the allocated
+ *                 pool.
+ * @param n_threads Number of worker threads (0 = number of logical cores in
+ *                  host system).
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error.
+ *
+ * @note The pool must be freed using dav1d_thread_pool_destroy() after all
+ *       decoder instances using it have been closed.
+ */
+DAV1D_API int dav1d_thread_pool_create(Dav1dThreadPool **pool_out, int n_threads);
+
+typedef struct Dav1dTaskExecutor {
+    void *cookie; ///< Custom data to pass to the callback.
+    /**
+     * Called whenever decoding tasks became runnable, to which the executor
+     * should respond by scheduling a call to dav1d_run_task() on one of its
+     * threads.
+     *
+     * @note This is called from any thread calling into the library or
+     *       running dav1d_run_task(), possibly while holding internal locks,
+     *       so it must not call back into the library and should return
+     *       quickly.
+     *
+     * @param cookie Custom pointer passed to all calls.
+     */
+    void (*task_available)(void *cookie);
+} Dav1dTaskExecutor;
+
+/**
+ * Create a thread pool without worker threads, whose tasks are run by the
+ * application on its own threads instead, through dav1d_run_task(). It is
+ * used by decoder instances like any other pool (through
+ * Dav1dSettings.thread_pool), so that dav1d_open() spawns no threads.
+ *
+ * @param  pool_out The pool to create. *pool_out will be set to the allocated
+ *                  pool.
+ * @param n_threads Maximum number of threads running dav1d_run_task()
+ *                  concurrently (0 = number of logical cores in host system).
+ * @param  executor Callback notifying the application of runnable tasks.
+ *
+ * @return 0 on success, or < 0 (a negative DAV1D_ERR code) on error.
+ *
+ * @note dav1d_send_data() and dav1d_get_picture() may wait for tasks to
+ *       complete, so the tasks must be run on threads other than those
+ *       calling these functions. The threads running tasks need a stack of
+ *       at least 1 MB.
+ */
+DAV1D_API int dav1d_thread_pool_create_external(Dav1dThreadPool **pool_out,
+                                                int n_threads,
+                                                const Dav1dTaskExecutor *executor);
+
+/**
+ * Run decoding tasks of the decoder instances attached to a pool created with
+ * dav1d_thread_pool_create_external(), on the calling thread. At most a
+ * limited number of tasks of each decoder instance are run per call.
+ *
+ * @param pool The pool to run tasks of.
+ *
+ * @return The number of tasks which were run, in which case more may be
+ *         runnable and the function should be called again, 0 if there was
+ *         nothing to run until the next call of the task_available callback,
+ *         or < 0 (a negative DAV1D_ERR code) on error.
+ */
+DAV1D_API int dav1d_run_task(Dav1dThreadPool *pool);
+
+/**
+ * Stop the worker threads of a pool and free it.
+ *
+ * @param pool The pool to destroy. *pool will be set to NULL.
+ */
+DAV1D_API void dav1d_thread_pool_destroy(Dav1dThreadPool **pool);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -27,6 +27,8 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include "src/cpu.h"
 #include "src/log.h"
@@ -103,3 +105,96 @@ COLD int dav1d_num_logical_processors(Dav1dContext *const c) {
         dav1d_log(c, "Unable to detect thread count, defaulting to single-threaded mode\n");
     return 1;
 }
+
+#if HAVE_CPU_PLACEMENT
+// parses a sysfs CPU or node list, e.g. "0-3,8-11"
+static COLD int read_cpu_list(const char *const path, cpu_set_t *const set) {
+    FILE *const f = fopen(path, "r");
+    if (!f) return -1;
+    char buf[4096];
+    const int res = !fgets(buf, sizeof(buf), f);
+    fclose(f);
+    if (res) return -1;
+
+    CPU_ZERO(set);
+    for (const char *p = buf; *p && *p != '\n';) {
+        char *end;
+        const unsigned long first = strtoul(p, &end, 10);
+        if (end == p) return -1;
+        unsigned long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        for (unsigned long n = first; n <= last && n < CPU_SETSIZE; n++)
+            CPU_SET(n, set);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return 0;
+}
+
+// finds the CPUs sharing the highest level cache with cpu
+static COLD int read_llc_cpus(const int cpu, cpu_set_t *const set) {
+    int best_level = 0;
+    for (int idx = 0; idx < 16; idx++) {
+        char path[128];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, idx);
+        FILE *const f = fopen(path, "r");
+        if (!f) break;
+        int level;
+        const int res = fscanf(f, "%d", &level);
+        fclose(f);
+        if (res != 1 || level <= best_level) continue;
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, idx);
+        if (!read_cpu_list(path, set)) best_level = level;
+    }
+    return best_level ? 0 : -1;
+}
+
+COLD int dav1d_get_cpu_domains(Dav1dCpuDomain *const domains, const int max_domains,
+                               const enum Dav1dThreadPlacement placement,
+                               const cpu_set_t *const allowed)
+{
+    cpu_set_t nodes, set;
+
+    int cpu_node[CPU_SETSIZE];
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        cpu_node[cpu] = -1;
+    int n = 0;
+    if (!read_cpu_list("/sys/devices/system/node/online", &nodes)) {
+        for (int node = 0; node < CPU_SETSIZE; node++) {
+            if (!CPU_ISSET(node, &nodes)) continue;
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            if (read_cpu_list(path, &set)) return 0;
+            CPU_AND(&set, &set, allowed);
+            if (!CPU_COUNT(&set)) continue;
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set)) cpu_node[cpu] = node;
+            if (placement == DAV1D_THREADPLACEMENT_NUMA) {
+                if (n == max_domains) return 0;
+                domains[n].cpus = set;
+                domains[n++].node = node;
+            }
+        }
+    }
+    if (placement == DAV1D_THREADPLACEMENT_NUMA) return n;
+
+    cpu_set_t assigned;
+    CPU_ZERO(&assigned);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, allowed) || CPU_ISSET(cpu, &assigned)) continue;
+        if (read_llc_cpus(cpu, &set) || n == max_domains) return 0;
+        CPU_SET(cpu, &set);
+        CPU_AND(&set, &set, allowed);
+        CPU_OR(&assigned, &assigned, &set);
+        domains[n].cpus = set;
+        domains[n++].node = cpu_node[cpu];
+    }
+    return n;
+}
+#endif
+
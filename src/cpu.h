@@ -54,6 +54,27 @@ void dav1d_init_cpu(void);
 DAV1D_API void dav1d_set_cpu_flags_mask(unsigned mask);
 int dav1d_num_logical_processors(Dav1dContext *c);
 
+#if defined(__linux__) && defined(HAVE_PTHREAD_SETAFFINITY_NP)
+#define HAVE_CPU_PLACEMENT 1
+#include <sched.h>
+
+typedef struct Dav1dCpuDomain {
+    cpu_set_t cpus; // CPUs of the domain usable by the process
+    int node; // NUMA node local to these CPUs, -1 if unknown
+} Dav1dCpuDomain;
+
+/*
+ * Partition the CPUs in allowed into NUMA nodes or L3 cache domains, as
+ * described by sysfs. Returns the number of domains written to domains, or
+ * 0 if the topology can't be determined.
+ */
+int dav1d_get_cpu_domains(Dav1dCpuDomain *domains, int max_domains,
+                          enum Dav1dThreadPlacement placement,
+                          const cpu_set_t *allowed);
+#else
+#define HAVE_CPU_PLACEMENT 0
+#endif
+
 static ALWAYS_INLINE unsigned dav1d_get_cpu_flags(void) {
     unsigned flags = dav1d_cpu_flags & dav1d_cpu_flags_mask;
 
@@ -69,6 +69,9 @@ int dav1d_data_wrap_internal(Dav1dData *const buf, const uint8_t *const ptr,
     if (!ref) return DAV1D_ERR(ENOMEM);
 
     buf->ref = dav1d_ref_init(ref, ptr, free_callback, cookie, 1);
+    // the wrapped data itself isn't owned by dav1d
+    ref->alloc_sz = sizeof(Dav1dRef);
+    ref->alloc_type = ALLOC_DAV1DDATA;
     buf->data = ptr;
     buf->sz = sz;
     dav1d_data_props_set_defaults(&buf->m);
@@ -49,6 +49,7 @@
 #include "src/ref.h"
 #include "src/tables.h"
 #include "src/thread_task.h"
+#include "src/trace.h"
 #include "src/warpmv.h"
 
 static void init_quant_tables(const Dav1dSequenceHeader *const seq_hdr,
@@ -701,7 +702,7 @@ static int decode_b(Dav1dTaskContext *const t,
     Dav1dTileState *const ts = t->ts;
     const Dav1dFrameContext *const f = t->f;
     Av1Block b_mem, *const b = t->frame_thread.pass ?
-        &f->frame_thread.b[t->by * f->b4_stride + t->bx] : &b_mem;
+        ts->frame_thread[t->frame_thread.pass & 1].b++ : &b_mem;
     const uint8_t *const b_dim = dav1d_block_dimensions[bs];
     const int bx4 = t->bx & 31, by4 = t->by & 31;
     const int ss_ver = f->cur.p.layout == DAV1D_PIXEL_LAYOUT_I420;
@@ -2164,7 +2165,8 @@ static int decode_sb(Dav1dTaskContext *const t, const enum BlockLevel bl,
 
     if (have_h_split && have_v_split) {
         if (t->frame_thread.pass == 2) {
-            const Av1Block *const b = &f->frame_thread.b[t->by * f->b4_stride + t->bx];
+            // the next block in decoding order is the first one of this node
+            const Av1Block *const b = ts->frame_thread[0].b;
             bp = b->bl == bl ? b->bp : PARTITION_SPLIT;
         } else {
             bp = dav1d_msac_decode_symbol_adapt16(&ts->msac, pc,
@@ -2341,7 +2343,7 @@ static int decode_sb(Dav1dTaskContext *const t, const enum BlockLevel bl,
     } else if (have_h_split) {
         unsigned is_split;
         if (t->frame_thread.pass == 2) {
-            const Av1Block *const b = &f->frame_thread.b[t->by * f->b4_stride + t->bx];
+            const Av1Block *const b = ts->frame_thread[0].b;
             is_split = b->bl != bl;
         } else {
             is_split = dav1d_msac_decode_bool(&ts->msac,
@@ -2369,7 +2371,7 @@ static int decode_sb(Dav1dTaskContext *const t, const enum BlockLevel bl,
         assert(have_v_split);
         unsigned is_split;
         if (t->frame_thread.pass == 2) {
-            const Av1Block *const b = &f->frame_thread.b[t->by * f->b4_stride + t->bx];
+            const Av1Block *const b = ts->frame_thread[0].b;
             is_split = b->bl != bl;
         } else {
             is_split = dav1d_msac_decode_bool(&ts->msac,
@@ -2445,7 +2447,6 @@ static const uint8_t ss_size_mul[4][2] = {
 
 static void setup_tile(Dav1dTileState *const ts,
                        const Dav1dFrameContext *const f,
-                       const uint8_t *const data, const size_t sz,
                        const int tile_row, const int tile_col,
                        const unsigned tile_start_off)
 {
@@ -2458,6 +2459,8 @@ static void setup_tile(Dav1dTileState *const ts,
 
     const uint8_t *const size_mul = ss_size_mul[f->cur.p.layout];
     for (int p = 0; p < 2; p++) {
+        ts->frame_thread[p].b = f->frame_thread.b ?
+            &f->frame_thread.b[tile_start_off / 16] : NULL;
         ts->frame_thread[p].pal_idx = f->frame_thread.pal_idx ?
             &f->frame_thread.pal_idx[(size_t)tile_start_off * size_mul[1] / 8] :
             NULL;
@@ -2474,8 +2477,6 @@ static void setup_tile(Dav1dTileState *const ts,
     ts->last_qidx = f->frame_hdr->quant.yac;
     ts->last_delta_lf.u32 = 0;
 
-    dav1d_msac_init(&ts->msac, data, sz, f->frame_hdr->disable_cdf_update);
-
     ts->tiling.row = tile_row;
     ts->tiling.col = tile_col;
     ts->tiling.col_start = col_sb_start << sb_shift;
@@ -2526,6 +2527,7 @@ static void setup_tile(Dav1dTileState *const ts,
     if (f->c->n_tc > 1) {
         for (int p = 0; p < 2; p++)
             atomic_init(&ts->progress[p], row_sb_start);
+        atomic_init(&ts->recon_waiting, 0);
     }
 }
 
@@ -2622,6 +2624,13 @@ int dav1d_decode_tile_sbrow(Dav1dTaskContext *const t) {
     const int col_sb_start = f->frame_hdr->tiling.col_start_sb[tile_col];
     const int col_sb128_start = col_sb_start >> !f->seq_hdr->sb128;
 
+    // the symbol decoder is set up once the tile data was received
+    if (t->by == ts->tiling.row_start && t->frame_thread.pass != 2) {
+        const struct Dav1dTileData *const td = &f->tile_data[ts - f->ts];
+        dav1d_msac_init(&ts->msac, td->data, td->sz,
+                        f->frame_hdr->disable_cdf_update);
+    }
+
     if (IS_INTER_OR_SWITCH(f->frame_hdr) || f->frame_hdr->allow_intrabc) {
         dav1d_refmvs_tile_sbrow_init(&t->rt, &f->rf, ts->tiling.col_start,
                                      ts->tiling.col_end, ts->tiling.row_start,
@@ -2768,13 +2777,304 @@ int dav1d_decode_tile_sbrow(Dav1dTaskContext *const t) {
            check_trailing_bits_after_symbol_coder(&ts->msac);
 }
 
+// Allocates a frame buffer, to be released with free_frame_buf().
+static void *alloc_frame_buf(const Dav1dFrameContext *const f,
+                             const enum AllocationType type,
+                             const size_t sz, const size_t align)
+{
+    void *const buf = f->c->huge_pages ? dav1d_alloc_huge(f->c->mem, type, sz, align) :
+                                         dav1d_alloc_aligned(type, sz, align);
+    if (buf) dav1d_mem_bind_node(buf, sz, f->task_thread.node);
+    return buf;
+}
+
+// Only goes through the process-wide list of huge page allocations if the
+// decoder uses them.
+static void free_frame_buf(const Dav1dContext *const c, void *const buf) {
+    if (c->huge_pages)
+        dav1d_free_huge(buf);
+    else
+        dav1d_free_aligned(buf);
+}
+
+// Replaces a frame buffer of old_sz bytes (if any) by a new one of sz bytes,
+// charging it to the memory budget.
+static void *realloc_frame_buf(Dav1dFrameContext *const f,
+                               const enum AllocationType type,
+                               void *const old, const size_t old_sz,
+                               const size_t sz, const size_t align)
+{
+    Dav1dMemAccount *const acct = f->c->mem;
+    if (old) {
+        free_frame_buf(f->c, old);
+        dav1d_mem_account_release(acct, type, old_sz);
+    }
+    if (dav1d_mem_account_charge(acct, type, sz)) return NULL;
+    void *const buf = alloc_frame_buf(f, type, sz, align);
+    if (!buf) dav1d_mem_account_release(acct, type, sz);
+    return buf;
+}
+
+static int alloc_block_bufs(Dav1dFrameContext *const f, const int cbi_sz,
+                            const int hbd)
+{
+    if (cbi_sz != f->frame_thread.cbi_sz) {
+        f->frame_thread.cbi =
+            realloc_frame_buf(f, ALLOC_BLOCK, f->frame_thread.cbi,
+                              sizeof(*f->frame_thread.cbi) *
+                              f->frame_thread.cbi_sz * 32 * 32 / 4,
+                              sizeof(*f->frame_thread.cbi) *
+                              cbi_sz * 32 * 32 / 4, 64);
+        if (!f->frame_thread.cbi) {
+            f->frame_thread.cbi_sz = 0;
+            return DAV1D_ERR(ENOMEM);
+        }
+        f->frame_thread.cbi_sz = cbi_sz;
+    }
+
+    // sized for the worst case, but coefficients are packed up to the
+    // eob of each transform block, so that most of it is never touched
+    const int cf_sz = cbi_sz << hbd;
+    if (cf_sz != f->frame_thread.cf_sz) {
+        f->frame_thread.cf =
+            realloc_frame_buf(f, ALLOC_COEF, f->frame_thread.cf,
+                              (size_t)f->frame_thread.cf_sz * 128 * 128 / 2,
+                              (size_t)cf_sz * 128 * 128 / 2, 64);
+        if (!f->frame_thread.cf) {
+            f->frame_thread.cf_sz = 0;
+            return DAV1D_ERR(ENOMEM);
+        }
+        f->frame_thread.cf_sz = cf_sz;
+    }
+    return 0;
+}
+
+static int alloc_cdef_line_buf(Dav1dFrameContext *const f,
+                               const ptrdiff_t y_stride, const ptrdiff_t uv_stride,
+                               const int sbh, const int need_cdef_lpf_copy)
+{
+    if (y_stride * sbh * 4 != f->lf.cdef_buf_plane_sz[0] ||
+        uv_stride * sbh * 8 != f->lf.cdef_buf_plane_sz[1] ||
+        need_cdef_lpf_copy != f->lf.need_cdef_lpf_copy ||
+        sbh != f->lf.cdef_buf_sbh)
+    {
+        const size_t old_sz = 64 +
+            ((size_t)llabs(f->lf.cdef_buf_plane_sz[0]) << f->lf.need_cdef_lpf_copy) +
+            ((size_t)llabs(f->lf.cdef_buf_plane_sz[1]) << f->lf.need_cdef_lpf_copy);
+        size_t alloc_sz = 64;
+        alloc_sz += (size_t)llabs(y_stride) * 4 * sbh << need_cdef_lpf_copy;
+        alloc_sz += (size_t)llabs(uv_stride) * 8 * sbh << need_cdef_lpf_copy;
+        uint8_t *ptr = f->lf.cdef_line_buf =
+            realloc_frame_buf(f, ALLOC_CDEF, f->lf.cdef_line_buf, old_sz, alloc_sz, 32);
+        if (!ptr) {
+            f->lf.cdef_buf_plane_sz[0] = f->lf.cdef_buf_plane_sz[1] = 0;
+            return DAV1D_ERR(ENOMEM);
+        }
+
+        ptr += 32;
+        if (y_stride < 0) {
+            f->lf.cdef_line[0][0] = ptr - y_stride * (sbh * 4 - 1);
+            f->lf.cdef_line[1][0] = ptr - y_stride * (sbh * 4 - 3);
+        } else {
+            f->lf.cdef_line[0][0] = ptr + y_stride * 0;
+            f->lf.cdef_line[1][0] = ptr + y_stride * 2;
+        }
+        ptr += llabs(y_stride) * sbh * 4;
+        if (uv_stride < 0) {
+            f->lf.cdef_line[0][1] = ptr - uv_stride * (sbh * 8 - 1);
+            f->lf.cdef_line[0][2] = ptr - uv_stride * (sbh * 8 - 3);
+            f->lf.cdef_line[1][1] = ptr - uv_stride * (sbh * 8 - 5);
+            f->lf.cdef_line[1][2] = ptr - uv_stride * (sbh * 8 - 7);
+        } else {
+            f->lf.cdef_line[0][1] = ptr + uv_stride * 0;
+            f->lf.cdef_line[0][2] = ptr + uv_stride * 2;
+            f->lf.cdef_line[1][1] = ptr + uv_stride * 4;
+            f->lf.cdef_line[1][2] = ptr + uv_stride * 6;
+        }
+
+        if (need_cdef_lpf_copy) {
+            ptr += llabs(uv_stride) * sbh * 8;
+            if (y_stride < 0)
+                f->lf.cdef_lpf_line[0] = ptr - y_stride * (sbh * 4 - 1);
+            else
+                f->lf.cdef_lpf_line[0] = ptr;
+            ptr += llabs(y_stride) * sbh * 4;
+            if (uv_stride < 0) {
+                f->lf.cdef_lpf_line[1] = ptr - uv_stride * (sbh * 4 - 1);
+                f->lf.cdef_lpf_line[2] = ptr - uv_stride * (sbh * 8 - 1);
+            } else {
+                f->lf.cdef_lpf_line[1] = ptr;
+                f->lf.cdef_lpf_line[2] = ptr + uv_stride * sbh * 4;
+            }
+        }
+
+        f->lf.cdef_buf_plane_sz[0] = (int) y_stride * sbh * 4;
+        f->lf.cdef_buf_plane_sz[1] = (int) uv_stride * sbh * 8;
+        f->lf.need_cdef_lpf_copy = need_cdef_lpf_copy;
+        f->lf.cdef_buf_sbh = sbh;
+    }
+    return 0;
+}
+
+static int alloc_lr_line_buf(Dav1dFrameContext *const f,
+                             const ptrdiff_t y_stride, const ptrdiff_t uv_stride,
+                             const int num_lines)
+{
+    if (y_stride * num_lines != f->lf.lr_buf_plane_sz[0] ||
+        uv_stride * num_lines * 2 != f->lf.lr_buf_plane_sz[1])
+    {
+        const size_t old_sz = 128 + (size_t)llabs(f->lf.lr_buf_plane_sz[0]) +
+                                    (size_t)llabs(f->lf.lr_buf_plane_sz[1]);
+        // lr simd may overread the input, so slightly over-allocate the lpf buffer
+        size_t alloc_sz = 128;
+        alloc_sz += (size_t)llabs(y_stride) * num_lines;
+        alloc_sz += (size_t)llabs(uv_stride) * num_lines * 2;
+        uint8_t *ptr = f->lf.lr_line_buf =
+            realloc_frame_buf(f, ALLOC_LR, f->lf.lr_line_buf, old_sz, alloc_sz, 64);
+        if (!ptr) {
+            f->lf.lr_buf_plane_sz[0] = f->lf.lr_buf_plane_sz[1] = 0;
+            return DAV1D_ERR(ENOMEM);
+        }
+
+        ptr += 64;
+        if (y_stride < 0)
+            f->lf.lr_lpf_line[0] = ptr - y_stride * (num_lines - 1);
+        else
+            f->lf.lr_lpf_line[0] = ptr;
+        ptr += llabs(y_stride) * num_lines;
+        if (uv_stride < 0) {
+            f->lf.lr_lpf_line[1] = ptr - uv_stride * (num_lines * 1 - 1);
+            f->lf.lr_lpf_line[2] = ptr - uv_stride * (num_lines * 2 - 1);
+        } else {
+            f->lf.lr_lpf_line[1] = ptr;
+            f->lf.lr_lpf_line[2] = ptr + uv_stride * num_lines;
+        }
+
+        f->lf.lr_buf_plane_sz[0] = (int) y_stride * num_lines;
+        f->lf.lr_buf_plane_sz[1] = (int) uv_stride * num_lines * 2;
+    }
+    return 0;
+}
+
+static int alloc_lf_mask(Dav1dFrameContext *const f, const int num_sb128) {
+    const Dav1dContext *const c = f->c;
+    if (num_sb128 != f->lf.mask_sz) {
+        const size_t lf_sz = sizeof(*f->lf.mask) + sizeof(*f->lf.level) * 32 * 32;
+        const size_t b_sz = c->n_fc > 1 ? sizeof(*f->frame_thread.b) * 32 * 32 : 0;
+        dav1d_mem_account_release(c->mem, ALLOC_LF, lf_sz * f->lf.mask_sz);
+        dav1d_mem_account_release(c->mem, ALLOC_BLOCK, b_sz * f->lf.mask_sz);
+        f->lf.mask_sz = 0;
+        free_frame_buf(c, f->lf.mask);
+        dav1d_free(f->lf.level);
+        f->lf.mask = NULL;
+        f->lf.level = NULL;
+        if (dav1d_mem_account_charge(c->mem, ALLOC_LF, lf_sz * num_sb128))
+            return DAV1D_ERR(ENOMEM);
+        f->lf.mask = alloc_frame_buf(f, ALLOC_LF, sizeof(*f->lf.mask) * num_sb128, 64);
+        // over-allocate by 3 bytes since some of the SIMD implementations
+        // index this from the level type and can thus over-read by up to 3
+        f->lf.level = dav1d_malloc(ALLOC_LF, sizeof(*f->lf.level) * num_sb128 * 32 * 32 + 3);
+        if (!f->lf.mask || !f->lf.level) {
+            dav1d_mem_account_release(c->mem, ALLOC_LF, lf_sz * num_sb128);
+            return DAV1D_ERR(ENOMEM);
+        }
+        if (c->n_fc > 1) {
+            dav1d_free(f->frame_thread.b);
+            f->frame_thread.b = NULL;
+            if (dav1d_mem_account_charge(c->mem, ALLOC_BLOCK, b_sz * num_sb128)) {
+                dav1d_mem_account_release(c->mem, ALLOC_LF, lf_sz * num_sb128);
+                return DAV1D_ERR(ENOMEM);
+            }
+            f->frame_thread.b = dav1d_malloc(ALLOC_BLOCK, sizeof(*f->frame_thread.b) *
+                                             num_sb128 * 32 * 32);
+            if (!f->frame_thread.b) {
+                dav1d_mem_account_release(c->mem, ALLOC_BLOCK, b_sz * num_sb128);
+                dav1d_mem_account_release(c->mem, ALLOC_LF, lf_sz * num_sb128);
+                return DAV1D_ERR(ENOMEM);
+            }
+        }
+        f->lf.mask_sz = num_sb128;
+    }
+    return 0;
+}
+
+static int alloc_ipred_edge(Dav1dFrameContext *const f, const int ipred_edge_sz) {
+    if (ipred_edge_sz != f->ipred_edge_sz) {
+        uint8_t *ptr = f->ipred_edge[0] =
+            realloc_frame_buf(f, ALLOC_IPRED, f->ipred_edge[0],
+                              (size_t)f->ipred_edge_sz * 128 * 3,
+                              (size_t)ipred_edge_sz * 128 * 3, 64);
+        if (!ptr) {
+            f->ipred_edge_sz = 0;
+            return DAV1D_ERR(ENOMEM);
+        }
+        f->ipred_edge[1] = ptr + ipred_edge_sz * 128 * 1;
+        f->ipred_edge[2] = ptr + ipred_edge_sz * 128 * 2;
+        f->ipred_edge_sz = ipred_edge_sz;
+    }
+    return 0;
+}
+
+/*
+ * Allocate and fault in the per-frame buffers whose size only depends on the
+ * sequence header, as if for a frame of the maximum dimensions with a single
+ * tile row, so that dav1d_decode_frame_init() finds them already in place.
+ * The coefficient and block data of frame threading are only written up to
+ * what the coded frame needs, so those are allocated but left untouched.
+ * stride[] are the strides of pictures of that size, or 0 if not known.
+ */
+int dav1d_decode_frame_prepare(Dav1dFrameContext *const f,
+                               const Dav1dSequenceHeader *const seq_hdr,
+                               const ptrdiff_t stride[2])
+{
+    const Dav1dContext *const c = f->c;
+    const int bw = ((seq_hdr->max_width + 7) >> 3) << 1;
+    const int bh = ((seq_hdr->max_height + 7) >> 3) << 1;
+    const int sb128w = (bw + 31) >> 5, sb128h = (bh + 31) >> 5;
+    const int sb_step = 16 << seq_hdr->sb128;
+    const int sbh = (bh + sb_step - 1) >> (4 + seq_hdr->sb128);
+    const int num_sb128 = sb128w * sb128h;
+    const int hbd = !!seq_hdr->hbd;
+
+    if (c->n_fc > 1) {
+        const int cbi_sz = num_sb128 * ss_size_mul[seq_hdr->layout][0];
+        if (alloc_block_bufs(f, cbi_sz, hbd)) return DAV1D_ERR(ENOMEM);
+        memset(f->frame_thread.cbi, 0,
+               sizeof(*f->frame_thread.cbi) * cbi_sz * 32 * 32 / 4);
+    }
+
+    if (stride[0]) {
+        if (alloc_cdef_line_buf(f, stride[0], stride[1], sbh, 0))
+            return DAV1D_ERR(ENOMEM);
+        memset(f->lf.cdef_line_buf, 0, 64 + (size_t)llabs(stride[0]) * 4 * sbh +
+                                            (size_t)llabs(stride[1]) * 8 * sbh);
+
+        const int num_lines = c->n_tc > 1 ? sbh * 4 << seq_hdr->sb128 : 12;
+        if (alloc_lr_line_buf(f, stride[0], stride[1], num_lines))
+            return DAV1D_ERR(ENOMEM);
+        memset(f->lf.lr_line_buf, 0, 128 + (size_t)llabs(stride[0]) * num_lines +
+                                           (size_t)llabs(stride[1]) * num_lines * 2);
+    }
+
+    if (alloc_lf_mask(f, num_sb128)) return DAV1D_ERR(ENOMEM);
+    memset(f->lf.mask, 0, sizeof(*f->lf.mask) * num_sb128);
+    memset(f->lf.level, 0, sizeof(*f->lf.level) * num_sb128 * 32 * 32 + 3);
+
+    const int ipred_edge_sz = sbh * sb128w << hbd;
+    if (alloc_ipred_edge(f, ipred_edge_sz)) return DAV1D_ERR(ENOMEM);
+    memset(f->ipred_edge[0], 0, (size_t)ipred_edge_sz * 128 * 3);
+
+    return 0;
+}
+
 int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
     const Dav1dContext *const c = f->c;
     int retval = DAV1D_ERR(ENOMEM);
 
     if (f->sbh > f->lf.start_of_tile_row_sz) {
-        dav1d_free(f->lf.start_of_tile_row);
-        f->lf.start_of_tile_row = dav1d_malloc(ALLOC_TILE, f->sbh * sizeof(uint8_t));
+        dav1d_free_charged(f->lf.start_of_tile_row);
+        f->lf.start_of_tile_row =
+            dav1d_malloc_charged(c->mem, ALLOC_TILE, f->sbh * sizeof(uint8_t));
         if (!f->lf.start_of_tile_row) {
             f->lf.start_of_tile_row_sz = 0;
             goto error;
@@ -2791,24 +3091,25 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
     const int n_ts = f->frame_hdr->tiling.cols * f->frame_hdr->tiling.rows;
     if (n_ts != f->n_ts) {
         if (c->n_fc > 1) {
-            dav1d_free(f->frame_thread.tile_start_off);
+            dav1d_free_charged(f->frame_thread.tile_start_off);
             f->frame_thread.tile_start_off =
-                dav1d_malloc(ALLOC_TILE, sizeof(*f->frame_thread.tile_start_off) * n_ts);
+                dav1d_malloc_charged(c->mem, ALLOC_TILE,
+                                     sizeof(*f->frame_thread.tile_start_off) * n_ts);
             if (!f->frame_thread.tile_start_off) {
                 f->n_ts = 0;
                 goto error;
             }
         }
-        dav1d_free_aligned(f->ts);
-        f->ts = dav1d_alloc_aligned(ALLOC_TILE, sizeof(*f->ts) * n_ts, 32);
+        dav1d_free_aligned_charged(f->ts);
+        f->ts = dav1d_alloc_aligned_charged(c->mem, ALLOC_TILE, sizeof(*f->ts) * n_ts, 32);
         if (!f->ts) goto error;
         f->n_ts = n_ts;
     }
 
     const int a_sz = f->sb128w * f->frame_hdr->tiling.rows * (1 + (c->n_fc > 1 && c->n_tc > 1));
     if (a_sz != f->a_sz) {
-        dav1d_free(f->a);
-        f->a = dav1d_malloc(ALLOC_TILE, sizeof(*f->a) * a_sz);
+        dav1d_free_charged(f->a);
+        f->a = dav1d_malloc_charged(c->mem, ALLOC_TILE, sizeof(*f->a) * a_sz);
         if (!f->a) {
             f->a_sz = 0;
             goto error;
@@ -2835,10 +3136,10 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
 
         const int lowest_pixel_mem_sz = f->frame_hdr->tiling.cols * f->sbh;
         if (lowest_pixel_mem_sz != f->tile_thread.lowest_pixel_mem_sz) {
-            dav1d_free(f->tile_thread.lowest_pixel_mem);
+            dav1d_free_charged(f->tile_thread.lowest_pixel_mem);
             f->tile_thread.lowest_pixel_mem =
-                dav1d_malloc(ALLOC_TILE, lowest_pixel_mem_sz *
-                             sizeof(*f->tile_thread.lowest_pixel_mem));
+                dav1d_malloc_charged(c->mem, ALLOC_TILE, lowest_pixel_mem_sz *
+                                     sizeof(*f->tile_thread.lowest_pixel_mem));
             if (!f->tile_thread.lowest_pixel_mem) {
                 f->tile_thread.lowest_pixel_mem_sz = 0;
                 goto error;
@@ -2857,39 +3158,17 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
             }
         }
 
-        const int cbi_sz = num_sb128 * size_mul[0];
-        if (cbi_sz != f->frame_thread.cbi_sz) {
-            dav1d_free_aligned(f->frame_thread.cbi);
-            f->frame_thread.cbi =
-                dav1d_alloc_aligned(ALLOC_BLOCK, sizeof(*f->frame_thread.cbi) *
-                                    cbi_sz * 32 * 32 / 4, 64);
-            if (!f->frame_thread.cbi) {
-                f->frame_thread.cbi_sz = 0;
-                goto error;
-            }
-            f->frame_thread.cbi_sz = cbi_sz;
-        }
-
-        const int cf_sz = (num_sb128 * size_mul[0]) << hbd;
-        if (cf_sz != f->frame_thread.cf_sz) {
-            dav1d_free_aligned(f->frame_thread.cf);
-            f->frame_thread.cf =
-                dav1d_alloc_aligned(ALLOC_COEF, (size_t)cf_sz * 128 * 128 / 2, 64);
-            if (!f->frame_thread.cf) {
-                f->frame_thread.cf_sz = 0;
-                goto error;
-            }
-            memset(f->frame_thread.cf, 0, (size_t)cf_sz * 128 * 128 / 2);
-            f->frame_thread.cf_sz = cf_sz;
-        }
+        if (alloc_block_bufs(f, num_sb128 * size_mul[0], hbd)) goto error;
 
         if (f->frame_hdr->allow_screen_content_tools) {
             const int pal_sz = num_sb128 << hbd;
             if (pal_sz != f->frame_thread.pal_sz) {
-                dav1d_free_aligned(f->frame_thread.pal);
                 f->frame_thread.pal =
-                    dav1d_alloc_aligned(ALLOC_PAL, sizeof(*f->frame_thread.pal) *
-                                        pal_sz * 16 * 16, 64);
+                    realloc_frame_buf(f, ALLOC_PAL, f->frame_thread.pal,
+                                      sizeof(*f->frame_thread.pal) *
+                                      f->frame_thread.pal_sz * 16 * 16,
+                                      sizeof(*f->frame_thread.pal) *
+                                      pal_sz * 16 * 16, 64);
                 if (!f->frame_thread.pal) {
                     f->frame_thread.pal_sz = 0;
                     goto error;
@@ -2899,10 +3178,12 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
 
             const int pal_idx_sz = num_sb128 * size_mul[1];
             if (pal_idx_sz != f->frame_thread.pal_idx_sz) {
-                dav1d_free_aligned(f->frame_thread.pal_idx);
                 f->frame_thread.pal_idx =
-                    dav1d_alloc_aligned(ALLOC_PAL, sizeof(*f->frame_thread.pal_idx) *
-                                        pal_idx_sz * 128 * 128 / 8, 64);
+                    realloc_frame_buf(f, ALLOC_PAL, f->frame_thread.pal_idx,
+                                      sizeof(*f->frame_thread.pal_idx) *
+                                      f->frame_thread.pal_idx_sz * 128 * 128 / 8,
+                                      sizeof(*f->frame_thread.pal_idx) *
+                                      pal_idx_sz * 128 * 128 / 8, 64);
                 if (!f->frame_thread.pal_idx) {
                     f->frame_thread.pal_idx_sz = 0;
                     goto error;
@@ -2910,8 +3191,17 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
                 f->frame_thread.pal_idx_sz = pal_idx_sz;
             }
         } else if (f->frame_thread.pal) {
-            dav1d_freep_aligned(&f->frame_thread.pal);
-            dav1d_freep_aligned(&f->frame_thread.pal_idx);
+            dav1d_mem_account_release(c->mem, ALLOC_PAL,
+                                      sizeof(*f->frame_thread.pal) *
+                                      f->frame_thread.pal_sz * 16 * 16);
+            if (f->frame_thread.pal_idx)
+                dav1d_mem_account_release(c->mem, ALLOC_PAL,
+                                          sizeof(*f->frame_thread.pal_idx) *
+                                          f->frame_thread.pal_idx_sz * 128 * 128 / 8);
+            free_frame_buf(c, f->frame_thread.pal);
+            free_frame_buf(c, f->frame_thread.pal_idx);
+            f->frame_thread.pal = NULL;
+            f->frame_thread.pal_idx = NULL;
             f->frame_thread.pal_sz = f->frame_thread.pal_idx_sz = 0;
         }
     }
@@ -2920,128 +3210,23 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
     ptrdiff_t y_stride = f->cur.stride[0], uv_stride = f->cur.stride[1];
     const int has_resize = f->frame_hdr->width[0] != f->frame_hdr->width[1];
     const int need_cdef_lpf_copy = c->n_tc > 1 && has_resize;
-    if (y_stride * f->sbh * 4 != f->lf.cdef_buf_plane_sz[0] ||
-        uv_stride * f->sbh * 8 != f->lf.cdef_buf_plane_sz[1] ||
-        need_cdef_lpf_copy != f->lf.need_cdef_lpf_copy ||
-        f->sbh != f->lf.cdef_buf_sbh)
-    {
-        dav1d_free_aligned(f->lf.cdef_line_buf);
-        size_t alloc_sz = 64;
-        alloc_sz += (size_t)llabs(y_stride) * 4 * f->sbh << need_cdef_lpf_copy;
-        alloc_sz += (size_t)llabs(uv_stride) * 8 * f->sbh << need_cdef_lpf_copy;
-        uint8_t *ptr = f->lf.cdef_line_buf = dav1d_alloc_aligned(ALLOC_CDEF, alloc_sz, 32);
-        if (!ptr) {
-            f->lf.cdef_buf_plane_sz[0] = f->lf.cdef_buf_plane_sz[1] = 0;
-            goto error;
-        }
-
-        ptr += 32;
-        if (y_stride < 0) {
-            f->lf.cdef_line[0][0] = ptr - y_stride * (f->sbh * 4 - 1);
-            f->lf.cdef_line[1][0] = ptr - y_stride * (f->sbh * 4 - 3);
-        } else {
-            f->lf.cdef_line[0][0] = ptr + y_stride * 0;
-            f->lf.cdef_line[1][0] = ptr + y_stride * 2;
-        }
-        ptr += llabs(y_stride) * f->sbh * 4;
-        if (uv_stride < 0) {
-            f->lf.cdef_line[0][1] = ptr - uv_stride * (f->sbh * 8 - 1);
-            f->lf.cdef_line[0][2] = ptr - uv_stride * (f->sbh * 8 - 3);
-            f->lf.cdef_line[1][1] = ptr - uv_stride * (f->sbh * 8 - 5);
-            f->lf.cdef_line[1][2] = ptr - uv_stride * (f->sbh * 8 - 7);
-        } else {
-            f->lf.cdef_line[0][1] = ptr + uv_stride * 0;
-            f->lf.cdef_line[0][2] = ptr + uv_stride * 2;
-            f->lf.cdef_line[1][1] = ptr + uv_stride * 4;
-            f->lf.cdef_line[1][2] = ptr + uv_stride * 6;
-        }
-
-        if (need_cdef_lpf_copy) {
-            ptr += llabs(uv_stride) * f->sbh * 8;
-            if (y_stride < 0)
-                f->lf.cdef_lpf_line[0] = ptr - y_stride * (f->sbh * 4 - 1);
-            else
-                f->lf.cdef_lpf_line[0] = ptr;
-            ptr += llabs(y_stride) * f->sbh * 4;
-            if (uv_stride < 0) {
-                f->lf.cdef_lpf_line[1] = ptr - uv_stride * (f->sbh * 4 - 1);
-                f->lf.cdef_lpf_line[2] = ptr - uv_stride * (f->sbh * 8 - 1);
-            } else {
-                f->lf.cdef_lpf_line[1] = ptr;
-                f->lf.cdef_lpf_line[2] = ptr + uv_stride * f->sbh * 4;
-            }
-        }
-
-        f->lf.cdef_buf_plane_sz[0] = (int) y_stride * f->sbh * 4;
-        f->lf.cdef_buf_plane_sz[1] = (int) uv_stride * f->sbh * 8;
-        f->lf.need_cdef_lpf_copy = need_cdef_lpf_copy;
-        f->lf.cdef_buf_sbh = f->sbh;
-    }
+    if (alloc_cdef_line_buf(f, y_stride, uv_stride, f->sbh, need_cdef_lpf_copy))
+        goto error;
 
     const int sb128 = f->seq_hdr->sb128;
     const int num_lines = c->n_tc > 1 ? f->sbh * 4 << sb128 : 12;
     y_stride = f->sr_cur.p.stride[0], uv_stride = f->sr_cur.p.stride[1];
-    if (y_stride * num_lines != f->lf.lr_buf_plane_sz[0] ||
-        uv_stride * num_lines * 2 != f->lf.lr_buf_plane_sz[1])
-    {
-        dav1d_free_aligned(f->lf.lr_line_buf);
-        // lr simd may overread the input, so slightly over-allocate the lpf buffer
-        size_t alloc_sz = 128;
-        alloc_sz += (size_t)llabs(y_stride) * num_lines;
-        alloc_sz += (size_t)llabs(uv_stride) * num_lines * 2;
-        uint8_t *ptr = f->lf.lr_line_buf = dav1d_alloc_aligned(ALLOC_LR, alloc_sz, 64);
-        if (!ptr) {
-            f->lf.lr_buf_plane_sz[0] = f->lf.lr_buf_plane_sz[1] = 0;
-            goto error;
-        }
-
-        ptr += 64;
-        if (y_stride < 0)
-            f->lf.lr_lpf_line[0] = ptr - y_stride * (num_lines - 1);
-        else
-            f->lf.lr_lpf_line[0] = ptr;
-        ptr += llabs(y_stride) * num_lines;
-        if (uv_stride < 0) {
-            f->lf.lr_lpf_line[1] = ptr - uv_stride * (num_lines * 1 - 1);
-            f->lf.lr_lpf_line[2] = ptr - uv_stride * (num_lines * 2 - 1);
-        } else {
-            f->lf.lr_lpf_line[1] = ptr;
-            f->lf.lr_lpf_line[2] = ptr + uv_stride * num_lines;
-        }
-
-        f->lf.lr_buf_plane_sz[0] = (int) y_stride * num_lines;
-        f->lf.lr_buf_plane_sz[1] = (int) uv_stride * num_lines * 2;
-    }
+    if (alloc_lr_line_buf(f, y_stride, uv_stride, num_lines)) goto error;
 
     // update allocation for loopfilter masks
-    if (num_sb128 != f->lf.mask_sz) {
-        dav1d_free(f->lf.mask);
-        dav1d_free(f->lf.level);
-        f->lf.mask = dav1d_malloc(ALLOC_LF, sizeof(*f->lf.mask) * num_sb128);
-        // over-allocate by 3 bytes since some of the SIMD implementations
-        // index this from the level type and can thus over-read by up to 3
-        f->lf.level = dav1d_malloc(ALLOC_LF, sizeof(*f->lf.level) * num_sb128 * 32 * 32 + 3);
-        if (!f->lf.mask || !f->lf.level) {
-            f->lf.mask_sz = 0;
-            goto error;
-        }
-        if (c->n_fc > 1) {
-            dav1d_free(f->frame_thread.b);
-            f->frame_thread.b = dav1d_malloc(ALLOC_BLOCK, sizeof(*f->frame_thread.b) *
-                                             num_sb128 * 32 * 32);
-            if (!f->frame_thread.b) {
-                f->lf.mask_sz = 0;
-                goto error;
-            }
-        }
-        f->lf.mask_sz = num_sb128;
-    }
+    if (alloc_lf_mask(f, num_sb128)) goto error;
 
     f->sr_sb128w = (f->sr_cur.p.p.w + 127) >> 7;
     const int lr_mask_sz = f->sr_sb128w * f->sb128h;
     if (lr_mask_sz != f->lf.lr_mask_sz) {
-        dav1d_free(f->lf.lr_mask);
-        f->lf.lr_mask = dav1d_malloc(ALLOC_LR, sizeof(*f->lf.lr_mask) * lr_mask_sz);
+        dav1d_free_charged(f->lf.lr_mask);
+        f->lf.lr_mask = dav1d_malloc_charged(c->mem, ALLOC_LR,
+                                             sizeof(*f->lf.lr_mask) * lr_mask_sz);
         if (!f->lf.lr_mask) {
             f->lf.lr_mask_sz = 0;
             goto error;
@@ -3059,24 +3244,12 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
     dav1d_calc_lf_values(f->lf.lvl, f->frame_hdr, (int8_t[4]) { 0, 0, 0, 0 });
     memset(f->lf.mask, 0, sizeof(*f->lf.mask) * num_sb128);
 
-    const int ipred_edge_sz = f->sbh * f->sb128w << hbd;
-    if (ipred_edge_sz != f->ipred_edge_sz) {
-        dav1d_free_aligned(f->ipred_edge[0]);
-        uint8_t *ptr = f->ipred_edge[0] =
-            dav1d_alloc_aligned(ALLOC_IPRED, ipred_edge_sz * 128 * 3, 64);
-        if (!ptr) {
-            f->ipred_edge_sz = 0;
-            goto error;
-        }
-        f->ipred_edge[1] = ptr + ipred_edge_sz * 128 * 1;
-        f->ipred_edge[2] = ptr + ipred_edge_sz * 128 * 2;
-        f->ipred_edge_sz = ipred_edge_sz;
-    }
+    if (alloc_ipred_edge(f, f->sbh * f->sb128w << hbd)) goto error;
 
     const int re_sz = f->sb128h * f->frame_hdr->tiling.cols;
     if (re_sz != f->lf.re_sz) {
-        dav1d_free(f->lf.tx_lpf_right_edge[0]);
-        f->lf.tx_lpf_right_edge[0] = dav1d_malloc(ALLOC_LF, re_sz * 32 * 2);
+        dav1d_free_charged(f->lf.tx_lpf_right_edge[0]);
+        f->lf.tx_lpf_right_edge[0] = dav1d_malloc_charged(c->mem, ALLOC_LF, re_sz * 32 * 2);
         if (!f->lf.tx_lpf_right_edge[0]) {
             f->lf.re_sz = 0;
             goto error;
@@ -3090,7 +3263,8 @@ int dav1d_decode_frame_init(Dav1dFrameContext *const f) {
         const int ret =
             dav1d_refmvs_init_frame(&f->rf, f->seq_hdr, f->frame_hdr,
                                     f->refpoc, f->mvs, f->refrefpoc, f->ref_mvs,
-                                    f->c->n_tc, f->c->n_fc);
+                                    f->c->n_tc, f->c->n_fc, f->c->mem,
+                                    f->c->huge_pages);
         if (ret < 0) goto error;
     }
 
@@ -3160,17 +3334,10 @@ error:
     return retval;
 }
 
-int dav1d_decode_frame_init_cdf(Dav1dFrameContext *const f) {
-    const Dav1dContext *const c = f->c;
-    int retval = DAV1D_ERR(EINVAL);
-
-    if (f->frame_hdr->refresh_context)
-        dav1d_cdf_thread_copy(f->out_cdf.data.cdf, &f->in_cdf);
-
-    // parse individual tiles per tile group
-    int tile_row = 0, tile_col = 0;
-    f->task_thread.update_set = 0;
-    for (int i = 0; i < f->n_tile_data; i++) {
+// splits the tile groups from f->tile[first_group] on into individual tiles,
+// and makes each complete tile group available to the tile decoding tasks
+static int add_tile_data(Dav1dFrameContext *const f, const int first_group) {
+    for (int i = first_group; i < f->n_tile_data; i++) {
         const uint8_t *data = f->tile[i].data.data;
         size_t size = f->tile[i].data.sz;
 
@@ -3179,26 +3346,41 @@ int dav1d_decode_frame_init_cdf(Dav1dFrameContext *const f) {
             if (j == f->tile[i].end) {
                 tile_sz = size;
             } else {
-                if (f->frame_hdr->tiling.n_bytes > size) goto error;
+                if (f->frame_hdr->tiling.n_bytes > size)
+                    return DAV1D_ERR(EINVAL);
                 tile_sz = 0;
                 for (unsigned k = 0; k < f->frame_hdr->tiling.n_bytes; k++)
                     tile_sz |= (unsigned)*data++ << (k * 8);
                 tile_sz++;
                 size -= f->frame_hdr->tiling.n_bytes;
-                if (tile_sz > size) goto error;
+                if (tile_sz > size) return DAV1D_ERR(EINVAL);
             }
 
-            setup_tile(&f->ts[j], f, data, tile_sz, tile_row, tile_col++,
-                       c->n_fc > 1 ? f->frame_thread.tile_start_off[j] : 0);
+            f->tile_data[j].data = data;
+            f->tile_data[j].sz = tile_sz;
+            data += tile_sz;
+            size -= tile_sz;
+        }
+        atomic_store(&f->n_tiles_ready, f->tile[i].end + 1);
+    }
 
-            if (tile_col == f->frame_hdr->tiling.cols) {
-                tile_col = 0;
-                tile_row++;
-            }
+    return 0;
+}
+
+int dav1d_decode_frame_init_cdf(Dav1dFrameContext *const f) {
+    const Dav1dContext *const c = f->c;
+
+    if (f->frame_hdr->refresh_context)
+        dav1d_cdf_thread_copy(f->out_cdf.data.cdf, &f->in_cdf);
+
+    // the tile data itself is attached as the tile groups are received
+    f->task_thread.update_set = 0;
+    for (int tile_row = 0, j = 0; tile_row < f->frame_hdr->tiling.rows; tile_row++) {
+        for (int tile_col = 0; tile_col < f->frame_hdr->tiling.cols; tile_col++, j++) {
+            setup_tile(&f->ts[j], f, tile_row, tile_col,
+                       c->n_fc > 1 ? f->frame_thread.tile_start_off[j] : 0);
             if (j == f->frame_hdr->tiling.update && f->frame_hdr->refresh_context)
                 f->task_thread.update_set = 1;
-            data += tile_sz;
-            size -= tile_sz;
         }
     }
 
@@ -3209,14 +3391,46 @@ int dav1d_decode_frame_init_cdf(Dav1dFrameContext *const f) {
                           uses_2pass ? 1 + (n >= f->sb128w * f->frame_hdr->tiling.rows) : 0);
     }
 
-    retval = 0;
-error:
-    return retval;
+    return 0;
 }
 
+// whether decoding in steps has to return to the caller before the next
+// superblock row, after decoding n_sbrows of them in the current step
+static inline int step_paused(const Dav1dContext *const c, const int n_sbrows) {
+    return c->step_decoding &&
+           (!c->step_deadline ||
+            (n_sbrows && dav1d_get_time_nanos() >= c->step_deadline));
+}
+
+// runs the post-filters of an sbrow like dav1d_filter_sbrow(), with an event
+// for each of them
+static void filter_sbrow_traced(Dav1dTaskContext *const t,
+                                Dav1dFrameContext *const f, const int sby)
+{
+    dav1d_trace_task_next(t, DAV1D_TASK_TYPE_DEBLOCK_COLS);
+    f->bd_fn.filter_sbrow_deblock_cols(f, sby);
+    dav1d_trace_task_next(t, DAV1D_TASK_TYPE_DEBLOCK_ROWS);
+    f->bd_fn.filter_sbrow_deblock_rows(f, sby);
+    if (f->seq_hdr->cdef) {
+        dav1d_trace_task_next(t, DAV1D_TASK_TYPE_CDEF);
+        f->bd_fn.filter_sbrow_cdef(t, sby);
+    }
+    if (f->frame_hdr->width[0] != f->frame_hdr->width[1]) {
+        dav1d_trace_task_next(t, DAV1D_TASK_TYPE_SUPER_RESOLUTION);
+        f->bd_fn.filter_sbrow_resize(f, sby);
+    }
+    if (f->lf.restore_planes) {
+        dav1d_trace_task_next(t, DAV1D_TASK_TYPE_LOOP_RESTORATION);
+        f->bd_fn.filter_sbrow_lr(f, sby);
+    }
+}
+
+// returns 1 if decoding stopped at a tile row which wasn't received yet, or 2
+// if the time budget of the current decoding step was used up
 int dav1d_decode_frame_main(Dav1dFrameContext *const f) {
     const Dav1dContext *const c = f->c;
     int retval = DAV1D_ERR(EINVAL);
+    int n_sbrows = 0;
 
     assert(f->c->n_tc == 1);
 
@@ -3224,17 +3438,34 @@ int dav1d_decode_frame_main(Dav1dFrameContext *const f) {
     t->f = f;
     t->frame_thread.pass = 0;
 
-    for (int n = 0; n < f->sb128w * f->frame_hdr->tiling.rows; n++)
-        reset_context(&f->a[n], IS_KEY_OR_INTRA(f->frame_hdr), 0);
+    if (!f->next_sby) {
+        for (int n = 0; n < f->sb128w * f->frame_hdr->tiling.rows; n++)
+            reset_context(&f->a[n], IS_KEY_OR_INTRA(f->frame_hdr), 0);
+    }
 
     // no threading - we explicitly interleave tile/sbrow decoding
     // and post-filtering, so that the full process runs in-line
-    for (int tile_row = 0; tile_row < f->frame_hdr->tiling.rows; tile_row++) {
+    for (int tile_row = f->next_tile_row; tile_row < f->frame_hdr->tiling.rows; tile_row++) {
+        // stop at the first tile row which wasn't fully received yet, and
+        // resume from there once more tile groups arrive
+        if (atomic_load(&f->task_thread.error)) goto error;
+        if (atomic_load(&f->n_tiles_ready) < (tile_row + 1) * f->frame_hdr->tiling.cols) {
+            f->next_tile_row = tile_row;
+            f->next_sby = f->frame_hdr->tiling.row_start_sb[tile_row];
+            return 1;
+        }
         const int sbh_end =
             imin(f->frame_hdr->tiling.row_start_sb[tile_row + 1], f->sbh);
-        for (int sby = f->frame_hdr->tiling.row_start_sb[tile_row];
-             sby < sbh_end; sby++)
+        for (int sby = imax(f->frame_hdr->tiling.row_start_sb[tile_row], f->next_sby);
+             sby < sbh_end; sby++, n_sbrows++)
         {
+            if (step_paused(c, n_sbrows)) {
+                f->next_tile_row = tile_row;
+                f->next_sby = sby;
+                return 2;
+            }
+            dav1d_trace_task_begin(t, DAV1D_TASK_TYPE_TILE_RECONSTRUCTION, 0, sby,
+                                   f->sr_cur.p.m.timestamp);
             t->by = sby << (4 + f->seq_hdr->sb128);
             const int by_end = (t->by + f->sb_step) >> 1;
             if (f->frame_hdr->use_ref_frame_mvs) {
@@ -3251,25 +3482,28 @@ int dav1d_decode_frame_main(Dav1dFrameContext *const f) {
             }
 
             // loopfilter + cdef + restoration
-            f->bd_fn.filter_sbrow(f, sby);
+            filter_sbrow_traced(t, f, sby);
+            if (c->output_downscale)
+                f->bd_fn.downscale_sbrows(f, sby, sby + 1);
+            dav1d_trace_task_end(t);
         }
     }
 
     retval = 0;
 error:
+    dav1d_trace_task_end(t);
     return retval;
 }
 
 void dav1d_decode_frame_exit(Dav1dFrameContext *const f, int retval) {
     const Dav1dContext *const c = f->c;
 
+    if (f->frame_thread.submit_time)
+        f->frame_thread.done_time = dav1d_get_time_nanos();
+
     if (f->sr_cur.p.data[0])
         atomic_init(&f->task_thread.error, 0);
 
-    if (c->n_fc > 1 && retval && f->frame_thread.cf) {
-        memset(f->frame_thread.cf, 0,
-               (size_t)f->frame_thread.cf_sz * 128 * 128 / 2);
-    }
     for (int i = 0; i < 7; i++) {
         if (f->refp[i].p.frame_hdr) {
             if (!retval && c->n_fc > 1 && c->strict_std_compliance &&
@@ -3287,7 +3521,7 @@ void dav1d_decode_frame_exit(Dav1dFrameContext *const f, int retval) {
     dav1d_picture_unref_internal(&f->cur);
     dav1d_thread_picture_unref(&f->sr_cur);
     dav1d_cdf_thread_unref(&f->in_cdf);
-    if (f->frame_hdr && f->frame_hdr->refresh_context) {
+    if (f->frame_hdr_ref && f->frame_hdr->refresh_context) {
         if (f->out_cdf.progress)
             atomic_store(f->out_cdf.progress, retval == 0 ? 1 : TILE_ERROR);
         dav1d_cdf_thread_unref(&f->out_cdf);
@@ -3303,36 +3537,153 @@ void dav1d_decode_frame_exit(Dav1dFrameContext *const f, int retval) {
     f->task_thread.retval = retval;
 }
 
-int dav1d_decode_frame(Dav1dFrameContext *const f) {
-    assert(f->c->n_fc == 1);
+// Frees the scratch buffers of an idle frame context, which don't hold any
+// state across frames, giving back what was charged to the memory budget.
+// They are allocated again by dav1d_decode_frame_init().
+void dav1d_decode_frame_trim(Dav1dContext *const c, Dav1dFrameContext *const f) {
+    Dav1dMemAccount *const acct = c->mem;
+
+    if (f->frame_thread.cbi)
+        dav1d_mem_account_release(acct, ALLOC_BLOCK, sizeof(*f->frame_thread.cbi) *
+                                  f->frame_thread.cbi_sz * 32 * 32 / 4);
+    if (f->frame_thread.cf)
+        dav1d_mem_account_release(acct, ALLOC_COEF,
+                                  (size_t)f->frame_thread.cf_sz * 128 * 128 / 2);
+    if (f->frame_thread.pal)
+        dav1d_mem_account_release(acct, ALLOC_PAL, sizeof(*f->frame_thread.pal) *
+                                  f->frame_thread.pal_sz * 16 * 16);
+    if (f->frame_thread.pal_idx)
+        dav1d_mem_account_release(acct, ALLOC_PAL, sizeof(*f->frame_thread.pal_idx) *
+                                  f->frame_thread.pal_idx_sz * 128 * 128 / 8);
+    if (f->lf.cdef_line_buf)
+        dav1d_mem_account_release(acct, ALLOC_CDEF, 64 +
+            ((size_t)llabs(f->lf.cdef_buf_plane_sz[0]) << f->lf.need_cdef_lpf_copy) +
+            ((size_t)llabs(f->lf.cdef_buf_plane_sz[1]) << f->lf.need_cdef_lpf_copy));
+    if (f->lf.lr_line_buf)
+        dav1d_mem_account_release(acct, ALLOC_LR, 128 +
+                                  (size_t)llabs(f->lf.lr_buf_plane_sz[0]) +
+                                  (size_t)llabs(f->lf.lr_buf_plane_sz[1]));
+    if (f->ipred_edge[0])
+        dav1d_mem_account_release(acct, ALLOC_IPRED,
+                                  (size_t)f->ipred_edge_sz * 128 * 3);
+    const size_t lf_sz = sizeof(*f->lf.mask) + sizeof(*f->lf.level) * 32 * 32;
+    const size_t b_sz = c->n_fc > 1 ? sizeof(*f->frame_thread.b) * 32 * 32 : 0;
+    dav1d_mem_account_release(acct, ALLOC_LF, lf_sz * f->lf.mask_sz);
+    dav1d_mem_account_release(acct, ALLOC_BLOCK, b_sz * f->lf.mask_sz);
+    dav1d_mem_account_release(acct, ALLOC_REFMVS, f->rf.r_sz);
+
+    dav1d_free(f->frame_thread.b);
+    free_frame_buf(c, f->frame_thread.cbi);
+    free_frame_buf(c, f->frame_thread.pal_idx);
+    free_frame_buf(c, f->frame_thread.cf);
+    free_frame_buf(c, f->frame_thread.pal);
+    free_frame_buf(c, f->ipred_edge[0]);
+    free_frame_buf(c, f->lf.mask);
+    dav1d_free(f->lf.level);
+    free_frame_buf(c, f->rf.r);
+    free_frame_buf(c, f->lf.cdef_line_buf);
+    free_frame_buf(c, f->lf.lr_line_buf);
+
+    f->frame_thread.b = NULL;
+    f->frame_thread.cbi = NULL;
+    f->frame_thread.pal_idx = NULL;
+    f->frame_thread.cf = NULL;
+    f->frame_thread.pal = NULL;
+    f->frame_thread.cbi_sz = f->frame_thread.pal_sz = 0;
+    f->frame_thread.pal_idx_sz = f->frame_thread.cf_sz = 0;
+    f->ipred_edge[0] = f->ipred_edge[1] = f->ipred_edge[2] = NULL;
+    f->ipred_edge_sz = 0;
+    f->lf.mask = NULL;
+    f->lf.level = NULL;
+    f->lf.mask_sz = 0;
+    f->rf.r = NULL;
+    f->rf.r_sz = 0;
+    f->rf.n_blocks = 0;
+    f->lf.cdef_line_buf = NULL;
+    f->lf.cdef_buf_plane_sz[0] = f->lf.cdef_buf_plane_sz[1] = 0;
+    f->lf.cdef_buf_sbh = 0;
+    f->lf.need_cdef_lpf_copy = 0;
+    f->lf.lr_line_buf = NULL;
+    f->lf.lr_buf_plane_sz[0] = f->lf.lr_buf_plane_sz[1] = 0;
+}
+
+// Frees the buffers of an idle frame context, giving back what was charged
+// to the memory budget by dav1d_decode_frame_init().
+void dav1d_decode_frame_free(Dav1dContext *const c, Dav1dFrameContext *const f) {
+    dav1d_decode_frame_trim(c, f);
+
+    dav1d_free_charged(f->tile_thread.lowest_pixel_mem);
+    dav1d_free_charged(f->frame_thread.tile_start_off);
+    dav1d_free_charged(f->frame_thread.frame_progress);
+    dav1d_free_charged(f->task_thread.tasks);
+    dav1d_free_charged(f->task_thread.filter_deps);
+    dav1d_free_charged(f->task_thread.tile_tasks[0]);
+    dav1d_free_aligned_charged(f->ts);
+    dav1d_free_charged(f->a);
+    dav1d_free_charged(f->tile);
+    dav1d_free_charged(f->tile_data);
+    dav1d_free_charged(f->lf.lr_mask);
+    dav1d_free_charged(f->lf.tx_lpf_right_edge[0]);
+    dav1d_free_charged(f->lf.start_of_tile_row);
+}
+
+// finishes decoding a frame without frame threading, once all of its tile
+// groups were received; returns >0 if decoding it didn't complete yet (refer
+// to dav1d_decode_frame_main())
+static int decode_frame_tiles(Dav1dFrameContext *const f) {
+    const int n_tiles = f->frame_hdr->tiling.cols * f->frame_hdr->tiling.rows;
+    int res;
+    if (f->c->n_tc > 1) {
+        if (atomic_load(&f->n_tiles_ready) < n_tiles) return 1;
+        // wait until all threads have completed
+        pthread_mutex_lock(&f->task_thread.ttd->lock);
+        while (!f->task_thread.done[0] ||
+               atomic_load(&f->task_thread.task_counter) > 0)
+        {
+            pthread_cond_wait(&f->task_thread.cond,
+                              &f->task_thread.ttd->lock);
+        }
+        pthread_mutex_unlock(&f->task_thread.ttd->lock);
+        res = f->task_thread.retval;
+    } else {
+        res = dav1d_decode_frame_main(f);
+        if (res > 0) return res;
+        if (!res && f->frame_hdr->refresh_context && f->task_thread.update_set) {
+            dav1d_cdf_thread_update(f->frame_hdr, f->out_cdf.data.cdf,
+                                    &f->ts[f->frame_hdr->tiling.update].cdf);
+        }
+    }
+    dav1d_decode_frame_exit(f, res);
+    res = f->task_thread.retval;
+    f->n_tile_data = 0;
+    return res;
+}
+
+int dav1d_decode_frame(Dav1dContext *const c, Dav1dFrameContext *const f) {
+    assert(c->n_fc == 1);
     // if n_tc > 1 (but n_fc == 1), we could run init/exit in the task
     // threads also. Not sure it makes a measurable difference.
+    // without worker threads, the decoding thread traces the frame's tasks,
+    // otherwise it only accounts the time of the setup it runs outside of them
+    Dav1dTaskContext *const tc = c->n_tc == 1 ? c->tc : NULL;
+    uint64_t start = tc ? 0 : dav1d_stage_time_start(c);
+    if (tc)
+        dav1d_trace_task_begin(tc, DAV1D_TASK_TYPE_INIT, 0, -1, f->sr_cur.p.m.timestamp);
     int res = dav1d_decode_frame_init(f);
+    if (!res && atomic_load(&f->task_thread.error)) res = DAV1D_ERR(EINVAL);
+    if (tc) dav1d_trace_task_next(tc, DAV1D_TASK_TYPE_INIT_CDF);
+    dav1d_stage_time_lap(&c->caller_times.task[DAV1D_TASKTRACE_INIT], &start);
     if (!res) res = dav1d_decode_frame_init_cdf(f);
-    // wait until all threads have completed
-    if (!res) {
-        if (f->c->n_tc > 1) {
-            res = dav1d_task_create_tile_sbrow(f, 0, 1);
-            pthread_mutex_lock(&f->task_thread.ttd->lock);
-            pthread_cond_signal(&f->task_thread.ttd->cond);
-            if (!res) {
-                while (!f->task_thread.done[0] ||
-                       atomic_load(&f->task_thread.task_counter) > 0)
-                {
-                    pthread_cond_wait(&f->task_thread.cond,
-                                      &f->task_thread.ttd->lock);
-                }
-            }
-            pthread_mutex_unlock(&f->task_thread.ttd->lock);
-            res = f->task_thread.retval;
-        } else {
-            res = dav1d_decode_frame_main(f);
-            if (!res && f->frame_hdr->refresh_context && f->task_thread.update_set) {
-                dav1d_cdf_thread_update(f->frame_hdr, f->out_cdf.data.cdf,
-                                        &f->ts[f->frame_hdr->tiling.update].cdf);
-            }
-        }
+    if (tc) dav1d_trace_task_end(tc);
+    dav1d_stage_time_lap(&c->caller_times.task[DAV1D_TASKTRACE_INIT_CDF], &start);
+    if (!res && c->n_tc > 1) {
+        if (dav1d_task_create_tile_sbrow(f, 0, 1))
+            res = DAV1D_ERR(ENOMEM);
+        pthread_mutex_lock(&f->task_thread.ttd->lock);
+        dav1d_task_signal(f->task_thread.ttd);
+        pthread_mutex_unlock(&f->task_thread.ttd->lock);
     }
+    if (!res) return decode_frame_tiles(f);
     dav1d_decode_frame_exit(f, res);
     res = f->task_thread.retval;
     f->n_tile_data = 0;
@@ -3345,50 +3696,132 @@ static int get_upscale_x0(const int in_w, const int out_w, const int step) {
     return x0 & 0x3fff;
 }
 
+// exponential moving average, with a weight of 1/8 for new samples
+static inline uint64_t update_average(const uint64_t avg, const uint64_t sample) {
+    return avg ? avg - (avg >> 3) + (sample >> 3) : sample;
+}
+
+/*
+ * Adapts the number of frames in flight to the latency target, using the
+ * decoding time of a frame which was just output. A frame is output once
+ * delay later frames have been sent, so the latency is about delay times the
+ * input interval (and at least the decoding time, which fewer frames in
+ * flight also reduce). With delay frames decoded in parallel, the throughput
+ * is about delay divided by the decoding time, which must not fall below the
+ * floor.
+ */
+static void update_frame_delay(Dav1dContext *const c, const Dav1dFrameContext *const f) {
+    c->latency.dec_ns = update_average(c->latency.dec_ns, f->frame_thread.done_time -
+                                                          f->frame_thread.submit_time);
+    unsigned delay = c->n_fc;
+    if (c->latency.target_frames)
+        delay = umin(delay, c->latency.target_frames);
+    if (c->latency.target_ns && c->latency.in_ns) {
+        const uint64_t n = c->latency.target_ns / c->latency.in_ns;
+        if (n < delay) delay = (unsigned) n;
+    }
+    if (c->latency.min_fps) {
+        const uint64_t n =
+            ((uint64_t) c->latency.min_fps * c->latency.dec_ns + 999999999) / 1000000000;
+        if (n > delay) delay = n < c->n_fc ? (unsigned) n : c->n_fc;
+    }
+    delay = umax(delay, 1);
+    // one step at a time, to let the averages settle
+    if (delay > c->frame_thread.delay)
+        c->frame_thread.delay++;
+    else if (delay < c->frame_thread.delay)
+        c->frame_thread.delay--;
+}
+
+// drops the output picture and the references to a frame which failed to
+// decode without frame threading
+static void drop_frame_refs(Dav1dContext *const c,
+                            const unsigned refresh_frame_flags)
+{
+    dav1d_thread_picture_unref(&c->out);
+    for (int i = 0; i < 8; i++) {
+        if (refresh_frame_flags & (1 << i)) {
+            if (c->refs[i].p.p.frame_hdr)
+                dav1d_thread_picture_unref(&c->refs[i].p);
+            dav1d_cdf_thread_unref(&c->cdf[i]);
+            dav1d_ref_dec(&c->refs[i].segmap);
+            dav1d_ref_dec(&c->refs[i].refmvs);
+        }
+    }
+}
+
+// continues decoding the frame in progress without frame threading
+static int resume_frame(Dav1dContext *const c) {
+    Dav1dFrameContext *const f = c->fc;
+    const unsigned refresh_frame_flags = f->frame_hdr->refresh_frame_flags;
+    const int res = decode_frame_tiles(f);
+    if (res < 0) {
+        drop_frame_refs(c, refresh_frame_flags);
+        dav1d_data_props_copy(&c->cached_error_props, &c->in.m);
+    }
+    return res;
+}
+
 int dav1d_submit_frame(Dav1dContext *const c) {
     Dav1dFrameContext *f;
     int res = -1;
 
-    // wait for c->out_delayed[next] and move into c->out if visible
+    // wait for c->out_delayed[next] and move into c->out if visible, once
+    // the frame delay is reached
     Dav1dThreadPicture *out_delayed;
     if (c->n_fc > 1) {
         pthread_mutex_lock(&c->task_thread.lock);
-        const unsigned next = c->frame_thread.next++;
-        if (c->frame_thread.next == c->n_fc)
-            c->frame_thread.next = 0;
-
-        f = &c->fc[next];
-        while (f->n_tile_data > 0)
-            pthread_cond_wait(&f->task_thread.cond,
-                              &c->task_thread.lock);
-        out_delayed = &c->frame_thread.out_delayed[next];
-        if (out_delayed->p.data[0] || atomic_load(&f->task_thread.error)) {
-            unsigned first = atomic_load(&c->task_thread.first);
-            if (first + 1U < c->n_fc)
-                atomic_fetch_add(&c->task_thread.first, 1U);
-            else
-                atomic_store(&c->task_thread.first, 0);
-            atomic_compare_exchange_strong(&c->task_thread.reset_task_cur,
-                                           &first, UINT_MAX);
-            if (c->task_thread.cur && c->task_thread.cur < c->n_fc)
-                c->task_thread.cur--;
-        }
-        const int error = f->task_thread.retval;
-        if (error) {
-            f->task_thread.retval = 0;
-            c->cached_error = error;
-            dav1d_data_props_copy(&c->cached_error_props, &out_delayed->p.m);
-            dav1d_thread_picture_unref(out_delayed);
-        } else if (out_delayed->p.data[0]) {
-            const unsigned progress = atomic_load_explicit(&out_delayed->progress[1],
-                                                           memory_order_relaxed);
-            if ((out_delayed->visible || c->output_invisible_frames) &&
-                progress != FRAME_ERROR)
-            {
-                dav1d_thread_picture_ref(&c->out, out_delayed);
-                c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
+        if (c->frame_thread.n_busy >= c->frame_thread.delay) {
+            const unsigned next = c->frame_thread.next++;
+            if (c->frame_thread.next == c->n_fc)
+                c->frame_thread.next = 0;
+            c->frame_thread.n_busy--;
+
+            f = &c->fc[next];
+            while (f->n_tile_data > 0)
+                pthread_cond_wait(&f->task_thread.cond,
+                                  &c->task_thread.lock);
+            out_delayed = &c->frame_thread.out_delayed[next];
+            if (out_delayed->p.data[0] || atomic_load(&f->task_thread.error)) {
+                unsigned first = atomic_load(&c->task_thread.first);
+                if (first + 1U < c->n_fc)
+                    atomic_fetch_add(&c->task_thread.first, 1U);
+                else
+                    atomic_store(&c->task_thread.first, 0);
+            }
+            const int error = f->task_thread.retval;
+            if (error) {
+                f->task_thread.retval = 0;
+                c->cached_error = error;
+                dav1d_data_props_copy(&c->cached_error_props, &out_delayed->p.m);
+                dav1d_thread_picture_unref(out_delayed);
+            } else if (out_delayed->p.data[0]) {
+                const unsigned progress = atomic_load_explicit(&out_delayed->progress[1],
+                                                               memory_order_relaxed);
+                if ((out_delayed->visible || c->output_invisible_frames) &&
+                    progress != FRAME_ERROR && !f->frame_thread.early_output)
+                {
+                    dav1d_thread_picture_ref(&c->out, out_delayed);
+                    c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
+                }
+                dav1d_thread_picture_unref(out_delayed);
+                if (f->frame_thread.done_time)
+                    update_frame_delay(c, f);
             }
-            dav1d_thread_picture_unref(out_delayed);
+        }
+
+        unsigned slot = c->frame_thread.next + c->frame_thread.n_busy++;
+        if (slot >= c->n_fc) slot -= c->n_fc;
+        f = &c->fc[slot];
+        out_delayed = &c->frame_thread.out_delayed[slot];
+        f->frame_thread.early_output = 0;
+        if (c->latency.target_ns || c->latency.target_frames) {
+            const uint64_t now = dav1d_get_time_nanos();
+            if (c->latency.last_submit)
+                c->latency.in_ns = update_average(c->latency.in_ns,
+                                                  now - c->latency.last_submit);
+            c->latency.last_submit = f->frame_thread.submit_time = now;
+            f->frame_thread.done_time = 0;
         }
     } else {
         f = c->fc;
@@ -3445,6 +3878,7 @@ int dav1d_submit_frame(Dav1dContext *const c) {
         f->bd_fn.filter_sbrow_cdef = dav1d_filter_sbrow_cdef_##bd##bpc; \
         f->bd_fn.filter_sbrow_resize = dav1d_filter_sbrow_resize_##bd##bpc; \
         f->bd_fn.filter_sbrow_lr = dav1d_filter_sbrow_lr_##bd##bpc; \
+        f->bd_fn.downscale_sbrows = dav1d_downscale_sbrows_##bd##bpc; \
         f->bd_fn.backup_ipred_edge = dav1d_backup_ipred_edge_##bd##bpc; \
         f->bd_fn.read_coef_blocks = dav1d_read_coef_blocks_##bd##bpc; \
         f->bd_fn.copy_pal_block_y = dav1d_copy_pal_block_y_##bd##bpc; \
@@ -3523,9 +3957,9 @@ int dav1d_submit_frame(Dav1dContext *const c) {
 
     // FIXME qsort so tiles are in order (for frame threading)
     if (f->n_tile_data_alloc < c->n_tile_data) {
-        dav1d_free(f->tile);
+        dav1d_free_charged(f->tile);
         assert(c->n_tile_data < INT_MAX / (int)sizeof(*f->tile));
-        f->tile = dav1d_malloc(ALLOC_TILE, c->n_tile_data * sizeof(*f->tile));
+        f->tile = dav1d_malloc_charged(c->mem, ALLOC_TILE, c->n_tile_data * sizeof(*f->tile));
         if (!f->tile) {
             f->n_tile_data_alloc = f->n_tile_data = 0;
             res = DAV1D_ERR(ENOMEM);
@@ -3538,9 +3972,37 @@ int dav1d_submit_frame(Dav1dContext *const c) {
     f->n_tile_data = c->n_tile_data;
     c->n_tile_data = 0;
 
+    const int n_tiles = f->frame_hdr->tiling.cols * f->frame_hdr->tiling.rows;
+    if (f->tile_data_alloc < n_tiles) {
+        dav1d_free_charged(f->tile_data);
+        f->tile_data = dav1d_malloc_charged(c->mem, ALLOC_TILE, n_tiles * sizeof(*f->tile_data));
+        if (!f->tile_data) {
+            f->tile_data_alloc = 0;
+            res = DAV1D_ERR(ENOMEM);
+            goto error;
+        }
+        f->tile_data_alloc = n_tiles;
+    }
+    atomic_init(&f->n_tiles_ready, 0);
+    atomic_init(&f->task_thread.error, 0);
+    // the tasks parked on the frame previously decoded in this context were
+    // all queued again once it completed
+    assert(!f->task_thread.ref_waiters && !f->task_thread.data_waiters);
+    f->task_thread.ref_waiters = f->task_thread.data_waiters = NULL;
+    f->next_tile_row = f->next_sby = 0;
+    // invalid tile sizes fail the frame once it is being decoded
+    if (add_tile_data(f, 0))
+        atomic_init(&f->task_thread.error, 1);
+
     // allocate frame
     res = dav1d_thread_picture_alloc(c, f, bpc);
     if (res < 0) goto error;
+    if (c->output_downscale && (f->frame_hdr->show_frame || f->frame_hdr->showable_frame ||
+                                c->output_invisible_frames))
+    {
+        res = dav1d_picture_alloc_scaled(c, &f->sr_cur.p, c->output_downscale);
+        if (res < 0) goto error;
+    }
 
     if (f->frame_hdr->width[0] != f->frame_hdr->width[1]) {
         res = dav1d_picture_alloc_copy(c, &f->cur, f->frame_hdr->width[0], &f->sr_cur.p);
@@ -3581,7 +4043,6 @@ int dav1d_submit_frame(Dav1dContext *const c) {
     f->sbh = (f->bh + f->sb_step - 1) >> f->sb_shift;
     f->b4_stride = (f->bw + 31) & ~31;
     f->bitdepth_max = (1 << f->cur.p.bpc) - 1;
-    atomic_init(&f->task_thread.error, 0);
     const int uses_2pass = c->n_fc > 1;
     const int cols = f->frame_hdr->tiling.cols;
     const int rows = f->frame_hdr->tiling.rows;
@@ -3716,20 +4177,24 @@ int dav1d_submit_frame(Dav1dContext *const c) {
     }
 
     if (c->n_fc == 1) {
-        if ((res = dav1d_decode_frame(f)) < 0) {
-            dav1d_thread_picture_unref(&c->out);
-            for (int i = 0; i < 8; i++) {
-                if (refresh_frame_flags & (1 << i)) {
-                    if (c->refs[i].p.p.frame_hdr)
-                        dav1d_thread_picture_unref(&c->refs[i].p);
-                    dav1d_cdf_thread_unref(&c->cdf[i]);
-                    dav1d_ref_dec(&c->refs[i].segmap);
-                    dav1d_ref_dec(&c->refs[i].refmvs);
-                }
-            }
+        if ((res = dav1d_decode_frame(c, f)) < 0) {
+            drop_frame_refs(c, refresh_frame_flags);
             goto error;
         }
-    } else {
+    }
+
+    // the remaining tile groups are handed to the frame as they arrive; with
+    // frame threading this has to happen before the frame is published, since
+    // a failing frame may be exited (dropping its header) as soon as the task
+    // lock is released
+    if (c->n_tiles < n_tiles) {
+        c->tile_frame = f;
+        c->frame_hdr = f->frame_hdr;
+        c->frame_hdr_ref = f->frame_hdr_ref;
+        dav1d_ref_inc(c->frame_hdr_ref);
+    }
+
+    if (c->n_fc > 1) {
         dav1d_task_frame_init(f);
         pthread_mutex_unlock(&c->task_thread.lock);
     }
@@ -3765,3 +4230,96 @@ error:
 
     return res;
 }
+
+// makes the tiles which weren't received yet fail to decode; assumes the
+// task scheduling lock is taken if there are worker threads
+static void fail_tile_frame(Dav1dFrameContext *const f, const int n_tiles) {
+    atomic_store(&f->task_thread.error, 1);
+    atomic_store(&f->n_tiles_ready, n_tiles);
+    if (f->c->n_tc > 1)
+        dav1d_task_tiles_received(f);
+}
+
+static void end_tile_frame(Dav1dContext *const c) {
+    c->tile_frame = NULL;
+    c->frame_hdr = NULL;
+    dav1d_ref_dec(&c->frame_hdr_ref);
+    c->n_tiles = 0;
+}
+
+int dav1d_submit_tile_groups(Dav1dContext *const c) {
+    Dav1dFrameContext *const f = c->tile_frame;
+    const int n_tiles = c->frame_hdr->tiling.cols * c->frame_hdr->tiling.rows;
+    int res = 0, failed = 0;
+
+    if (c->n_tc > 1)
+        pthread_mutex_lock(&c->task_thread.lock);
+    if (f->n_tile_data > 0) {
+        const int n_tile_data = f->n_tile_data + c->n_tile_data;
+        if (f->n_tile_data_alloc < n_tile_data) {
+            struct Dav1dTileGroup *const tile =
+                dav1d_realloc_charged(c->mem, ALLOC_TILE, f->tile,
+                                      n_tile_data * sizeof(*f->tile));
+            if (tile) {
+                f->tile = tile;
+                f->n_tile_data_alloc = n_tile_data;
+            } else {
+                res = DAV1D_ERR(ENOMEM);
+            }
+        }
+        if (!res) {
+            memcpy(f->tile + f->n_tile_data, c->tile, c->n_tile_data * sizeof(*f->tile));
+            memset(c->tile, 0, c->n_tile_data * sizeof(*c->tile));
+            const int first_group = f->n_tile_data;
+            f->n_tile_data = n_tile_data;
+            c->n_tile_data = 0;
+            failed = add_tile_data(f, first_group) < 0;
+        }
+        if (res || failed) {
+            fail_tile_frame(f, n_tiles);
+        } else if (c->n_tc > 1) {
+            dav1d_task_tiles_received(f);
+        }
+    }
+    // drop the tile groups of a frame which already failed
+    for (int i = 0; i < c->n_tile_data; i++)
+        dav1d_data_unref_internal(&c->tile[i].data);
+    c->n_tile_data = 0;
+    if (c->n_tc > 1)
+        pthread_mutex_unlock(&c->task_thread.lock);
+
+    if (c->n_fc == 1) {
+        const int ret = resume_frame(c);
+        if (ret < 0 && !res) res = ret;
+        // a frame decoded in steps may still be in progress once all of its
+        // tile groups were received
+        if (ret > 0 && !res && !failed && c->n_tiles < n_tiles) return 0;
+    } else if (!res && !failed && c->n_tiles < n_tiles) {
+        return 0;
+    }
+    end_tile_frame(c);
+
+    return res;
+}
+
+void dav1d_abort_tile_groups(Dav1dContext *const c) {
+    Dav1dFrameContext *const f = c->tile_frame;
+
+    if (c->n_tc > 1)
+        pthread_mutex_lock(&c->task_thread.lock);
+    fail_tile_frame(f, c->frame_hdr->tiling.cols * c->frame_hdr->tiling.rows);
+    if (c->n_tc > 1)
+        pthread_mutex_unlock(&c->task_thread.lock);
+
+    // frame threads report the error along with the frame's picture
+    if (c->n_fc == 1)
+        c->cached_error = resume_frame(c);
+    end_tile_frame(c);
+}
+
+int dav1d_decode_frame_step(Dav1dContext *const c) {
+    const int res = resume_frame(c);
+    // a failed frame doesn't take the rest of its tile groups
+    if (res < 0 && c->tile_frame) end_tile_frame(c);
+    return res < 0 ? res : res == 2;
+}
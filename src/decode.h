@@ -32,4 +32,13 @@
 
 int dav1d_submit_frame(Dav1dContext *c);
 
+// hand the tile groups received after the frame was submitted to it, or make
+// its missing tiles fail to decode (refer to Dav1dSettings.early_tile_groups)
+int dav1d_submit_tile_groups(Dav1dContext *c);
+void dav1d_abort_tile_groups(Dav1dContext *c);
+
+// continue decoding the frame in progress until the deadline of the running
+// dav1d_decode_step() call; returns 1 if the deadline was reached first
+int dav1d_decode_frame_step(Dav1dContext *c);
+
 #endif /* DAV1D_SRC_DECODE_H */
@@ -103,6 +103,9 @@ struct Dav1dContext {
     int n_tile_data_alloc;
     int n_tile_data;
     int n_tiles;
+    // frame submitted before all of its tile groups were received, which
+    // the following tile group OBUs are handed to
+    Dav1dFrameContext *tile_frame;
     Dav1dMemPool *seq_hdr_pool;
     Dav1dRef *seq_hdr_ref;
     Dav1dSequenceHeader *seq_hdr;
@@ -126,20 +129,24 @@ struct Dav1dContext {
     atomic_int flush_mem, *flush;
     struct {
         Dav1dThreadPicture *out_delayed;
-        unsigned next;
+        unsigned next; // oldest frame in flight
+        unsigned n_busy; // frames in flight, in the slots starting at next
+        unsigned delay; // maximum number of frames in flight, <= n_fc
     } frame_thread;
 
+    // adaptive frame delay (refer to src/decode.c:update_frame_delay())
+    struct {
+        uint64_t target_ns;
+        unsigned target_frames, min_fps;
+        uint64_t last_submit;
+        uint64_t in_ns, dec_ns; // moving averages of input interval and decoding time
+    } latency;
+
     // task threading (refer to tc[] for per_thread thingies)
     struct TaskThreadData {
         pthread_mutex_t lock;
         pthread_cond_t cond;
         atomic_uint first;
-        unsigned cur;
-        // This is used for delayed reset of the task cur pointer when
-        // such operation is needed but the thread doesn't enter a critical
-        // section (typically when executing the next sbrow task locklessly).
-        // See src/thread_task.c:reset_task_cur().
-        atomic_uint reset_task_cur;
         atomic_int cond_signaled;
         struct {
             int exec, finished;
@@ -160,6 +167,10 @@ struct Dav1dContext {
             };
         } delayed_fg;
         int inited;
+        // shared worker pool running this context's tasks (NULL if the
+        // context spawned its own worker threads)
+        Dav1dThreadPool *pool;
+        unsigned pool_active; // pool workers inside this context, protected by pool->lock
     } task_thread;
 
     // reference/entropy state
@@ -185,10 +196,21 @@ struct Dav1dContext {
     int all_layers;
     int max_spatial_id;
     unsigned frame_size_limit;
+    unsigned hbd_frame_size_limit; // lower when set by the memory budget
     int strict_std_compliance;
     int output_invisible_frames;
     enum Dav1dInloopFilterType inloop_filters;
     enum Dav1dDecodeFrameType decode_frame_type;
+    int output_downscale;
+    int early_output;
+    int early_tile_groups;
+    int huge_pages;
+    int stage_times;
+    int trace_tasks; // task stages are timed, for stage_times or the tracer
+    Dav1dStageTimes caller_times; // stages run by the thread calling the API
+    int step_decoding;
+    uint64_t step_deadline; // end of the running dav1d_decode_step() (ns), or 0
+    enum Dav1dThreadPriority thread_priority;
     int drain;
     enum PictureFlags frame_flags;
     enum Dav1dEventFlags event_flags;
@@ -196,9 +218,28 @@ struct Dav1dContext {
     int cached_error;
 
     Dav1dLogger logger;
+    Dav1dTaskTracer tracer;
+    Dav1dPictureNotifier picture_notifier;
+    int picture_fd; // eventfd signaled along with picture_notifier, or -1
 
     Dav1dMemPool *picture_pool;
     Dav1dMemPool *pic_ctx_pool;
+
+    Dav1dMemAccount *mem;
+};
+
+struct Dav1dThreadPool {
+    pthread_mutex_t lock;
+    pthread_cond_t cond; // signaled when any attached context has new work
+    pthread_cond_t idle_cond; // signaled when workers leave a context
+    Dav1dContext **ctx; // attached decoder contexts
+    int n_ctx, n_ctx_alloc;
+    int next_ctx; // round-robin position for fair scheduling
+    unsigned signal_cnt;
+    int die;
+    unsigned n_threads;
+    pthread_t *threads; // NULL if tasks are run by an external executor
+    Dav1dTaskExecutor executor;
 };
 
 struct Dav1dTask {
@@ -207,9 +248,10 @@ struct Dav1dTask {
     int sby;                    // sbrow
 
     // task dependencies
-    int recon_progress, deblock_progress;
+    int recon_progress; // for post-filter tasks, set until they're started
     int deps_skip;
-    struct Dav1dTask *next; // only used in task queue
+    unsigned ref_progress; // for tile tasks, progress of refp[deps_skip] needed
+    struct Dav1dTask *next; // used in task queue and waiter lists
 };
 
 struct Dav1dFrameContext {
@@ -232,6 +274,15 @@ struct Dav1dFrameContext {
     struct Dav1dTileGroup *tile;
     int n_tile_data_alloc;
     int n_tile_data;
+    // tile payloads split from the tile groups; tiles below n_tiles_ready
+    // have been received and can be decoded
+    struct Dav1dTileData {
+        const uint8_t *data;
+        size_t sz;
+    } *tile_data;
+    int tile_data_alloc;
+    atomic_int n_tiles_ready;
+    int next_tile_row, next_sby; // to resume decoding without tile threads
 
     // for scalable references
     struct ScalableMotionParams {
@@ -253,6 +304,7 @@ struct Dav1dFrameContext {
         void (*filter_sbrow_cdef)(Dav1dTaskContext *tc, int sby);
         filter_sbrow_fn filter_sbrow_resize;
         filter_sbrow_fn filter_sbrow_lr;
+        downscale_sbrows_fn downscale_sbrows;
         backup_ipred_edge_fn backup_ipred_edge;
         read_coef_blocks_fn read_coef_blocks;
         copy_pal_block_fn copy_pal_block_y;
@@ -274,22 +326,22 @@ struct Dav1dFrameContext {
     int bitdepth_max;
 
     struct {
-        int next_tile_row[2 /* 0: reconstruction, 1: entropy */];
-        atomic_int entropy_progress;
-        atomic_int deblock_progress; // in sby units
-        atomic_uint *frame_progress, *copy_lpf_progress;
-        // indexed using t->by * f->b4_stride + t->bx
-        Av1Block *b;
+        atomic_uint *frame_progress;
         int16_t *cbi; /* bits 0-4: txtp, bits 5-15: eob */
         // indexed using (t->by >> 1) * (f->b4_stride >> 1) + (t->bx >> 1)
         pixel (*pal)[3 /* plane */][8 /* idx */];
         // iterated over inside tile state
+        Av1Block *b; /* one per coded block, in decoding order */
         uint8_t *pal_idx;
         coef *cf;
         int prog_sz;
         int cbi_sz, pal_sz, pal_idx_sz, cf_sz;
         // start offsets per tile
         unsigned *tile_start_off;
+        // submission and completion time (ns), when adapting to a latency target
+        uint64_t submit_time, done_time;
+        // picture already returned while decoding (refer to Dav1dSettings.early_output)
+        int early_output;
     } frame_thread;
 
     // loopfilter
@@ -325,18 +377,29 @@ struct Dav1dFrameContext {
         struct TaskThreadData *ttd;
         struct Dav1dTask *tasks, *tile_tasks[2], init_task;
         int num_tasks, num_tile_tasks;
+        // per sbrow (and pass), the number of tile sbrows and preceding
+        // post-filter tasks its post-filter task still waits for; it is
+        // queued by whichever of them completes last
+        atomic_int *filter_deps;
+        // per sbrow, 1 once the preceding sbrow was deblocked (or backed up
+        // for CDEF/LR), or 2 if its post-filter task is waiting for that
+        atomic_int *filter_row_deps;
         atomic_int init_done;
         atomic_int done[2];
         int retval;
         int update_set; // whether we need to update CDF reference
         atomic_int error;
         atomic_int task_counter;
+        int downscale_sby; // sbrows downscaled for output (under lock)
+        int node; // NUMA node the frame's memory is bound to, -1 = any
+        // only holds tasks which can run (or whose dependencies were
+        // resolved since), blocked tile tasks are parked in waiter lists
         struct Dav1dTask *task_head, *task_tail;
-        // Points to the task directly before the cur pointer in the queue.
-        // This cur pointer is theoretical here, we actually keep track of the
-        // "prev_t" variable. This is needed to not loose the tasks in
-        // [head;cur-1] when picking one for execution.
-        struct Dav1dTask *task_cur_prev;
+        // tile tasks of other frames waiting for the progress of this frame
+        // (protected by lock), and tile tasks of this frame waiting for their
+        // tile data (protected by ttd->lock)
+        // See src/thread_task.c:park_tile_task().
+        struct Dav1dTask *ref_waiters, *data_waiters;
         struct { // async task insertion
             atomic_int merge;
             pthread_mutex_t lock;
@@ -362,7 +425,11 @@ struct Dav1dTileState {
 
     // in sby units, TILE_ERROR after a decoding error
     atomic_int progress[2 /* 0: reconstruction, 1: entropy */];
+    // 1 while the reconstruction task is parked waiting for the entropy
+    // decoding of its sbrow
+    atomic_int recon_waiting;
     struct {
+        Av1Block *b;
         uint8_t *pal_idx;
         int16_t *cbi;
         coef *cf;
@@ -465,7 +532,15 @@ struct Dav1dTaskContext {
         struct FrameTileThreadData *fttd;
         int flushed;
         int die;
+        int claimed; // in use by a pool worker, protected by pool->lock
+        int node; // NUMA node the worker is pinned to, -1 = any
+        atomic_int os_tid; // set by the worker once started, 0 if unknown
     } task_thread;
+    struct {
+        Dav1dTaskTraceEvent event; // task currently being executed
+        int active;
+        uint64_t stage_ns[DAV1D_TASKTRACE_FG_APPLY + 1]; // for stage_times
+    } trace;
 };
 
 #endif /* DAV1D_SRC_INTERNAL_H */
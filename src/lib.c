@@ -34,6 +34,10 @@
 #if defined(__linux__) && defined(HAVE_DLSYM)
 #include <dlfcn.h>
 #endif
+#ifdef HAVE_EVENTFD
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 #include "dav1d/dav1d.h"
 #include "dav1d/data.h"
@@ -41,6 +45,7 @@
 #include "common/validate.h"
 
 #include "src/cpu.h"
+#include "src/decode.h"
 #include "src/fg_apply.h"
 #include "src/internal.h"
 #include "src/log.h"
@@ -48,8 +53,11 @@
 #include "src/qm.h"
 #include "src/ref.h"
 #include "src/thread_task.h"
+#include "src/trace.h"
 #include "src/wedge.h"
 
+static pthread_once_t initted = PTHREAD_ONCE_INIT;
+
 static COLD void init_internal(void) {
     dav1d_init_cpu();
     dav1d_init_ii_wedge_masks();
@@ -84,6 +92,28 @@ COLD void dav1d_default_settings(Dav1dSettings *const s) {
     s->output_invisible_frames = 0;
     s->inloop_filters = DAV1D_INLOOPFILTER_ALL;
     s->decode_frame_type = DAV1D_DECODEFRAMETYPE_ALL;
+    s->thread_pool = NULL;
+    s->tracer.cookie = NULL;
+    s->tracer.callback = NULL;
+    s->picture_pool_limit = 0;
+    s->memory_budget = 0;
+    s->output_downscale = 0;
+    s->thread_placement = DAV1D_THREADPLACEMENT_NONE;
+    s->thread_cpus = NULL;
+    s->n_thread_cpus = 0;
+    s->thread_pinning = DAV1D_THREADPINNING_NONE;
+    s->thread_priority = DAV1D_THREADPRIORITY_DEFAULT;
+    s->latency_target_ms = 0;
+    s->latency_target_frames = 0;
+    s->min_fps = 0;
+    s->picture_notifier.cookie = NULL;
+    s->picture_notifier.callback = NULL;
+    s->picture_eventfd = 0;
+    s->early_output = 0;
+    s->early_tile_groups = 0;
+    s->step_decoding = 0;
+    s->huge_pages = 0;
+    s->stage_times = 0;
 }
 
 static void close_internal(Dav1dContext **const c_out, int flush);
@@ -104,6 +134,79 @@ static COLD size_t get_stack_size_internal(const pthread_attr_t *const thread_at
     return 0;
 }
 
+// largest frame size allowed by any AV1 level
+#define MAX_LEVEL_FRAME_AREA (8192 * 4352)
+
+/* Memory used for decoding frames of the given area in pixels, as allocated
+ * for 4:2:0 content of the given bit-depth: the pictures and the per-frame
+ * buffers, sized for the configured frame and task thread counts. Buffers
+ * scaling with the frame width assume a 16:9 aspect ratio, and at most 4 tile
+ * rows decoded in parallel. Input data and palette buffers of screen content
+ * aren't included. */
+static COLD size_t estimate_memory_usage(const unsigned n_fc, const unsigned n_tc,
+                                         const size_t area, const int hbd)
+{
+    size_t w = 8;
+    while (w * w * 9 < area * 16) w += 8;
+    const size_t h = (area + w - 1) / w;
+    const size_t sb128w = (w + 127) >> 7, sb128h = (h + 127) >> 7;
+    const size_t num_sb128 = sb128w * sb128h;
+    const size_t sbh = (h + 63) >> 6; // with 64x64 superblocks
+    const size_t b4_stride = (((w + 3) >> 2) + 31) & ~31;
+    size_t sz = sizeof(Dav1dContext) + sizeof(Dav1dFrameContext) * n_fc +
+                sizeof(Dav1dTaskContext) * n_tc;
+
+    // references, frames in flight and one picture held by the caller, each
+    // with their motion vectors and segmentation map
+    const size_t aligned_w = (w + 127) & ~127, aligned_h = (h + 127) & ~127;
+    size_t y_stride = aligned_w << hbd, uv_stride = y_stride >> 1;
+    if (!(y_stride & 1023)) y_stride += DAV1D_PICTURE_ALIGNMENT;
+    if (!(uv_stride & 1023)) uv_stride += DAV1D_PICTURE_ALIGNMENT;
+    const size_t pic_sz = y_stride * aligned_h + uv_stride * aligned_h +
+                          DAV1D_PICTURE_ALIGNMENT +
+                          sizeof(refmvs_temporal_block) * sb128h * 16 * (b4_stride >> 1) +
+                          b4_stride * 32 * sb128h;
+    sz += pic_sz * (8 + n_fc + 1);
+
+    // loopfilter levels and masks, the line buffers of cdef and of loop
+    // restoration (for all sbrows when using multiple threads), the intra
+    // edges, and the motion vectors and above context of each tile row
+    const size_t n_tile_rows = n_tc > 1 ? umin((unsigned) sbh, 4) : 1;
+    const size_t lr_lines = n_tc > 1 ? sbh * 4 : 12;
+    size_t fc_sz = num_sb128 * (sizeof(Av1Filter) + 32 * 32 * 4);
+    fc_sz += (y_stride * 4 + uv_stride * 8) * sbh;
+    fc_sz += (y_stride + uv_stride * 2) * lr_lines;
+    fc_sz += (sbh * sb128w << hbd) * 128 * 3;
+    fc_sz += (aligned_w >> 3) * n_tile_rows *
+             (sizeof(refmvs_block) * 35 * 2 * (1 + (n_fc > 1)) +
+              sizeof(refmvs_temporal_block) * 16);
+    fc_sz += sizeof(BlockContext) * sb128w * n_tile_rows * (1 + (n_fc > 1 && n_tc > 1));
+    if (n_fc > 1) {
+        // block data, coefficients and their info of the first pass
+        fc_sz += num_sb128 * (sizeof(Av1Block) * 32 * 32 +
+                              sizeof(int16_t) * 6 * 32 * 32 / 4 +
+                              (6 << hbd) * 128 * 128 / 2);
+    }
+    return sz + fc_sz * n_fc;
+}
+
+// Returns the largest frame area whose decoding at the given bit-depth is
+// estimated to fit in the memory budget, or 0 if none does.
+static COLD size_t get_budget_frame_area(const unsigned n_fc, const unsigned n_tc,
+                                         const size_t budget, const int hbd)
+{
+    size_t lo = 0, hi = MAX_LEVEL_FRAME_AREA;
+    if (estimate_memory_usage(n_fc, n_tc, 64 * 64, hbd) > budget) return 0;
+    while (lo < hi) {
+        const size_t mid = (lo + hi + 1) >> 1;
+        if (estimate_memory_usage(n_fc, n_tc, mid, hbd) <= budget)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return lo;
+}
+
 static COLD void get_num_threads(Dav1dContext *const c, const Dav1dSettings *const s,
                                  unsigned *n_tc, unsigned *n_fc)
 {
@@ -117,88 +220,113 @@ static COLD void get_num_threads(Dav1dContext *const c, const Dav1dSettings *con
         6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,       /* 26-36 */
         7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, /* 37-49 */
     };
-    *n_tc = s->n_threads ? s->n_threads :
-        iclip(dav1d_num_logical_processors(c), 1, DAV1D_MAX_THREADS);
+    if (s->thread_pool) {
+        // task contexts beyond the pool's worker count would never run
+        const unsigned n_pool = s->thread_pool->n_threads;
+        *n_tc = s->n_threads ? umin(s->n_threads, n_pool) : n_pool;
+    } else {
+        *n_tc = s->n_threads ? s->n_threads :
+            iclip(dav1d_num_logical_processors(c), 1, DAV1D_MAX_THREADS);
+    }
     *n_fc = s->max_frame_delay ? umin(s->max_frame_delay, *n_tc) :
             *n_tc < 50 ? fc_lut[*n_tc - 1] : 8; // min(8, ceil(sqrt(n)))
+    if (s->memory_budget) {
+        // frame threading multiplies the per-frame buffers, so trade it for
+        // the largest expected frame size fitting in the budget
+        const size_t area = s->frame_size_limit ? s->frame_size_limit :
+                                                  MAX_LEVEL_FRAME_AREA;
+        while (*n_fc > 1 &&
+               estimate_memory_usage(*n_fc, *n_tc, area, 0) > s->memory_budget)
+        {
+            (*n_fc)--;
+        }
+    }
 }
 
-COLD int dav1d_get_frame_delay(const Dav1dSettings *const s) {
-    unsigned n_tc, n_fc;
-    validate_input_or_ret(s != NULL, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->n_threads >= 0 &&
-                          s->n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->max_frame_delay >= 0 &&
-                          s->max_frame_delay <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
-
-    get_num_threads(NULL, s, &n_tc, &n_fc);
-    return n_fc;
-}
-
-COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
-    static pthread_once_t initted = PTHREAD_ONCE_INIT;
-    pthread_once(&initted, init_internal);
-
-    validate_input_or_ret(c_out != NULL, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s != NULL, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->n_threads >= 0 &&
-                          s->n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->max_frame_delay >= 0 &&
-                          s->max_frame_delay <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->allocator.alloc_picture_callback != NULL,
-                          DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->allocator.release_picture_callback != NULL,
-                          DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->operating_point >= 0 &&
-                          s->operating_point <= 31, DAV1D_ERR(EINVAL));
-    validate_input_or_ret(s->decode_frame_type >= DAV1D_DECODEFRAMETYPE_ALL &&
-                          s->decode_frame_type <= DAV1D_DECODEFRAMETYPE_KEY, DAV1D_ERR(EINVAL));
-
-    pthread_attr_t thread_attr;
-    if (pthread_attr_init(&thread_attr)) return DAV1D_ERR(ENOMEM);
-    size_t stack_size = 1024 * 1024 + get_stack_size_internal(&thread_attr);
-
-    pthread_attr_setstacksize(&thread_attr, stack_size);
-
-    Dav1dContext *const c = *c_out = dav1d_alloc_aligned(ALLOC_COMMON_CTX, sizeof(*c), 64);
-    if (!c) goto error;
-    memset(c, 0, sizeof(*c));
-
-    c->allocator = s->allocator;
-    c->logger = s->logger;
-    c->apply_grain = s->apply_grain;
-    c->operating_point = s->operating_point;
-    c->all_layers = s->all_layers;
-    c->frame_size_limit = s->frame_size_limit;
-    c->strict_std_compliance = s->strict_std_compliance;
-    c->output_invisible_frames = s->output_invisible_frames;
-    c->inloop_filters = s->inloop_filters;
-    c->decode_frame_type = s->decode_frame_type;
+#define MAX_CPU_DOMAINS 64
 
-    dav1d_data_props_set_defaults(&c->cached_error_props);
+/*
+ * Restricts workers to the CPUs requested in the settings. With a thread
+ * placement, contiguous groups of workers are pinned to the CPUs of each
+ * NUMA node or L3 domain, and the memory of contiguous groups of frame
+ * contexts is bound to the corresponding nodes. Workers prefer initializing
+ * frames local to them, which is when most of the frame's memory is first
+ * touched.
+ */
+static COLD void place_threads(Dav1dContext *const c, const Dav1dSettings *const s) {
+#if HAVE_CPU_PLACEMENT
+    cpu_set_t allowed;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed)) return;
+    if (s->n_thread_cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int i = 0; i < s->n_thread_cpus; i++)
+            if ((unsigned) s->thread_cpus[i] < CPU_SETSIZE)
+                CPU_SET(s->thread_cpus[i], &set);
+        CPU_AND(&set, &set, &allowed);
+        if (CPU_COUNT(&set))
+            allowed = set;
+        else
+            dav1d_log(c, "None of the requested thread CPUs is usable, ignoring them.\n");
+    }
 
-    if (dav1d_mem_pool_init(ALLOC_OBU_HDR, &c->seq_hdr_pool) ||
-        dav1d_mem_pool_init(ALLOC_OBU_HDR, &c->frame_hdr_pool) ||
-        dav1d_mem_pool_init(ALLOC_SEGMAP, &c->segmap_pool) ||
-        dav1d_mem_pool_init(ALLOC_REFMVS, &c->refmvs_pool) ||
-        dav1d_mem_pool_init(ALLOC_PIC_CTX, &c->pic_ctx_pool) ||
-        dav1d_mem_pool_init(ALLOC_CDF, &c->cdf_pool))
-    {
-        goto error;
+    Dav1dCpuDomain *const domains =
+        dav1d_malloc(ALLOC_THREAD_CTX, sizeof(*domains) * MAX_CPU_DOMAINS);
+    if (!domains) return;
+    int n_domains = 0;
+    if (s->thread_placement != DAV1D_THREADPLACEMENT_NONE) {
+        n_domains = dav1d_get_cpu_domains(domains, MAX_CPU_DOMAINS,
+                                          s->thread_placement, &allowed);
+        if (n_domains < 2)
+            dav1d_log(c, n_domains ? "Single CPU domain, thread placement disabled.\n" :
+                      "Unable to detect CPU topology, thread placement disabled.\n");
+    }
+    const int placed = n_domains >= 2;
+    if (!placed) {
+        domains[0].cpus = allowed;
+        domains[0].node = -1;
+        n_domains = 1;
     }
 
-    if (c->allocator.alloc_picture_callback   == dav1d_default_picture_alloc &&
-        c->allocator.release_picture_callback == dav1d_default_picture_release)
-    {
-        if (c->allocator.cookie) goto error;
-        if (dav1d_mem_pool_init(ALLOC_PIC, &c->picture_pool)) goto error;
-        c->allocator.cookie = c->picture_pool;
-    } else if (c->allocator.alloc_picture_callback   == dav1d_default_picture_alloc ||
-               c->allocator.release_picture_callback == dav1d_default_picture_release)
-    {
-        goto error;
+    int n_pinned[MAX_CPU_DOMAINS] = { 0 };
+    pthread_mutex_lock(&c->task_thread.lock);
+    for (unsigned m = 0; m < c->n_tc; m++) {
+        Dav1dTaskContext *const t = &c->tc[m];
+        const int d = m * n_domains / c->n_tc;
+        cpu_set_t set = domains[d].cpus;
+        if (s->thread_pinning == DAV1D_THREADPINNING_CPU) {
+            // the n-th worker of the domain gets its n-th CPU
+            int k = n_pinned[d]++ % CPU_COUNT(&set), cpu = 0;
+            for (;; cpu++)
+                if (CPU_ISSET(cpu, &set) && !k--) break;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+        } else if (!placed && !s->n_thread_cpus) {
+            continue;
+        }
+        if (pthread_setaffinity_np(t->task_thread.td.thread, sizeof(set), &set)) {
+            dav1d_log(c, "Failed to set the affinity of worker thread %u.\n", m);
+            continue;
+        }
+        t->task_thread.node = domains[d].node;
     }
+    if (placed)
+        for (unsigned n = 0; n < c->n_fc; n++)
+            c->fc[n].task_thread.node = domains[n * n_domains / c->n_fc].node;
+    pthread_mutex_unlock(&c->task_thread.lock);
+    dav1d_free(domains);
+#else
+    dav1d_log(c, "Thread affinity settings are not supported on this system.\n");
+#endif
+}
 
+/*
+ * Sets the thread and frame context counts, and the frame size limit and
+ * picture pool size derived from them when using a memory budget.
+ */
+static COLD int set_thread_counts(Dav1dContext *const c, const Dav1dSettings *const s) {
+    const unsigned prev_frame_size_limit = c->frame_size_limit;
+    c->frame_size_limit = s->frame_size_limit;
     /* On 32-bit systems extremely large frame sizes can cause overflows in
      * dav1d_decode_frame() malloc size calculations. Prevent that from occuring
      * by enforcing a maximum frame size limit, chosen to roughly correspond to
@@ -210,13 +338,65 @@ COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
                       s->frame_size_limit, c->frame_size_limit);
     }
 
-    c->flush = &c->flush_mem;
-    atomic_init(c->flush, 0);
-
     get_num_threads(c, s, &c->n_tc, &c->n_fc);
+    c->step_decoding = s->step_decoding && c->n_tc == 1;
+
+    size_t max_idle_sz = s->picture_pool_limit;
+    if (s->memory_budget) {
+        const size_t area = get_budget_frame_area(c->n_fc, c->n_tc, s->memory_budget, 0);
+        if (!area) {
+            dav1d_log(c, "Memory budget of %zu bytes is too small.\n", s->memory_budget);
+            return -1;
+        }
+        if (!c->frame_size_limit || c->frame_size_limit > area) {
+            c->frame_size_limit = (unsigned) area;
+            if (c->frame_size_limit != prev_frame_size_limit)
+                dav1d_log(c, "Frame size limit set to %u by the memory budget.\n",
+                          c->frame_size_limit);
+        }
+        // high bit-depth pictures and buffers take twice the memory
+        const size_t hbd_area = get_budget_frame_area(c->n_fc, c->n_tc,
+                                                      s->memory_budget, 1);
+        c->hbd_frame_size_limit = (unsigned) iclip(hbd_area, 1, c->frame_size_limit);
+        // only keep unused pictures in the headroom left by the estimate
+        const size_t usage = estimate_memory_usage(c->n_fc, c->n_tc,
+                                                   c->frame_size_limit, 0);
+        const size_t hbd_usage = !hbd_area ? 0 :
+            estimate_memory_usage(c->n_fc, c->n_tc, c->hbd_frame_size_limit, 1);
+        const size_t headroom = s->memory_budget - (usage > hbd_usage ? usage : hbd_usage);
+        if (max_idle_sz > headroom)
+            max_idle_sz = headroom;
+    } else {
+        c->hbd_frame_size_limit = c->frame_size_limit;
+    }
+    if (c->picture_pool) {
+        pthread_mutex_lock(&c->picture_pool->lock);
+        c->picture_pool->max_idle_sz = max_idle_sz;
+        pthread_mutex_unlock(&c->picture_pool->lock);
+    }
+    return 0;
+}
+
+// Allocates the frame and task contexts and starts the worker threads.
+static COLD int init_threads(Dav1dContext *const c, const Dav1dSettings *const s) {
+    pthread_attr_t thread_attr;
+    if (pthread_attr_init(&thread_attr)) return -1;
+    size_t stack_size = 1024 * 1024 + get_stack_size_internal(&thread_attr);
+
+    pthread_attr_setstacksize(&thread_attr, stack_size);
 
+    if (dav1d_mem_account_charge(c->mem, ALLOC_THREAD_CTX,
+                                 sizeof(*c->fc) * c->n_fc + sizeof(*c->tc) * c->n_tc))
+    {
+        goto error;
+    }
+    c->thread_priority = s->thread_priority;
     c->fc = dav1d_alloc_aligned(ALLOC_THREAD_CTX, sizeof(*c->fc) * c->n_fc, 32);
-    if (!c->fc) goto error;
+    if (!c->fc) {
+        dav1d_mem_account_release(c->mem, ALLOC_THREAD_CTX,
+                                  sizeof(*c->fc) * c->n_fc + sizeof(*c->tc) * c->n_tc);
+        goto error;
+    }
     memset(c->fc, 0, sizeof(*c->fc) * c->n_fc);
 
     c->tc = dav1d_alloc_aligned(ALLOC_THREAD_CTX, sizeof(*c->tc) * c->n_tc, 64);
@@ -233,16 +413,17 @@ COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
             pthread_mutex_destroy(&c->task_thread.lock);
             goto error;
         }
-        c->task_thread.cur = c->n_fc;
-        atomic_init(&c->task_thread.reset_task_cur, UINT_MAX);
         atomic_init(&c->task_thread.cond_signaled, 0);
+        c->task_thread.pool = s->thread_pool;
         c->task_thread.inited = 1;
     }
 
+    c->frame_thread.delay = c->latency.target_frames ?
+                            umin(c->latency.target_frames, c->n_fc) : c->n_fc;
     if (c->n_fc > 1) {
         const size_t out_delayed_sz = sizeof(*c->frame_thread.out_delayed) * c->n_fc;
         c->frame_thread.out_delayed =
-            dav1d_malloc(ALLOC_THREAD_CTX, out_delayed_sz);
+            dav1d_malloc_charged(c->mem, ALLOC_THREAD_CTX, out_delayed_sz);
         if (!c->frame_thread.out_delayed) goto error;
         memset(c->frame_thread.out_delayed, 0, out_delayed_sz);
     }
@@ -262,6 +443,7 @@ COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
         }
         f->c = c;
         f->task_thread.ttd = &c->task_thread;
+        f->task_thread.node = -1;
         f->lf.last_sharpness = -1;
     }
 
@@ -271,13 +453,20 @@ COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
         t->task_thread.ttd = &c->task_thread;
         t->c = c;
         memset(t->cf_16bpc, 0, sizeof(t->cf_16bpc));
+        t->task_thread.node = -1;
+        atomic_init(&t->task_thread.os_tid, 0);
         if (c->n_tc > 1) {
             if (pthread_mutex_init(&t->task_thread.td.lock, NULL)) goto error;
             if (pthread_cond_init(&t->task_thread.td.cond, NULL)) {
                 pthread_mutex_destroy(&t->task_thread.td.lock);
                 goto error;
             }
-            if (pthread_create(&t->task_thread.td.thread, &thread_attr, dav1d_worker_task, t)) {
+            if (c->task_thread.pool) {
+                // tasks are run by the workers of the shared pool
+                t->task_thread.flushed = 1;
+            } else if (pthread_create(&t->task_thread.td.thread, &thread_attr,
+                                      dav1d_worker_task, t))
+            {
                 pthread_cond_destroy(&t->task_thread.td.cond);
                 pthread_mutex_destroy(&t->task_thread.td.lock);
                 goto error;
@@ -285,16 +474,202 @@ COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
             t->task_thread.td.inited = 1;
         }
     }
-    dav1d_pal_dsp_init(&c->pal_dsp);
-    dav1d_refmvs_dsp_init(&c->refmvs_dsp);
+    if (c->task_thread.pool &&
+        dav1d_thread_pool_attach(c->task_thread.pool, c))
+    {
+        goto error;
+    }
+    if ((s->thread_placement != DAV1D_THREADPLACEMENT_NONE || s->n_thread_cpus ||
+         s->thread_pinning != DAV1D_THREADPINNING_NONE) &&
+        c->n_tc > 1 && !c->task_thread.pool)
+    {
+        place_threads(c, s);
+    }
+
+    pthread_attr_destroy(&thread_attr);
+    return 0;
 
+error:
     pthread_attr_destroy(&thread_attr);
+    return -1;
+}
+
+// Stops the worker threads and frees the frame and task contexts.
+static COLD void end_threads(Dav1dContext *const c) {
+    if (c->tc) {
+        struct TaskThreadData *ttd = &c->task_thread;
+        if (ttd->inited) {
+            if (ttd->pool) dav1d_thread_pool_detach(ttd->pool, c);
+            pthread_mutex_lock(&ttd->lock);
+            for (unsigned n = 0; n < c->n_tc && c->tc[n].task_thread.td.inited; n++)
+                c->tc[n].task_thread.die = 1;
+            pthread_cond_broadcast(&ttd->cond);
+            pthread_mutex_unlock(&ttd->lock);
+            for (unsigned n = 0; n < c->n_tc; n++) {
+                Dav1dTaskContext *const pf = &c->tc[n];
+                if (!pf->task_thread.td.inited) break;
+                if (!ttd->pool) pthread_join(pf->task_thread.td.thread, NULL);
+                pthread_cond_destroy(&pf->task_thread.td.cond);
+                pthread_mutex_destroy(&pf->task_thread.td.lock);
+            }
+            pthread_cond_destroy(&ttd->delayed_fg.cond);
+            pthread_cond_destroy(&ttd->cond);
+            pthread_mutex_destroy(&ttd->lock);
+        }
+        dav1d_free_aligned(c->tc);
+    }
+
+    if (c->fc) {
+        for (unsigned n = 0; n < c->n_fc; n++) {
+            Dav1dFrameContext *const f = &c->fc[n];
+
+            // clean-up threading stuff
+            if (c->n_tc > 1) {
+                pthread_mutex_destroy(&f->task_thread.pending_tasks.lock);
+                pthread_cond_destroy(&f->task_thread.cond);
+                pthread_mutex_destroy(&f->task_thread.lock);
+            }
+            dav1d_decode_frame_free(c, f);
+        }
+        dav1d_free_aligned(c->fc);
+        dav1d_mem_account_release(c->mem, ALLOC_THREAD_CTX,
+                                  sizeof(*c->fc) * c->n_fc + sizeof(*c->tc) * c->n_tc);
+    }
+    if (c->n_fc > 1 && c->frame_thread.out_delayed) {
+        for (unsigned n = 0; n < c->n_fc; n++)
+            if (c->frame_thread.out_delayed[n].p.frame_hdr)
+                dav1d_thread_picture_unref(&c->frame_thread.out_delayed[n]);
+        dav1d_free_charged(c->frame_thread.out_delayed);
+    }
+    c->fc = NULL;
+    c->tc = NULL;
+    c->frame_thread.out_delayed = NULL;
+    c->frame_thread.next = c->frame_thread.n_busy = 0;
+    memset(&c->task_thread, 0, sizeof(c->task_thread));
+}
+
+COLD int dav1d_get_frame_delay(const Dav1dSettings *const s) {
+    unsigned n_tc, n_fc;
+    validate_input_or_ret(s != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->n_threads >= 0 &&
+                          s->n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->max_frame_delay >= 0 &&
+                          s->max_frame_delay <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
+
+    get_num_threads(NULL, s, &n_tc, &n_fc);
+    return n_fc;
+}
+
+COLD int dav1d_open(Dav1dContext **const c_out, const Dav1dSettings *const s) {
+    pthread_once(&initted, init_internal);
+
+    validate_input_or_ret(c_out != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->n_threads >= 0 &&
+                          s->n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->max_frame_delay >= 0 &&
+                          s->max_frame_delay <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->allocator.alloc_picture_callback != NULL,
+                          DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->allocator.release_picture_callback != NULL,
+                          DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->operating_point >= 0 &&
+                          s->operating_point <= 31, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->decode_frame_type >= DAV1D_DECODEFRAMETYPE_ALL &&
+                          s->decode_frame_type <= DAV1D_DECODEFRAMETYPE_KEY, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->output_downscale >= 0 &&
+                          s->output_downscale <= 3, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_placement >= DAV1D_THREADPLACEMENT_NONE &&
+                          s->thread_placement <= DAV1D_THREADPLACEMENT_L3, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->n_thread_cpus >= 0 &&
+                          (!s->n_thread_cpus || s->thread_cpus), DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_pinning >= DAV1D_THREADPINNING_NONE &&
+                          s->thread_pinning <= DAV1D_THREADPINNING_CPU, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_priority >= DAV1D_THREADPRIORITY_DEFAULT &&
+                          s->thread_priority <= DAV1D_THREADPRIORITY_IDLE, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->latency_target_frames <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
+#ifndef HAVE_EVENTFD
+    if (s->picture_eventfd) return DAV1D_ERR(ENOSYS);
+#endif
+
+    Dav1dContext *const c = *c_out = dav1d_alloc_aligned(ALLOC_COMMON_CTX, sizeof(*c), 64);
+    if (!c) goto error;
+    memset(c, 0, sizeof(*c));
+    c->picture_fd = -1;
+
+    if (dav1d_mem_account_create(&c->mem, s->memory_budget)) {
+        dav1d_freep_aligned(c_out);
+        goto error;
+    }
+    if (dav1d_mem_account_charge(c->mem, ALLOC_COMMON_CTX, sizeof(*c))) goto error;
+
+    c->allocator = s->allocator;
+    c->logger = s->logger;
+    c->tracer = s->tracer;
+    c->apply_grain = s->apply_grain;
+    c->operating_point = s->operating_point;
+    c->all_layers = s->all_layers;
+    c->strict_std_compliance = s->strict_std_compliance;
+    c->output_invisible_frames = s->output_invisible_frames;
+    c->inloop_filters = s->inloop_filters;
+    c->decode_frame_type = s->decode_frame_type;
+    c->output_downscale = s->output_downscale;
+    c->early_output = s->early_output && !s->output_downscale;
+    c->early_tile_groups = s->early_tile_groups &&
+                           s->decode_frame_type == DAV1D_DECODEFRAMETYPE_ALL;
+    c->huge_pages = s->huge_pages;
+    c->stage_times = s->stage_times;
+    c->trace_tasks = s->stage_times;
+#if CONFIG_TRACE
+    c->trace_tasks |= !!s->tracer.callback;
+#endif
+    c->latency.target_ns = s->latency_target_ms * UINT64_C(1000000);
+    c->latency.target_frames = s->latency_target_frames;
+    c->latency.min_fps = s->min_fps;
+    c->picture_notifier = s->picture_notifier;
+#ifdef HAVE_EVENTFD
+    if (s->picture_eventfd) {
+        c->picture_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (c->picture_fd < 0) goto error;
+    }
+#endif
+
+    dav1d_data_props_set_defaults(&c->cached_error_props);
+
+    if (dav1d_mem_pool_init(ALLOC_OBU_HDR, c->mem, &c->seq_hdr_pool) ||
+        dav1d_mem_pool_init(ALLOC_OBU_HDR, c->mem, &c->frame_hdr_pool) ||
+        dav1d_mem_pool_init(ALLOC_SEGMAP, c->mem, &c->segmap_pool) ||
+        dav1d_mem_pool_init(ALLOC_REFMVS, c->mem, &c->refmvs_pool) ||
+        dav1d_mem_pool_init(ALLOC_PIC_CTX, c->mem, &c->pic_ctx_pool) ||
+        dav1d_mem_pool_init(ALLOC_CDF, c->mem, &c->cdf_pool))
+    {
+        goto error;
+    }
+
+    if (c->allocator.alloc_picture_callback   == dav1d_default_picture_alloc &&
+        c->allocator.release_picture_callback == dav1d_default_picture_release)
+    {
+        if (c->allocator.cookie) goto error;
+        if (dav1d_mem_pool_init(ALLOC_PIC, c->mem, &c->picture_pool)) goto error;
+        c->picture_pool->huge = c->huge_pages;
+        c->allocator.cookie = c->picture_pool;
+    } else if (c->allocator.alloc_picture_callback   == dav1d_default_picture_alloc ||
+               c->allocator.release_picture_callback == dav1d_default_picture_release)
+    {
+        goto error;
+    }
+
+    c->flush = &c->flush_mem;
+    atomic_init(c->flush, 0);
+
+    if (set_thread_counts(c, s) || init_threads(c, s)) goto error;
+    dav1d_pal_dsp_init(&c->pal_dsp);
+    dav1d_refmvs_dsp_init(&c->refmvs_dsp);
 
     return 0;
 
 error:
     if (c) close_internal(c_out, 0);
-    pthread_attr_destroy(&thread_attr);
     return DAV1D_ERR(ENOMEM);
 }
 
@@ -312,6 +687,16 @@ static int output_image(Dav1dContext *const c, Dav1dPicture *const out)
 
     Dav1dThreadPicture *const in = (c->all_layers || !c->max_spatial_id)
                                    ? &c->out : &c->cache;
+    const Dav1dPicture *const scaled = dav1d_picture_get_scaled(&in->p);
+    if (scaled) {
+        dav1d_picture_ref(out, scaled);
+        dav1d_picture_copy_props(out, in->p.content_light, in->p.content_light_ref,
+                                 in->p.mastering_display, in->p.mastering_display_ref,
+                                 in->p.itut_t35, in->p.itut_t35_ref, in->p.n_itut_t35,
+                                 &in->p.m);
+        dav1d_thread_picture_unref(in);
+        goto end;
+    }
     if (!c->apply_grain || !has_grain(&in->p)) {
         dav1d_picture_move_ref(out, &in->p);
         dav1d_thread_picture_unref(in);
@@ -327,8 +712,15 @@ end:
     return res;
 }
 
+// whether a frame decoded with dav1d_decode_step() is still in progress
+static inline int step_frame_pending(const Dav1dContext *const c) {
+    return c->step_decoding && c->fc->n_tile_data > 0;
+}
+
 static int output_picture_ready(Dav1dContext *const c, const int drain) {
     if (c->cached_error) return 1;
+    // the picture is still missing tile groups, or being decoded in steps
+    if (c->n_fc == 1 && (c->tile_frame || step_frame_pending(c))) return 0;
     if (!c->all_layers && c->max_spatial_id) {
         if (c->out.p.data[0] && c->cache.p.data[0]) {
             if (c->max_spatial_id == c->cache.p.frame_hdr->spatial_id ||
@@ -348,13 +740,20 @@ static int output_picture_ready(Dav1dContext *const c, const int drain) {
     return !!c->out.p.data[0];
 }
 
-static int drain_picture(Dav1dContext *const c, Dav1dPicture *const out) {
-    unsigned drain_count = 0;
-    int drained = 0;
-    do {
+// outputs the oldest frames in flight, waiting for them to be decoded if
+// wait is set, or only those which have been decoded already otherwise
+static int drain_picture(Dav1dContext *const c, Dav1dPicture *const out,
+                         const int wait)
+{
+    while (c->frame_thread.n_busy) {
         const unsigned next = c->frame_thread.next;
         Dav1dFrameContext *const f = &c->fc[next];
         pthread_mutex_lock(&c->task_thread.lock);
+        // don't wait for tile groups which may only be sent later
+        if ((!wait || f == c->tile_frame) && f->n_tile_data > 0) {
+            pthread_mutex_unlock(&c->task_thread.lock);
+            break;
+        }
         while (f->n_tile_data > 0)
             pthread_cond_wait(&f->task_thread.cond,
                               &f->task_thread.ttd->lock);
@@ -366,17 +765,10 @@ static int drain_picture(Dav1dContext *const c, Dav1dPicture *const out) {
                 atomic_fetch_add(&c->task_thread.first, 1U);
             else
                 atomic_store(&c->task_thread.first, 0);
-            atomic_compare_exchange_strong(&c->task_thread.reset_task_cur,
-                                           &first, UINT_MAX);
-            if (c->task_thread.cur && c->task_thread.cur < c->n_fc)
-                c->task_thread.cur--;
-            drained = 1;
-        } else if (drained) {
-            pthread_mutex_unlock(&c->task_thread.lock);
-            break;
         }
         if (++c->frame_thread.next == c->n_fc)
             c->frame_thread.next = 0;
+        c->frame_thread.n_busy--;
         pthread_mutex_unlock(&c->task_thread.lock);
         const int error = f->task_thread.retval;
         if (error) {
@@ -390,7 +782,7 @@ static int drain_picture(Dav1dContext *const c, Dav1dPicture *const out) {
                 atomic_load_explicit(&out_delayed->progress[1],
                                      memory_order_relaxed);
             if ((out_delayed->visible || c->output_invisible_frames) &&
-                progress != FRAME_ERROR)
+                progress != FRAME_ERROR && !f->frame_thread.early_output)
             {
                 dav1d_thread_picture_ref(&c->out, out_delayed);
                 c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
@@ -399,14 +791,46 @@ static int drain_picture(Dav1dContext *const c, Dav1dPicture *const out) {
             if (output_picture_ready(c, 0))
                 return output_image(c, out);
         }
-    } while (++drain_count < c->n_fc);
+    }
 
-    if (output_picture_ready(c, 1))
+    if (output_picture_ready(c, wait))
         return output_image(c, out);
 
     return DAV1D_ERR(EAGAIN);
 }
 
+// outputs the picture of the oldest frame in flight which wasn't output yet
+// while it is still being decoded (refer to Dav1dSettings.early_output)
+static int output_picture_early(Dav1dContext *const c, Dav1dPicture *const out) {
+    int res = DAV1D_ERR(EAGAIN);
+    pthread_mutex_lock(&c->task_thread.lock);
+    for (unsigned n = 0, next = c->frame_thread.next; n < c->frame_thread.n_busy; n++) {
+        Dav1dFrameContext *const f = &c->fc[next];
+        Dav1dThreadPicture *const out_delayed = &c->frame_thread.out_delayed[next];
+        if (++next == c->n_fc) next = 0;
+        // keep errors in order, and apply film grain once the frame is decoded
+        if (f->task_thread.retval) break;
+        if (f->frame_thread.early_output || !out_delayed->p.data[0] ||
+            !(out_delayed->visible || c->output_invisible_frames))
+        {
+            continue;
+        }
+        if (atomic_load(&out_delayed->progress[1]) == FRAME_ERROR ||
+            (c->apply_grain && has_grain(&out_delayed->p)))
+        {
+            break;
+        }
+        f->frame_thread.early_output = 1;
+        dav1d_thread_picture_ref(&c->out, out_delayed);
+        c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
+        res = 0;
+        break;
+    }
+    pthread_mutex_unlock(&c->task_thread.lock);
+
+    return res ? res : output_image(c, out);
+}
+
 static int gen_picture(Dav1dContext *const c)
 {
     Dav1dData *const in = &c->in;
@@ -415,6 +839,10 @@ static int gen_picture(Dav1dContext *const c)
         return 0;
 
     while (in->sz > 0) {
+        // the next frame is only parsed once the current one was decoded in
+        // steps; its tile groups are still accepted though
+        if (step_frame_pending(c) && !c->tile_frame)
+            break;
         const ptrdiff_t res = dav1d_parse_obus(c, in);
         if (res < 0) {
             dav1d_data_unref_internal(in);
@@ -444,12 +872,22 @@ int dav1d_send_data(Dav1dContext *const c, Dav1dData *const in)
     }
     if (c->in.data)
         return DAV1D_ERR(EAGAIN);
+    if (in->ref) {
+        const int res = dav1d_ref_charge(in->ref, c->mem);
+        if (res < 0) return res;
+    }
     dav1d_data_ref(&c->in, in);
 
     int res = gen_picture(c);
     if (!res)
         dav1d_data_unref_internal(in);
 
+    if ((c->picture_notifier.callback || c->picture_fd >= 0) &&
+        output_picture_ready(c, 0))
+    {
+        dav1d_picture_ready_notify(c);
+    }
+
     return res;
 }
 
@@ -474,12 +912,48 @@ int dav1d_get_picture(Dav1dContext *const c, Dav1dPicture *const out)
     if (output_picture_ready(c, c->n_fc == 1))
         return output_image(c, out);
 
-    if (c->n_fc > 1 && drain)
-        return drain_picture(c, out);
+    if (c->n_fc > 1) {
+        // also output frames in excess of a frame delay which was just reduced
+        if (drain || c->frame_thread.n_busy > c->frame_thread.delay)
+            return drain_picture(c, out, 1);
+        // a notification was sent once the oldest frame in flight was decoded
+        if (c->picture_notifier.callback || c->picture_fd >= 0) {
+            const int res = drain_picture(c, out, 0);
+            if (res != DAV1D_ERR(EAGAIN)) return res;
+        }
+        if (c->early_output && (c->all_layers || !c->max_spatial_id))
+            return output_picture_early(c, out);
+    }
 
     return DAV1D_ERR(EAGAIN);
 }
 
+int dav1d_get_picture_progress(const Dav1dPicture *const p) {
+    validate_input_or_ret(p != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(p->data[0] != NULL, DAV1D_ERR(EINVAL));
+
+    const unsigned progress = dav1d_picture_get_progress(p);
+    if (progress == FRAME_ERROR) return DAV1D_ERR(EINVAL);
+    return progress < (unsigned) p->p.h ? (int) progress : p->p.h;
+}
+
+int dav1d_decode_step(Dav1dContext *const c, const unsigned budget_us) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+
+    if (!step_frame_pending(c)) return 0;
+    c->step_deadline = dav1d_get_time_nanos() + budget_us * UINT64_C(1000);
+    const int res = dav1d_decode_frame_step(c);
+    c->step_deadline = 0;
+
+    if (!res && (c->picture_notifier.callback || c->picture_fd >= 0) &&
+        output_picture_ready(c, 0))
+    {
+        dav1d_picture_ready_notify(c);
+    }
+
+    return res;
+}
+
 int dav1d_apply_grain(Dav1dContext *const c, Dav1dPicture *const out,
                       const Dav1dPicture *const in)
 {
@@ -498,6 +972,7 @@ int dav1d_apply_grain(Dav1dContext *const c, Dav1dPicture *const out,
     if (c->n_tc > 1) {
         dav1d_task_delayed_fg(c, out, in);
     } else {
+        uint64_t start = dav1d_stage_time_start(c);
         switch (out->p.bpc) {
 #if CONFIG_8BPC
         case 8:
@@ -512,6 +987,7 @@ int dav1d_apply_grain(Dav1dContext *const c, Dav1dPicture *const out,
 #endif
         default: abort();
         }
+        dav1d_stage_time_lap(&c->caller_times.task[DAV1D_TASKTRACE_FG_APPLY], &start);
     }
 
     return 0;
@@ -521,6 +997,21 @@ error:
     return res;
 }
 
+// drops the frame which was still waiting for tile groups or being decoded in
+// steps, once the worker threads are stopped; frames decoded in frame threads
+// are dropped with the other frames in flight
+static void flush_pending_frame(Dav1dContext *const c) {
+    if (c->n_fc == 1 && c->fc->n_tile_data > 0) {
+        dav1d_decode_frame_exit(c->fc, -1);
+        c->fc->n_tile_data = 0;
+        c->fc->task_thread.retval = 0;
+    }
+    if (!c->tile_frame) return;
+    c->tile_frame = NULL;
+    dav1d_ref_dec(&c->frame_hdr_ref);
+    c->n_tiles = 0;
+}
+
 void dav1d_flush(Dav1dContext *const c) {
     dav1d_data_unref_internal(&c->in);
     if (c->out.p.frame_hdr)
@@ -552,7 +1043,10 @@ void dav1d_flush(Dav1dContext *const c) {
 
     dav1d_data_props_unref_internal(&c->cached_error_props);
 
-    if (c->n_fc == 1 && c->n_tc == 1) return;
+    if (c->n_fc == 1 && c->n_tc == 1) {
+        flush_pending_frame(c);
+        return;
+    }
     atomic_store(c->flush, 1);
 
     // stop running tasks in worker threads
@@ -567,17 +1061,17 @@ void dav1d_flush(Dav1dContext *const c) {
         for (unsigned i = 0; i < c->n_fc; i++) {
             c->fc[i].task_thread.task_head = NULL;
             c->fc[i].task_thread.task_tail = NULL;
-            c->fc[i].task_thread.task_cur_prev = NULL;
+            c->fc[i].task_thread.ref_waiters = NULL;
+            c->fc[i].task_thread.data_waiters = NULL;
             c->fc[i].task_thread.pending_tasks.head = NULL;
             c->fc[i].task_thread.pending_tasks.tail = NULL;
             atomic_init(&c->fc[i].task_thread.pending_tasks.merge, 0);
         }
         atomic_init(&c->task_thread.first, 0);
-        c->task_thread.cur = c->n_fc;
-        atomic_store(&c->task_thread.reset_task_cur, UINT_MAX);
         atomic_store(&c->task_thread.cond_signaled, 0);
         pthread_mutex_unlock(&c->task_thread.lock);
     }
+    flush_pending_frame(c);
 
     // wait for threads to complete flushing
     if (c->n_fc > 1) {
@@ -593,8 +1087,76 @@ void dav1d_flush(Dav1dContext *const c) {
             }
         }
         c->frame_thread.next = 0;
+        c->frame_thread.n_busy = 0;
     }
     atomic_store(c->flush, 0);
+#ifdef HAVE_EVENTFD
+    // discard the notifications of the pictures which were just dropped
+    if (c->picture_fd >= 0) {
+        uint64_t n;
+        while (read(c->picture_fd, &n, sizeof(n)) < 0 && errno == EINTR) ;
+    }
+#endif
+}
+
+COLD int dav1d_reconfigure(Dav1dContext *const c, const Dav1dSettings *const s) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->n_threads >= 0 &&
+                          s->n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->max_frame_delay >= 0 &&
+                          s->max_frame_delay <= DAV1D_MAX_FRAME_DELAY, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->memory_budget == c->mem->limit, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_placement >= DAV1D_THREADPLACEMENT_NONE &&
+                          s->thread_placement <= DAV1D_THREADPLACEMENT_L3, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->n_thread_cpus >= 0 &&
+                          (!s->n_thread_cpus || s->thread_cpus), DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_pinning >= DAV1D_THREADPINNING_NONE &&
+                          s->thread_pinning <= DAV1D_THREADPINNING_CPU, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(s->thread_priority >= DAV1D_THREADPRIORITY_DEFAULT &&
+                          s->thread_priority <= DAV1D_THREADPRIORITY_IDLE, DAV1D_ERR(EINVAL));
+
+    unsigned n_tc, n_fc;
+    get_num_threads(c, s, &n_tc, &n_fc);
+    if (s->memory_budget && !get_budget_frame_area(n_fc, n_tc, s->memory_budget, 0))
+        return DAV1D_ERR(EINVAL);
+
+    // all input must have been decoded, and all pictures returned
+    if (c->in.data || c->n_tile_data || c->tile_frame || step_frame_pending(c) ||
+        c->out.p.data[0] || c->cache.p.data[0])
+    {
+        return DAV1D_ERR(EAGAIN);
+    }
+    if (c->n_fc > 1) {
+        // frames which aren't output can still be in flight
+        pthread_mutex_lock(&c->task_thread.lock);
+        for (unsigned n = 0; n < c->n_fc; n++) {
+            Dav1dFrameContext *const f = &c->fc[n];
+            while (f->n_tile_data > 0)
+                pthread_cond_wait(&f->task_thread.cond, &c->task_thread.lock);
+        }
+        pthread_mutex_unlock(&c->task_thread.lock);
+        for (unsigned n = 0; n < c->n_fc; n++)
+            if (c->frame_thread.out_delayed[n].p.data[0] ||
+                c->fc[n].task_thread.retval)
+            {
+                return DAV1D_ERR(EAGAIN);
+            }
+    }
+
+    end_threads(c);
+    if (!set_thread_counts(c, s) && !init_threads(c, s)) return 0;
+
+    end_threads(c);
+    Dav1dSettings fallback = *s;
+    fallback.n_threads = fallback.max_frame_delay = 1;
+    fallback.thread_pool = NULL;
+    set_thread_counts(c, &fallback);
+    if (init_threads(c, &fallback)) {
+        dav1d_log(c, "Failed to reconfigure the decoder threads.\n");
+        end_threads(c);
+    }
+    return DAV1D_ERR(ENOMEM);
 }
 
 COLD void dav1d_close(Dav1dContext **const c_out) {
@@ -605,78 +1167,330 @@ COLD void dav1d_close(Dav1dContext **const c_out) {
     close_internal(c_out, 1);
 }
 
-static COLD void close_internal(Dav1dContext **const c_out, int flush) {
-    Dav1dContext *const c = *c_out;
-    if (!c) return;
+int dav1d_get_picture_pool_stats(Dav1dContext *const c,
+                                 Dav1dPicturePoolStats *const out)
+{
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
 
-    if (flush) dav1d_flush(c);
+    if (!c->picture_pool) return DAV1D_ERR(ENOENT);
+    dav1d_mem_pool_get_stats(c->picture_pool, &out->hits, &out->misses,
+                             &out->bytes_resident);
+    return 0;
+}
 
-    if (c->tc) {
-        struct TaskThreadData *ttd = &c->task_thread;
-        if (ttd->inited) {
-            pthread_mutex_lock(&ttd->lock);
-            for (unsigned n = 0; n < c->n_tc && c->tc[n].task_thread.td.inited; n++)
-                c->tc[n].task_thread.die = 1;
-            pthread_cond_broadcast(&ttd->cond);
-            pthread_mutex_unlock(&ttd->lock);
-            for (unsigned n = 0; n < c->n_tc; n++) {
-                Dav1dTaskContext *const pf = &c->tc[n];
-                if (!pf->task_thread.td.inited) break;
-                pthread_join(pf->task_thread.td.thread, NULL);
-                pthread_cond_destroy(&pf->task_thread.td.cond);
-                pthread_mutex_destroy(&pf->task_thread.td.lock);
-            }
-            pthread_cond_destroy(&ttd->delayed_fg.cond);
-            pthread_cond_destroy(&ttd->cond);
-            pthread_mutex_destroy(&ttd->lock);
+int dav1d_get_memory_stats(Dav1dContext *const c, Dav1dMemoryStats *const out) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
+
+    memset(out, 0, sizeof(*out));
+    Dav1dMemPool *const pools[] = {
+        c->seq_hdr_pool, c->frame_hdr_pool, c->segmap_pool, c->refmvs_pool,
+        c->cdf_pool, c->picture_pool, c->pic_ctx_pool,
+    };
+    for (size_t i = 0; i < sizeof(pools) / sizeof(*pools); i++) {
+        if (!pools[i]) continue;
+        uint64_t hits, misses;
+        size_t idle_sz;
+        dav1d_mem_pool_get_stats(pools[i], &hits, &misses, &idle_sz);
+        out->type[pools[i]->type].pool_hits += hits;
+        out->type[pools[i]->type].pool_misses += misses;
+    }
+
+    assert((int) N_ALLOC_TYPES == (int) DAV1D_MEMORY_NUM_TYPES);
+    pthread_mutex_lock(&c->mem->lock);
+    out->current = c->mem->total;
+    out->peak = c->mem->peak_total;
+    for (int i = 0; i < N_ALLOC_TYPES; i++) {
+        out->type[i].current = c->mem->sz[i];
+        out->type[i].peak = c->mem->peak_sz[i];
+    }
+    pthread_mutex_unlock(&c->mem->lock);
+    return 0;
+}
+
+int dav1d_get_stage_times(Dav1dContext *const c, Dav1dStageTimes *const out) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
+
+    *out = c->caller_times;
+    for (unsigned i = 0; i < c->n_tc; i++)
+        for (int n = 0; n <= DAV1D_TASKTRACE_FG_APPLY; n++)
+            out->task[n] += c->tc[i].trace.stage_ns[n];
+    return 0;
+}
+
+static int frames_in_flight(Dav1dContext *const c) {
+    if (c->tile_frame || step_frame_pending(c)) return 1;
+    int busy = 0;
+    if (c->n_fc > 1) {
+        // no new frame can be started meanwhile, only the caller does so
+        pthread_mutex_lock(&c->task_thread.lock);
+        for (unsigned n = 0; n < c->n_fc && !busy; n++)
+            busy = c->fc[n].n_tile_data > 0;
+        pthread_mutex_unlock(&c->task_thread.lock);
+    }
+    return busy;
+}
+
+COLD int dav1d_trim_memory(Dav1dContext *const c, const enum Dav1dTrimLevel level) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(level >= DAV1D_TRIMLEVEL_POOLS &&
+                          level <= DAV1D_TRIMLEVEL_FRAME_BUFFERS, DAV1D_ERR(EINVAL));
+
+    Dav1dMemPool *const pools[] = {
+        c->seq_hdr_pool, c->frame_hdr_pool, c->segmap_pool, c->refmvs_pool,
+        c->cdf_pool, c->picture_pool, c->pic_ctx_pool,
+    };
+    for (size_t i = 0; i < sizeof(pools) / sizeof(*pools); i++)
+        if (pools[i]) dav1d_mem_pool_release_idle(pools[i]);
+    if (level < DAV1D_TRIMLEVEL_FRAME_BUFFERS) return 0;
+
+    if (frames_in_flight(c)) return DAV1D_ERR(EAGAIN);
+    for (unsigned n = 0; n < c->n_fc; n++)
+        dav1d_decode_frame_trim(c, &c->fc[n]);
+    return 0;
+}
+
+// pop n buffers of the given size from the pool and touch them, so that
+// they are already mapped when pushed back and reused by the decoder
+static int prepare_pool(Dav1dMemPool *const pool, const size_t sz, const int n) {
+    Dav1dRef *refs[DAV1D_NUM_REF_FRAMES + DAV1D_MAX_FRAME_DELAY];
+    int res = 0, i;
+
+    for (i = 0; i < n; i++) {
+        refs[i] = dav1d_ref_create_using_pool(pool, sz);
+        if (!refs[i]) {
+            res = DAV1D_ERR(ENOMEM);
+            break;
         }
-        dav1d_free_aligned(c->tc);
+        memset(refs[i]->data, 0, sz);
+    }
+    while (i--)
+        dav1d_ref_dec(&refs[i]);
+    return res;
+}
+
+static int prepare_pictures(Dav1dContext *const c,
+                            const Dav1dSequenceHeader *const seq_hdr,
+                            const int n, ptrdiff_t stride[2])
+{
+    Dav1dMemPoolBuffer *bufs[DAV1D_NUM_REF_FRAMES + DAV1D_MAX_FRAME_DELAY];
+    int res = 0, i;
+
+    for (i = 0; i < n; i++) {
+        Dav1dPicture p = { 0 };
+        p.p.w = seq_hdr->max_width;
+        p.p.h = seq_hdr->max_height;
+        p.p.bpc = 8 + 2 * seq_hdr->hbd;
+        p.p.layout = seq_hdr->layout;
+        res = dav1d_default_picture_alloc(&p, c->picture_pool);
+        if (res < 0) break;
+        bufs[i] = p.allocator_data;
+        memset(bufs[i]->data, 0, (uint8_t *) bufs[i] - (uint8_t *) bufs[i]->data);
+        stride[0] = p.stride[0];
+        stride[1] = p.stride[1];
     }
+    while (i--)
+        dav1d_mem_pool_push(c->picture_pool, bufs[i]);
+    return res;
+}
 
-    for (unsigned n = 0; c->fc && n < c->n_fc; n++) {
-        Dav1dFrameContext *const f = &c->fc[n];
+COLD int dav1d_prepare(Dav1dContext *const c, const Dav1dSequenceHeader *const seq_hdr) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(seq_hdr != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(seq_hdr->max_width > 0 && seq_hdr->max_height > 0,
+                          DAV1D_ERR(EINVAL));
+
+    const unsigned frame_size_limit = dav1d_get_frame_size_limit(c, seq_hdr->hbd);
+    if (frame_size_limit && (int64_t)seq_hdr->max_width *
+        seq_hdr->max_height > frame_size_limit)
+    {
+        dav1d_log(c, "Frame size %dx%d exceeds limit %u\n", seq_hdr->max_width,
+                  seq_hdr->max_height, frame_size_limit);
+        return DAV1D_ERR(ERANGE);
+    }
+    if (frames_in_flight(c)) return DAV1D_ERR(EAGAIN);
+
+    // one buffer for each reference slot and each frame in flight
+    const int n = DAV1D_NUM_REF_FRAMES + c->n_fc;
+    int res;
+
+    // with a custom picture allocator, neither the pictures nor their
+    // strides are known, so only the stride-independent buffers are prepared
+    ptrdiff_t stride[2] = { 0, 0 };
+    if (c->picture_pool && (res = prepare_pictures(c, seq_hdr, n, stride)) < 0)
+        return res;
 
-        // clean-up threading stuff
-        if (c->n_fc > 1) {
-            dav1d_free(f->tile_thread.lowest_pixel_mem);
-            dav1d_free(f->frame_thread.b);
-            dav1d_free_aligned(f->frame_thread.cbi);
-            dav1d_free_aligned(f->frame_thread.pal_idx);
-            dav1d_free_aligned(f->frame_thread.cf);
-            dav1d_free(f->frame_thread.tile_start_off);
-            dav1d_free_aligned(f->frame_thread.pal);
+    const int bw = ((seq_hdr->max_width + 7) >> 3) << 1;
+    const int bh = ((seq_hdr->max_height + 7) >> 3) << 1;
+    const int b4_stride = (bw + 31) & ~31;
+    const int sb128h = (bh + 31) >> 5;
+    if ((res = prepare_pool(c->refmvs_pool, sizeof(refmvs_temporal_block) *
+                            sb128h * 16 * (b4_stride >> 1), n)) < 0 ||
+        (res = prepare_pool(c->cdf_pool, sizeof(CdfContext) + sizeof(atomic_uint), n)) < 0)
+    {
+        return res;
+    }
+
+    for (unsigned i = 0; i < c->n_fc; i++)
+        if ((res = dav1d_decode_frame_prepare(&c->fc[i], seq_hdr, stride)) < 0)
+            return res;
+    return 0;
+}
+
+COLD int dav1d_get_huge_page_usage(Dav1dHugePageUsage *const out) {
+    validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
+
+    dav1d_mem_get_huge_page_usage(&out->requested, &out->backed);
+    return 0;
+}
+
+COLD int dav1d_get_worker_info(Dav1dContext *const c, Dav1dWorkerInfo *const out,
+                               const int n_out)
+{
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(n_out >= 0 && (!n_out || out != NULL), DAV1D_ERR(EINVAL));
+
+    if (c->n_tc == 1 || c->task_thread.pool) return 0;
+    pthread_mutex_lock(&c->task_thread.lock);
+    for (int m = 0; m < imin(n_out, c->n_tc); m++) {
+        const Dav1dTaskContext *const t = &c->tc[m];
+        Dav1dWorkerInfo *const info = &out[m];
+        info->os_thread_id = atomic_load(&t->task_thread.os_tid);
+        info->cpu = -1;
+        info->n_cpus = 0;
+        info->node = t->task_thread.node;
+#if HAVE_CPU_PLACEMENT
+        cpu_set_t set;
+        if (!pthread_getaffinity_np(t->task_thread.td.thread, sizeof(set), &set)) {
+            info->n_cpus = CPU_COUNT(&set);
+            if (info->n_cpus == 1)
+                while (!CPU_ISSET(++info->cpu, &set));
         }
-        if (c->n_tc > 1) {
-            pthread_mutex_destroy(&f->task_thread.pending_tasks.lock);
-            pthread_cond_destroy(&f->task_thread.cond);
-            pthread_mutex_destroy(&f->task_thread.lock);
+#endif
+    }
+    pthread_mutex_unlock(&c->task_thread.lock);
+    return c->n_tc;
+}
+
+static COLD int thread_pool_create(Dav1dThreadPool **const pool_out,
+                                   const int n_threads,
+                                   const Dav1dTaskExecutor *const executor)
+{
+    pthread_once(&initted, init_internal);
+
+    validate_input_or_ret(pool_out != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(n_threads >= 0 &&
+                          n_threads <= DAV1D_MAX_THREADS, DAV1D_ERR(EINVAL));
+
+    pthread_attr_t thread_attr;
+    if (pthread_attr_init(&thread_attr)) return DAV1D_ERR(ENOMEM);
+    size_t stack_size = 1024 * 1024 + get_stack_size_internal(&thread_attr);
+
+    pthread_attr_setstacksize(&thread_attr, stack_size);
+
+    Dav1dThreadPool *const pool = *pool_out =
+        dav1d_malloc(ALLOC_THREAD_CTX, sizeof(*pool));
+    if (!pool) goto error;
+    memset(pool, 0, sizeof(*pool));
+
+    pool->n_threads = n_threads ? n_threads :
+        iclip(dav1d_num_logical_processors(NULL), 1, DAV1D_MAX_THREADS);
+    if (executor) {
+        // tasks are run by the application's threads
+        pool->executor = *executor;
+    } else {
+        pool->threads = dav1d_malloc(ALLOC_THREAD_CTX,
+                                     sizeof(*pool->threads) * pool->n_threads);
+        if (!pool->threads) goto error_free;
+    }
+    if (pthread_mutex_init(&pool->lock, NULL)) goto error_free;
+    if (pthread_cond_init(&pool->cond, NULL)) goto error_lock;
+    if (pthread_cond_init(&pool->idle_cond, NULL)) goto error_cond;
+
+    for (unsigned n = 0; pool->threads && n < pool->n_threads; n++) {
+        if (pthread_create(&pool->threads[n], &thread_attr,
+                           dav1d_pool_worker_task, pool))
+        {
+            pool->n_threads = n;
+            dav1d_thread_pool_destroy(pool_out);
+            goto error;
         }
-        dav1d_free(f->frame_thread.frame_progress);
-        dav1d_free(f->task_thread.tasks);
-        dav1d_free(f->task_thread.tile_tasks[0]);
-        dav1d_free_aligned(f->ts);
-        dav1d_free_aligned(f->ipred_edge[0]);
-        dav1d_free(f->a);
-        dav1d_free(f->tile);
-        dav1d_free(f->lf.mask);
-        dav1d_free(f->lf.level);
-        dav1d_free(f->lf.lr_mask);
-        dav1d_free(f->lf.tx_lpf_right_edge[0]);
-        dav1d_free(f->lf.start_of_tile_row);
-        dav1d_free_aligned(f->rf.r);
-        dav1d_free_aligned(f->lf.cdef_line_buf);
-        dav1d_free_aligned(f->lf.lr_line_buf);
-    }
-    dav1d_free_aligned(c->fc);
-    if (c->n_fc > 1 && c->frame_thread.out_delayed) {
-        for (unsigned n = 0; n < c->n_fc; n++)
-            if (c->frame_thread.out_delayed[n].p.frame_hdr)
-                dav1d_thread_picture_unref(&c->frame_thread.out_delayed[n]);
-        dav1d_free(c->frame_thread.out_delayed);
     }
+
+    pthread_attr_destroy(&thread_attr);
+
+    return 0;
+
+error_cond:
+    pthread_cond_destroy(&pool->cond);
+error_lock:
+    pthread_mutex_destroy(&pool->lock);
+error_free:
+    dav1d_free(pool->threads);
+    dav1d_free(pool);
+    *pool_out = NULL;
+error:
+    pthread_attr_destroy(&thread_attr);
+    return DAV1D_ERR(ENOMEM);
+}
+
+COLD int dav1d_thread_pool_create(Dav1dThreadPool **const pool_out,
+                                  const int n_threads)
+{
+    return thread_pool_create(pool_out, n_threads, NULL);
+}
+
+COLD int dav1d_thread_pool_create_external(Dav1dThreadPool **const pool_out,
+                                           const int n_threads,
+                                           const Dav1dTaskExecutor *const executor)
+{
+    validate_input_or_ret(executor != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(executor->task_available != NULL, DAV1D_ERR(EINVAL));
+
+    return thread_pool_create(pool_out, n_threads, executor);
+}
+
+int dav1d_run_task(Dav1dThreadPool *const pool) {
+    validate_input_or_ret(pool != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(!pool->threads, DAV1D_ERR(EINVAL));
+
+    return dav1d_pool_run_tasks(pool);
+}
+
+COLD void dav1d_thread_pool_destroy(Dav1dThreadPool **const pool_out) {
+    validate_input(pool_out != NULL);
+
+    Dav1dThreadPool *const pool = *pool_out;
+    if (!pool) return;
+    validate_input(!pool->n_ctx);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->die = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (unsigned n = 0; pool->threads && n < pool->n_threads; n++)
+        pthread_join(pool->threads[n], NULL);
+    pthread_cond_destroy(&pool->idle_cond);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    dav1d_free(pool->threads);
+    dav1d_free(pool->ctx);
+    dav1d_free(pool);
+    *pool_out = NULL;
+}
+
+static COLD void close_internal(Dav1dContext **const c_out, int flush) {
+    Dav1dContext *const c = *c_out;
+    if (!c) return;
+
+    if (flush) dav1d_flush(c);
+
+    end_threads(c);
     for (int n = 0; n < c->n_tile_data; n++)
         dav1d_data_unref_internal(&c->tile[n].data);
-    dav1d_free(c->tile);
+    dav1d_free_charged(c->tile);
     for (int n = 0; n < 8; n++) {
         dav1d_cdf_thread_unref(&c->cdf[n]);
         if (c->refs[n].p.p.frame_hdr)
@@ -698,6 +1512,10 @@ static COLD void close_internal(Dav1dContext **const c_out, int flush) {
     dav1d_mem_pool_end(c->cdf_pool);
     dav1d_mem_pool_end(c->picture_pool);
     dav1d_mem_pool_end(c->pic_ctx_pool);
+    dav1d_mem_account_unref(&c->mem);
+#ifdef HAVE_EVENTFD
+    if (c->picture_fd >= 0) close(c->picture_fd);
+#endif
 
     dav1d_freep_aligned(c_out);
 }
@@ -711,6 +1529,13 @@ int dav1d_get_event_flags(Dav1dContext *const c, enum Dav1dEventFlags *const fla
     return 0;
 }
 
+int dav1d_get_picture_fd(Dav1dContext *const c) {
+    validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(c->picture_fd >= 0, DAV1D_ERR(EINVAL));
+
+    return c->picture_fd;
+}
+
 int dav1d_get_decode_error_data_props(Dav1dContext *const c, Dav1dDataProps *const out) {
     validate_input_or_ret(c != NULL, DAV1D_ERR(EINVAL));
     validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
@@ -28,9 +28,35 @@
 #include "config.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include "src/internal.h"
 
+#if defined(__linux__)
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+#define HAVE_HUGE_PAGES 1
+#define HUGE_PAGE_SIZE ((size_t) 2 << 20)
+
+typedef struct HugeAllocation {
+    struct HugeAllocation *next;
+    void *ptr;
+    size_t sz;
+    int hugetlb; // from the reserved pool instead of transparent huge pages
+    Dav1dMemAccount *acct; // charged with the rounding up to whole huge pages
+    enum AllocationType type;
+    size_t slack;
+} HugeAllocation;
+
+static HugeAllocation *huge_allocs;
+static pthread_mutex_t huge_alloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 #if TRACK_HEAP_ALLOCATIONS
 #include <stdio.h>
 
@@ -230,76 +256,521 @@ COLD void dav1d_log_alloc_stats(Dav1dContext *const c) {
 }
 #endif /* TRACK_HEAP_ALLOCATIONS */
 
+void dav1d_mem_bind_node(void *const ptr, const size_t sz, const int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    if (node < 0 || node >= (int) sizeof(unsigned long) * 8) return;
+    // only pages fully inside the buffer, the others are shared with
+    // neighbouring allocations
+    const uintptr_t page_sz = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = ((uintptr_t) ptr + page_sz - 1) & ~(page_sz - 1);
+    const uintptr_t end = ((uintptr_t) ptr + sz) & ~(page_sz - 1);
+    if (end <= start) return;
+    const unsigned long nodemask = 1UL << node;
+    enum { MPOL_PREFERRED = 1 }; // from <numaif.h>
+    // already resident pages are not migrated, so this mainly affects
+    // newly allocated buffers
+    syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, &nodemask,
+            sizeof(nodemask) * 8, 0);
+#endif
+}
+
+#if HAVE_HUGE_PAGES
+// Returns a mapping of sz bytes aligned on a huge page boundary, so that all
+// of it can be backed by transparent huge pages.
+static void *map_huge_aligned(const size_t sz) {
+    uint8_t *const base = mmap(NULL, sz + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    uint8_t *const ptr = (uint8_t *)
+        (((uintptr_t) base + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+    if (ptr > base) munmap(base, ptr - base);
+    munmap(ptr + sz, base + HUGE_PAGE_SIZE - ptr);
+    madvise(ptr, sz, MADV_HUGEPAGE);
+    return ptr;
+}
+#endif
+
+void *dav1d_alloc_huge(Dav1dMemAccount *const acct, const enum AllocationType type,
+                       const size_t sz, const size_t align)
+{
+#if HAVE_HUGE_PAGES
+    if (sz >= HUGE_PAGE_SIZE && align <= HUGE_PAGE_SIZE) {
+        HugeAllocation *const h = dav1d_malloc(type, sizeof(*h));
+        if (!h) return NULL;
+        h->sz = (sz + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        h->acct = acct;
+        h->type = type;
+        h->slack = h->sz - sz;
+        if (acct && dav1d_mem_account_charge_ref(acct, type, h->slack)) {
+            dav1d_free(h);
+            return NULL;
+        }
+#ifdef MAP_HUGETLB
+        // explicit huge pages are only available if the system reserved some
+        h->ptr = mmap(NULL, h->sz, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        h->hugetlb = h->ptr != MAP_FAILED;
+#else
+        h->hugetlb = 0;
+#endif
+        if (!h->hugetlb && !(h->ptr = map_huge_aligned(h->sz))) {
+            if (acct) dav1d_mem_account_release_unref(acct, type, h->slack);
+            dav1d_free(h);
+            return NULL;
+        }
+        pthread_mutex_lock(&huge_alloc_mutex);
+        h->next = huge_allocs;
+        huge_allocs = h;
+        pthread_mutex_unlock(&huge_alloc_mutex);
+        return h->ptr;
+    }
+#endif
+    return dav1d_alloc_aligned(type, sz, align);
+}
+
+void dav1d_free_huge(void *const ptr) {
+#if HAVE_HUGE_PAGES
+    if (!ptr) return;
+    pthread_mutex_lock(&huge_alloc_mutex);
+    HugeAllocation **h = &huge_allocs;
+    while (*h && (*h)->ptr != ptr)
+        h = &(*h)->next;
+    HugeAllocation *const found = *h;
+    if (found) *h = found->next;
+    pthread_mutex_unlock(&huge_alloc_mutex);
+    if (found) {
+        munmap(found->ptr, found->sz);
+        if (found->acct)
+            dav1d_mem_account_release_unref(found->acct, found->type, found->slack);
+        dav1d_free(found);
+        return;
+    }
+#endif
+    dav1d_free_aligned(ptr);
+}
+
+COLD void dav1d_mem_get_huge_page_usage(size_t *const requested,
+                                        size_t *const backed)
+{
+    *requested = *backed = 0;
+#if HAVE_HUGE_PAGES
+    pthread_mutex_lock(&huge_alloc_mutex);
+    size_t thp_sz = 0;
+    for (const HugeAllocation *h = huge_allocs; h; h = h->next) {
+        *requested += h->sz;
+        if (h->hugetlb) *backed += h->sz;
+        else thp_sz += h->sz;
+    }
+    // transparent huge pages are only allocated when the memory is touched,
+    // and only if the kernel could find free huge pages, so ask it
+    FILE *const smaps = thp_sz ? fopen("/proc/self/smaps", "r") : NULL;
+    if (smaps) {
+        char line[256];
+        size_t overlap = 0, kb;
+        unsigned long start, end;
+        while (fgets(line, sizeof(line), smaps)) {
+            if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+                overlap = 0;
+                for (const HugeAllocation *h = huge_allocs; h; h = h->next) {
+                    const uintptr_t a = (uintptr_t) h->ptr, b = a + h->sz;
+                    if (!h->hugetlb && a < end && b > start)
+                        overlap += (b < end ? b : end) - (a > start ? a : start);
+                }
+            } else if (overlap && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+                *backed += (kb << 10) < overlap ? kb << 10 : overlap;
+            }
+        }
+        fclose(smaps);
+    }
+    pthread_mutex_unlock(&huge_alloc_mutex);
+#endif
+}
+
+COLD int dav1d_mem_account_create(Dav1dMemAccount **const acct_out,
+                                  const size_t limit)
+{
+    Dav1dMemAccount *const acct = dav1d_malloc(ALLOC_COMMON_CTX, sizeof(*acct));
+    if (!acct) return DAV1D_ERR(ENOMEM);
+    if (pthread_mutex_init(&acct->lock, NULL)) {
+        dav1d_free(acct);
+        return DAV1D_ERR(ENOMEM);
+    }
+    memset(acct->sz, 0, sizeof(acct->sz));
+    memset(acct->peak_sz, 0, sizeof(acct->peak_sz));
+    acct->total = acct->peak_total = 0;
+    acct->limit = limit;
+    acct->ref_cnt = 1;
+    *acct_out = acct;
+    return 0;
+}
+
+static COLD void mem_account_destroy(Dav1dMemAccount *const acct) {
+    pthread_mutex_destroy(&acct->lock);
+    dav1d_free(acct);
+}
+
+COLD void dav1d_mem_account_unref(Dav1dMemAccount **const pacct) {
+    Dav1dMemAccount *const acct = *pacct;
+    if (!acct) return;
+    *pacct = NULL;
+
+    pthread_mutex_lock(&acct->lock);
+    const int ref_cnt = --acct->ref_cnt;
+    pthread_mutex_unlock(&acct->lock);
+    if (!ref_cnt) mem_account_destroy(acct);
+}
+
+static int mem_account_charge(Dav1dMemAccount *const acct,
+                              const enum AllocationType type, const size_t sz,
+                              const int ref)
+{
+    int res = 0;
+    pthread_mutex_lock(&acct->lock);
+    if (acct->limit && sz > acct->limit - acct->total) {
+        res = DAV1D_ERR(ENOMEM);
+    } else {
+        acct->sz[type] += sz;
+        acct->total += sz;
+        if (acct->sz[type] > acct->peak_sz[type])
+            acct->peak_sz[type] = acct->sz[type];
+        if (acct->total > acct->peak_total)
+            acct->peak_total = acct->total;
+        acct->ref_cnt += ref;
+    }
+    pthread_mutex_unlock(&acct->lock);
+    return res;
+}
+
+static int mem_account_release(Dav1dMemAccount *const acct,
+                               const enum AllocationType type, const size_t sz,
+                               const int ref)
+{
+    pthread_mutex_lock(&acct->lock);
+    assert(acct->sz[type] >= sz);
+    acct->sz[type] -= sz;
+    acct->total -= sz;
+    const int ref_cnt = acct->ref_cnt -= ref;
+    pthread_mutex_unlock(&acct->lock);
+    return ref_cnt;
+}
+
+int dav1d_mem_account_charge(Dav1dMemAccount *const acct,
+                             const enum AllocationType type, const size_t sz)
+{
+    return mem_account_charge(acct, type, sz, 0);
+}
+
+void dav1d_mem_account_release(Dav1dMemAccount *const acct,
+                               const enum AllocationType type, const size_t sz)
+{
+    if (!sz) return;
+    mem_account_release(acct, type, sz, 0);
+}
+
+int dav1d_mem_account_charge_ref(Dav1dMemAccount *const acct,
+                                 const enum AllocationType type, const size_t sz)
+{
+    return mem_account_charge(acct, type, sz, 1);
+}
+
+void dav1d_mem_account_release_unref(Dav1dMemAccount *const acct,
+                                     const enum AllocationType type,
+                                     const size_t sz)
+{
+    if (!mem_account_release(acct, type, sz, 1))
+        mem_account_destroy(acct);
+}
+
+/*
+ * Charged allocations are preceded by a header recording what was charged
+ * to which account, so that they can be released without the caller having
+ * to keep track of it.
+ */
+typedef struct ChargedAllocation {
+    Dav1dMemAccount *acct;
+    size_t sz;
+    size_t offset; // from the start of the underlying allocation
+    enum AllocationType type;
+} ChargedAllocation;
+
+#define CHARGED_HDR_SZ 32
+
+static inline ChargedAllocation *charged_hdr(void *const ptr) {
+    return (ChargedAllocation *) ((uint8_t *) ptr - CHARGED_HDR_SZ);
+}
+
+static void *charged_init(Dav1dMemAccount *const acct,
+                          const enum AllocationType type, uint8_t *const base,
+                          const size_t sz, const size_t offset)
+{
+    if (!base) {
+        dav1d_mem_account_release_unref(acct, type, sz);
+        return NULL;
+    }
+    uint8_t *const ptr = base + offset;
+    ChargedAllocation *const h = charged_hdr(ptr);
+    h->acct = acct;
+    h->sz = sz;
+    h->offset = offset;
+    h->type = type;
+    return ptr;
+}
+
+void *dav1d_malloc_charged(Dav1dMemAccount *const acct,
+                           const enum AllocationType type, const size_t sz)
+{
+    assert(sizeof(ChargedAllocation) <= CHARGED_HDR_SZ);
+    if (sz > SIZE_MAX - CHARGED_HDR_SZ) return NULL;
+    if (dav1d_mem_account_charge_ref(acct, type, sz)) return NULL;
+    return charged_init(acct, type, dav1d_malloc(type, sz + CHARGED_HDR_SZ),
+                        sz, CHARGED_HDR_SZ);
+}
+
+void *dav1d_realloc_charged(Dav1dMemAccount *const acct,
+                            const enum AllocationType type, void *const ptr,
+                            const size_t sz)
+{
+    if (!ptr) return dav1d_malloc_charged(acct, type, sz);
+    if (sz > SIZE_MAX - CHARGED_HDR_SZ) return NULL;
+
+    ChargedAllocation *const h = charged_hdr(ptr);
+    assert(h->acct == acct && h->type == type && h->offset == CHARGED_HDR_SZ);
+    const size_t old_sz = h->sz;
+    if (sz > old_sz && dav1d_mem_account_charge(acct, type, sz - old_sz))
+        return NULL;
+    uint8_t *const base = dav1d_realloc(type, (uint8_t *) ptr - CHARGED_HDR_SZ,
+                                        sz + CHARGED_HDR_SZ);
+    if (!base) {
+        if (sz > old_sz) dav1d_mem_account_release(acct, type, sz - old_sz);
+        return NULL;
+    }
+    if (sz < old_sz) dav1d_mem_account_release(acct, type, old_sz - sz);
+    ((ChargedAllocation *) base)->sz = sz;
+    return base + CHARGED_HDR_SZ;
+}
+
+void *dav1d_alloc_aligned_charged(Dav1dMemAccount *const acct,
+                                  const enum AllocationType type,
+                                  const size_t sz, const size_t align)
+{
+    assert(sizeof(ChargedAllocation) <= CHARGED_HDR_SZ);
+    const size_t offset = align > CHARGED_HDR_SZ ? align : CHARGED_HDR_SZ;
+    if (sz > SIZE_MAX - offset) return NULL;
+    if (dav1d_mem_account_charge_ref(acct, type, sz)) return NULL;
+    return charged_init(acct, type, dav1d_alloc_aligned(type, sz + offset, offset),
+                        sz, offset);
+}
+
+void dav1d_free_charged(void *const ptr) {
+    if (!ptr) return;
+    const ChargedAllocation h = *charged_hdr(ptr);
+    dav1d_free((uint8_t *) ptr - h.offset);
+    dav1d_mem_account_release_unref(h.acct, h.type, h.sz);
+}
+
+void dav1d_free_aligned_charged(void *const ptr) {
+    if (!ptr) return;
+    const ChargedAllocation h = *charged_hdr(ptr);
+    dav1d_free_aligned((uint8_t *) ptr - h.offset);
+    dav1d_mem_account_release_unref(h.acct, h.type, h.sz);
+}
+
 static COLD void mem_pool_destroy(Dav1dMemPool *const pool) {
     pthread_mutex_destroy(&pool->lock);
     dav1d_free(pool);
 }
 
+static inline size_t mem_pool_buf_size(const Dav1dMemPoolBuffer *const buf) {
+    return (uintptr_t)buf - (uintptr_t)buf->data;
+}
+
+// Must be called with the pool lock held, for each buffer that is going
+// to be freed while the pool is still alive.
+static inline void mem_pool_release(Dav1dMemPool *const pool, const size_t sz) {
+    if (pool->acct) dav1d_mem_account_release(pool->acct, pool->type, sz);
+}
+
+static inline void mem_pool_free_data(const int huge, void *const data) {
+    if (huge) dav1d_free_huge(data);
+    else dav1d_free_aligned(data);
+}
+
+static void mem_pool_free_list(const int huge, Dav1dMemPoolBuffer *buf) {
+    while (buf) {
+        void *const data = buf->data;
+        buf = buf->next;
+        mem_pool_free_data(huge, data);
+    }
+}
+
+// Moves all buffers of a size class to *freed.
+static void mem_pool_drop_class(Dav1dMemPool *const pool,
+                                Dav1dMemPoolSizeClass *const cls,
+                                Dav1dMemPoolBuffer **const freed)
+{
+    const size_t cls_sz = cls->n_buf * (cls->size + sizeof(Dav1dMemPoolBuffer));
+    while (cls->buf) {
+        Dav1dMemPoolBuffer *const buf = cls->buf;
+        cls->buf = buf->next;
+        buf->next = *freed;
+        *freed = buf;
+    }
+    cls->n_buf = 0;
+    pool->idle_sz -= cls_sz;
+    mem_pool_release(pool, cls_sz);
+}
+
+// Removes idle buffers of the least recently used size classes until the
+// limit is met. The removed buffers are linked to *freed, to be released
+// outside of the critical section.
+static void mem_pool_trim(Dav1dMemPool *const pool,
+                          Dav1dMemPoolBuffer **const freed)
+{
+    while (pool->n_cls > 1) {
+        const size_t mru_sz = pool->cls[0].n_buf *
+                              (pool->cls[0].size + sizeof(Dav1dMemPoolBuffer));
+        if (pool->idle_sz - mru_sz <= pool->max_idle_sz) break;
+        mem_pool_drop_class(pool, &pool->cls[--pool->n_cls], freed);
+    }
+}
+
+// Returns the index of the size class, or -1 if there is none.
+static int mem_pool_find_class(const Dav1dMemPool *const pool, const size_t size) {
+    for (int i = 0; i < pool->n_cls; i++)
+        if (pool->cls[i].size == size) return i;
+    return -1;
+}
+
 void dav1d_mem_pool_push(Dav1dMemPool *const pool, Dav1dMemPoolBuffer *const buf) {
+    const size_t size = mem_pool_buf_size(buf);
+    // the pool may be destroyed by another thread once the lock is released
+    const int huge = pool->huge;
+    Dav1dMemPoolBuffer *freed = NULL;
     pthread_mutex_lock(&pool->lock);
     const int ref_cnt = --pool->ref_cnt;
     if (!pool->end) {
-        buf->next = pool->buf;
-        pool->buf = buf;
+        int i = mem_pool_find_class(pool, size);
+        if (i < 0 && pool->max_idle_sz && pool->n_cls < DAV1D_MEM_POOL_SIZE_CLASSES) {
+            // the size class was evicted while the buffer was in use
+            i = pool->n_cls++;
+            pool->cls[i].size = size;
+            pool->cls[i].buf = NULL;
+            pool->cls[i].n_buf = 0;
+        }
+        if (i >= 0) {
+            Dav1dMemPoolSizeClass *const cls = &pool->cls[i];
+            buf->next = cls->buf;
+            cls->buf = buf;
+            cls->n_buf++;
+            pool->idle_sz += size + sizeof(Dav1dMemPoolBuffer);
+            mem_pool_trim(pool, &freed);
+        } else {
+            freed = buf;
+            buf->next = NULL;
+            mem_pool_release(pool, size + sizeof(Dav1dMemPoolBuffer));
+        }
         pthread_mutex_unlock(&pool->lock);
         assert(ref_cnt > 0);
+        mem_pool_free_list(huge, freed);
     } else {
         pthread_mutex_unlock(&pool->lock);
-        dav1d_free_aligned(buf->data);
+        mem_pool_free_data(huge, buf->data);
         if (!ref_cnt) mem_pool_destroy(pool);
     }
 }
 
 Dav1dMemPoolBuffer *dav1d_mem_pool_pop(Dav1dMemPool *const pool, const size_t size) {
     assert(!(size & (sizeof(void*) - 1)));
+    const size_t alloc_sz = size + sizeof(Dav1dMemPoolBuffer);
+    const int huge = pool->huge;
+    Dav1dMemPoolBuffer *freed = NULL, *buf = NULL;
     pthread_mutex_lock(&pool->lock);
-    Dav1dMemPoolBuffer *buf = pool->buf;
+    Dav1dMemAccount *const acct = pool->acct;
     pool->ref_cnt++;
-    uint8_t *data;
-    if (buf) {
-        pool->buf = buf->next;
-        pthread_mutex_unlock(&pool->lock);
-        data = buf->data;
-        if ((uintptr_t)buf - (uintptr_t)data != size) {
-            /* Reallocate if the size has changed */
-            dav1d_free_aligned(data);
-            goto alloc;
+    int i = mem_pool_find_class(pool, size);
+    if (i < 0) {
+        // new size: make room for it, dropping the least recently used class
+        if (pool->n_cls == DAV1D_MEM_POOL_SIZE_CLASSES)
+            mem_pool_drop_class(pool, &pool->cls[--pool->n_cls], &freed);
+        i = pool->n_cls++;
+        pool->cls[i].size = size;
+        pool->cls[i].buf = NULL;
+        pool->cls[i].n_buf = 0;
+    }
+    if (i > 0) { // move to front
+        const Dav1dMemPoolSizeClass cls = pool->cls[i];
+        memmove(&pool->cls[1], &pool->cls[0], i * sizeof(*pool->cls));
+        pool->cls[0] = cls;
+        mem_pool_trim(pool, &freed);
+    }
+    Dav1dMemPoolSizeClass *const cls = &pool->cls[0];
+    int charged = 0;
+    if ((buf = cls->buf)) {
+        cls->buf = buf->next;
+        cls->n_buf--;
+        pool->idle_sz -= alloc_sz;
+        pool->hits++;
+    } else {
+        pool->misses++;
+        if (pool->acct) {
+            charged = !dav1d_mem_account_charge(pool->acct, pool->type, alloc_sz);
+            if (!charged) {
+                // over budget: give back the buffers of other sizes first
+                while (pool->n_cls > 1)
+                    mem_pool_drop_class(pool, &pool->cls[--pool->n_cls], &freed);
+                charged = !dav1d_mem_account_charge(pool->acct, pool->type, alloc_sz);
+            }
         }
+    }
+    const int over_budget = !buf && pool->acct && !charged;
+    const int ref_cnt = over_budget ? --pool->ref_cnt : pool->ref_cnt;
+    pthread_mutex_unlock(&pool->lock);
+    mem_pool_free_list(huge, freed);
+
+    if (buf) {
 #if TRACK_HEAP_ALLOCATIONS
         dav1d_track_reuse(pool->type);
 #endif
-    } else {
+        return buf;
+    }
+    if (over_budget) {
+        if (!ref_cnt) mem_pool_destroy(pool);
+        return NULL;
+    }
+
+    uint8_t *const data = huge ? dav1d_alloc_huge(acct, pool->type, alloc_sz, 64) :
+                                 dav1d_alloc_aligned(pool->type, alloc_sz, 64);
+    if (!data) {
+        pthread_mutex_lock(&pool->lock);
+        if (charged) mem_pool_release(pool, alloc_sz);
+        const int remaining = --pool->ref_cnt;
         pthread_mutex_unlock(&pool->lock);
-alloc:
-        data = dav1d_alloc_aligned(pool->type,
-                                   size + sizeof(Dav1dMemPoolBuffer), 64);
-        if (!data) {
-            pthread_mutex_lock(&pool->lock);
-            const int ref_cnt = --pool->ref_cnt;
-            pthread_mutex_unlock(&pool->lock);
-            if (!ref_cnt) mem_pool_destroy(pool);
-            return NULL;
-        }
-        buf = (Dav1dMemPoolBuffer*)(data + size);
-        buf->data = data;
+        if (!remaining) mem_pool_destroy(pool);
+        return NULL;
     }
+    buf = (Dav1dMemPoolBuffer*)(data + size);
+    buf->data = data;
 
     return buf;
 }
 
 COLD int dav1d_mem_pool_init(const enum AllocationType type,
+                             Dav1dMemAccount *const acct,
                              Dav1dMemPool **const ppool)
 {
     Dav1dMemPool *const pool = dav1d_malloc(ALLOC_COMMON_CTX,
                                             sizeof(Dav1dMemPool));
     if (pool) {
         if (!pthread_mutex_init(&pool->lock, NULL)) {
-            pool->buf = NULL;
+            pool->n_cls = 0;
+            pool->max_idle_sz = 0;
+            pool->idle_sz = 0;
+            pool->hits = pool->misses = 0;
             pool->ref_cnt = 1;
             pool->end = 0;
-#if TRACK_HEAP_ALLOCATIONS
+            pool->huge = 0;
             pool->type = type;
-#endif
+            pool->acct = acct;
             *ppool = pool;
             return 0;
         }
@@ -311,18 +782,39 @@ COLD int dav1d_mem_pool_init(const enum AllocationType type,
 
 COLD void dav1d_mem_pool_end(Dav1dMemPool *const pool) {
     if (pool) {
+        const int huge = pool->huge;
+        Dav1dMemPoolBuffer *freed = NULL;
         pthread_mutex_lock(&pool->lock);
-        Dav1dMemPoolBuffer *buf = pool->buf;
         const int ref_cnt = --pool->ref_cnt;
-        pool->buf = NULL;
+        while (pool->n_cls)
+            mem_pool_drop_class(pool, &pool->cls[--pool->n_cls], &freed);
         pool->end = 1;
+        // buffers still in use may outlive the owner of the account
+        pool->acct = NULL;
         pthread_mutex_unlock(&pool->lock);
 
-        while (buf) {
-            void *const data = buf->data;
-            buf = buf->next;
-            dav1d_free_aligned(data);
-        }
+        mem_pool_free_list(huge, freed);
         if (!ref_cnt) mem_pool_destroy(pool);
     }
 }
+
+COLD void dav1d_mem_pool_release_idle(Dav1dMemPool *const pool) {
+    const int huge = pool->huge;
+    Dav1dMemPoolBuffer *freed = NULL;
+    pthread_mutex_lock(&pool->lock);
+    // keep the size classes, so that buffers still in use return to the pool
+    for (int i = 0; i < pool->n_cls; i++)
+        mem_pool_drop_class(pool, &pool->cls[i], &freed);
+    pthread_mutex_unlock(&pool->lock);
+    mem_pool_free_list(huge, freed);
+}
+
+COLD void dav1d_mem_pool_get_stats(Dav1dMemPool *const pool, uint64_t *const hits,
+                                   uint64_t *const misses, size_t *const idle_sz)
+{
+    pthread_mutex_lock(&pool->lock);
+    *hits = pool->hits;
+    *misses = pool->misses;
+    *idle_sz = pool->idle_sz;
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -42,6 +42,7 @@
 
 #include "src/thread.h"
 
+// must match enum Dav1dMemoryType
 enum AllocationType {
     ALLOC_BLOCK,
     ALLOC_CDEF,
@@ -64,19 +65,49 @@ enum AllocationType {
     N_ALLOC_TYPES,
 };
 
+/*
+ * Per-context accounting of the memory held by the decoder, optionally
+ * bounded by a limit. Charges are made before the memory is allocated, so
+ * that an allocation which would exceed the limit fails instead. Charged
+ * allocations keep the account alive, since some of them (e.g. metadata
+ * attached to output pictures) can outlive the decoder.
+ */
+typedef struct Dav1dMemAccount {
+    pthread_mutex_t lock;
+    size_t sz[N_ALLOC_TYPES], peak_sz[N_ALLOC_TYPES];
+    size_t total, peak_total;
+    size_t limit; // 0 = unlimited
+    int ref_cnt; // the context and the outstanding charged allocations
+} Dav1dMemAccount;
+
 typedef struct Dav1dMemPoolBuffer {
     void *data;
     struct Dav1dMemPoolBuffer *next;
 } Dav1dMemPoolBuffer;
 
+#define DAV1D_MEM_POOL_SIZE_CLASSES 4
+
+typedef struct Dav1dMemPoolSizeClass {
+    size_t size;
+    Dav1dMemPoolBuffer *buf;
+    size_t n_buf;
+} Dav1dMemPoolSizeClass;
+
 typedef struct Dav1dMemPool {
     pthread_mutex_t lock;
-    Dav1dMemPoolBuffer *buf;
+    // idle buffers grouped by size, from most to least recently used size
+    Dav1dMemPoolSizeClass cls[DAV1D_MEM_POOL_SIZE_CLASSES];
+    int n_cls;
+    // maximum size of idle buffers kept in size classes other than the most
+    // recently used one (0 = release them as soon as the size changes)
+    size_t max_idle_sz;
+    size_t idle_sz; // total size of idle buffers
+    uint64_t hits, misses;
     int ref_cnt;
     int end;
-#if TRACK_HEAP_ALLOCATIONS
+    int huge; // allocate buffers with dav1d_alloc_huge()
     enum AllocationType type;
-#endif
+    Dav1dMemAccount *acct; // NULL once the pool has been ended
 } Dav1dMemPool;
 
 
@@ -88,7 +119,6 @@ void dav1d_free(void *ptr);
 void dav1d_free_aligned(void *ptr);
 void dav1d_log_alloc_stats(Dav1dContext *c);
 #else
-#define dav1d_mem_pool_init(type, pool) dav1d_mem_pool_init(pool)
 #define dav1d_malloc(type, sz) malloc(sz)
 #define dav1d_realloc(type, ptr, sz) realloc(ptr, sz)
 #define dav1d_free(ptr) free(ptr)
@@ -123,8 +153,70 @@ static inline void dav1d_free_aligned(void *ptr) {
 
 void dav1d_mem_pool_push(Dav1dMemPool *pool, Dav1dMemPoolBuffer *buf);
 Dav1dMemPoolBuffer *dav1d_mem_pool_pop(Dav1dMemPool *pool, size_t size);
-int dav1d_mem_pool_init(enum AllocationType type, Dav1dMemPool **pool);
+int dav1d_mem_pool_init(enum AllocationType type, Dav1dMemAccount *acct,
+                        Dav1dMemPool **pool);
 void dav1d_mem_pool_end(Dav1dMemPool *pool);
+void dav1d_mem_pool_release_idle(Dav1dMemPool *pool);
+void dav1d_mem_pool_get_stats(Dav1dMemPool *pool, uint64_t *hits,
+                              uint64_t *misses, size_t *idle_sz);
+
+int dav1d_mem_account_create(Dav1dMemAccount **acct, size_t limit);
+void dav1d_mem_account_unref(Dav1dMemAccount **acct);
+int dav1d_mem_account_charge(Dav1dMemAccount *acct, enum AllocationType type,
+                             size_t sz);
+void dav1d_mem_account_release(Dav1dMemAccount *acct, enum AllocationType type,
+                               size_t sz);
+// same as above, but the charge also holds a reference to the account
+int dav1d_mem_account_charge_ref(Dav1dMemAccount *acct, enum AllocationType type,
+                                 size_t sz);
+void dav1d_mem_account_release_unref(Dav1dMemAccount *acct,
+                                     enum AllocationType type, size_t sz);
+
+/*
+ * Allocate memory charged to an account, failing if that would exceed its
+ * limit. The return value of dav1d_malloc_charged() or dav1d_realloc_charged()
+ * can be released by calling the dav1d_free_charged() function, and that of
+ * dav1d_alloc_aligned_charged() by calling dav1d_free_aligned_charged(),
+ * which also release the charge.
+ */
+void *dav1d_malloc_charged(Dav1dMemAccount *acct, enum AllocationType type,
+                           size_t sz);
+void *dav1d_realloc_charged(Dav1dMemAccount *acct, enum AllocationType type,
+                            void *ptr, size_t sz);
+void *dav1d_alloc_aligned_charged(Dav1dMemAccount *acct, enum AllocationType type,
+                                  size_t sz, size_t align);
+void dav1d_free_charged(void *ptr);
+void dav1d_free_aligned_charged(void *ptr);
+
+/*
+ * Allocate a large, long-lived buffer on huge pages where supported (Linux),
+ * which reduces TLB misses when accessing it. Buffers smaller than a huge
+ * page are allocated with dav1d_alloc_aligned(). The caller charges sz, while
+ * the rounding up of the mapping to whole huge pages is charged to acct (if
+ * not NULL) until the buffer is released, which fails the allocation if it
+ * exceeds the limit. The return value can be
+ * released by calling the dav1d_free_huge() function, which also accepts
+ * buffers from dav1d_alloc_aligned(). Since it looks the buffer up in a list
+ * shared by all decoder instances, buffers known not to come from
+ * dav1d_alloc_huge() should be released with dav1d_free_aligned() instead.
+ */
+void *dav1d_alloc_huge(Dav1dMemAccount *acct, enum AllocationType type,
+                       size_t sz, size_t align);
+void dav1d_free_huge(void *ptr);
+
+/*
+ * Get the size of the buffers of all decoder instances allocated by
+ * dav1d_alloc_huge() on huge pages, and how much of it is actually backed
+ * by huge pages. Slow on Linux, since the kernel has to be queried.
+ */
+void dav1d_mem_get_huge_page_usage(size_t *requested, size_t *backed);
+
+/*
+ * Prefer allocating the pages of a buffer on the given NUMA node when they
+ * are first touched. No-op if node is negative or on other systems than
+ * Linux.
+ */
+void dav1d_mem_bind_node(void *ptr, size_t sz, int node);
 
 static inline void dav1d_freep_aligned(void *ptr) {
     void **mem = (void **) ptr;
@@ -44,6 +44,7 @@
 #include "src/obu.h"
 #include "src/ref.h"
 #include "src/thread_task.h"
+#include "src/trace.h"
 
 static int check_trailing_bits(GetBits *const gb,
                                const int strict_std_compliance)
@@ -338,6 +339,121 @@ int dav1d_parse_sequence_header(Dav1dSequenceHeader *const out,
     return res;
 }
 
+// Parses the leading part of the uncompressed header, which only depends on
+// the sequence header, up to and including refresh_frame_flags.
+static int parse_frame_info(Dav1dFrameInfo *const out,
+                            const Dav1dSequenceHeader *const seqhdr,
+                            GetBits *const gb)
+{
+    out->show_existing_frame =
+        !seqhdr->reduced_still_picture_header && dav1d_get_bit(gb);
+    if (out->show_existing_frame) {
+        out->existing_frame_idx = dav1d_get_bits(gb, 3);
+        return gb->error ? DAV1D_ERR(EINVAL) : 0;
+    }
+    out->existing_frame_idx = 0;
+
+    out->frame_type = seqhdr->reduced_still_picture_header ? DAV1D_FRAME_TYPE_KEY : dav1d_get_bits(gb, 2);
+    out->show_frame = seqhdr->reduced_still_picture_header || dav1d_get_bit(gb);
+    if (out->show_frame) {
+        if (seqhdr->decoder_model_info_present && !seqhdr->equal_picture_interval)
+            dav1d_get_bits(gb, seqhdr->frame_presentation_delay_length);
+        out->showable_frame = out->frame_type != DAV1D_FRAME_TYPE_KEY;
+    } else
+        out->showable_frame = dav1d_get_bit(gb);
+    const int error_resilient_mode =
+        (out->frame_type == DAV1D_FRAME_TYPE_KEY && out->show_frame) ||
+        out->frame_type == DAV1D_FRAME_TYPE_SWITCH ||
+        seqhdr->reduced_still_picture_header || dav1d_get_bit(gb);
+    const int is_intra = out->frame_type == DAV1D_FRAME_TYPE_KEY ||
+                         out->frame_type == DAV1D_FRAME_TYPE_INTRA;
+
+    dav1d_get_bit(gb); // disable_cdf_update
+    const int allow_screen_content_tools =
+        seqhdr->screen_content_tools == DAV1D_ADAPTIVE ?
+        dav1d_get_bit(gb) : seqhdr->screen_content_tools;
+    if (allow_screen_content_tools && seqhdr->force_integer_mv == DAV1D_ADAPTIVE)
+        dav1d_get_bit(gb); // force_integer_mv
+    if (seqhdr->frame_id_numbers_present)
+        dav1d_get_bits(gb, seqhdr->frame_id_n_bits);
+    if (!seqhdr->reduced_still_picture_header &&
+        out->frame_type != DAV1D_FRAME_TYPE_SWITCH)
+    {
+        dav1d_get_bit(gb); // frame_size_override
+    }
+    out->frame_offset = seqhdr->order_hint ?
+                        dav1d_get_bits(gb, seqhdr->order_hint_n_bits) : 0;
+    if (!error_resilient_mode && !is_intra)
+        dav1d_get_bits(gb, 3); // primary_ref_frame
+
+    if (seqhdr->decoder_model_info_present && dav1d_get_bit(gb)) {
+        for (int i = 0; i < seqhdr->num_operating_points; i++) {
+            const struct Dav1dSequenceHeaderOperatingPoint *const seqop = &seqhdr->operating_points[i];
+            if (seqop->decoder_model_param_present) {
+                int in_temporal_layer = (seqop->idc >> out->temporal_id) & 1;
+                int in_spatial_layer  = (seqop->idc >> (out->spatial_id + 8)) & 1;
+                if (!seqop->idc || (in_temporal_layer && in_spatial_layer))
+                    dav1d_get_bits(gb, seqhdr->buffer_removal_delay_length);
+            }
+        }
+    }
+
+    out->refresh_frame_flags =
+        (out->frame_type == DAV1D_FRAME_TYPE_KEY && out->show_frame) ||
+        out->frame_type == DAV1D_FRAME_TYPE_SWITCH ? 0xff : dav1d_get_bits(gb, 8);
+
+    return gb->error ? DAV1D_ERR(EINVAL) : 0;
+}
+
+int dav1d_parse_frame_info(Dav1dFrameInfo *const out,
+                           const Dav1dSequenceHeader *const seq_hdr,
+                           const uint8_t *const ptr, const size_t sz)
+{
+    validate_input_or_ret(out != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(seq_hdr != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(ptr != NULL, DAV1D_ERR(EINVAL));
+    validate_input_or_ret(sz > 0 && sz <= INT_MAX, DAV1D_ERR(EINVAL));
+
+    GetBits gb;
+    dav1d_init_get_bits(&gb, ptr, sz);
+
+    do {
+        dav1d_get_bit(&gb); // obu_forbidden_bit
+        const enum Dav1dObuType type = dav1d_get_bits(&gb, 4);
+        const int has_extension = dav1d_get_bit(&gb);
+        const int has_length_field = dav1d_get_bit(&gb);
+        dav1d_get_bit(&gb); // reserved
+        int temporal_id = 0, spatial_id = 0;
+        if (has_extension) {
+            temporal_id = dav1d_get_bits(&gb, 3);
+            spatial_id = dav1d_get_bits(&gb, 2);
+            dav1d_get_bits(&gb, 3); // reserved
+        }
+
+        const uint8_t *obu_end = gb.ptr_end;
+        if (has_length_field) {
+            const size_t len = dav1d_get_uleb128(&gb);
+            if (len > (size_t)(obu_end - gb.ptr)) return DAV1D_ERR(EINVAL);
+            obu_end = gb.ptr + len;
+        }
+        if (gb.error) return DAV1D_ERR(EINVAL);
+
+        if (type == DAV1D_OBU_FRAME_HDR || type == DAV1D_OBU_FRAME) {
+            out->temporal_id = temporal_id;
+            out->spatial_id = spatial_id;
+            const int res = parse_frame_info(out, seq_hdr, &gb);
+            if (res < 0) return res;
+            if (gb.ptr > obu_end) return DAV1D_ERR(EINVAL);
+            return (int) (obu_end - ptr);
+        }
+
+        assert(gb.state == 0 && gb.bits_left == 0);
+        gb.ptr = obu_end;
+    } while (gb.ptr < gb.ptr_end);
+
+    return DAV1D_ERR(ENOENT);
+}
+
 static int read_frame_size(Dav1dContext *const c, GetBits *const gb,
                            const int use_ref)
 {
@@ -1253,6 +1369,14 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             return gb.ptr_end - gb.ptr_start;
     }
 
+    // the frame still waiting for tile groups won't receive any more of them
+    if (c->tile_frame && (type == DAV1D_OBU_SEQ_HDR || type == DAV1D_OBU_TD ||
+                          type == DAV1D_OBU_FRAME || type == DAV1D_OBU_FRAME_HDR))
+    {
+        dav1d_abort_tile_groups(c);
+    }
+
+    uint64_t start = dav1d_stage_time_start(c);
     switch (type) {
     case DAV1D_OBU_SEQ_HDR: {
         Dav1dRef *ref = dav1d_ref_create_using_pool(c->seq_hdr_pool,
@@ -1341,11 +1465,12 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             }
         }
 
-        if (c->frame_size_limit && (int64_t)c->frame_hdr->width[1] *
-            c->frame_hdr->height > c->frame_size_limit)
+        const unsigned frame_size_limit = dav1d_get_frame_size_limit(c, c->seq_hdr->hbd);
+        if (frame_size_limit && (int64_t)c->frame_hdr->width[1] *
+            c->frame_hdr->height > frame_size_limit)
         {
             dav1d_log(c, "Frame size %dx%d exceeds limit %u\n", c->frame_hdr->width[1],
-                      c->frame_hdr->height, c->frame_size_limit);
+                      c->frame_hdr->height, frame_size_limit);
             c->frame_hdr = NULL;
             return DAV1D_ERR(ERANGE);
         }
@@ -1367,8 +1492,9 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
         if (!c->frame_hdr) goto error;
         if (c->n_tile_data_alloc < c->n_tile_data + 1) {
             if ((c->n_tile_data + 1) > INT_MAX / (int)sizeof(*c->tile)) goto error;
-            struct Dav1dTileGroup *tile = dav1d_realloc(ALLOC_TILE, c->tile,
-                                                        (c->n_tile_data + 1) * sizeof(*c->tile));
+            struct Dav1dTileGroup *tile =
+                dav1d_realloc_charged(c->mem, ALLOC_TILE, c->tile,
+                                      (c->n_tile_data + 1) * sizeof(*c->tile));
             if (!tile) goto error;
             c->tile = tile;
             memset(c->tile + c->n_tile_data, 0, sizeof(*c->tile));
@@ -1411,6 +1537,10 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             Dav1dRef *ref = dav1d_ref_create(ALLOC_OBU_META,
                                              sizeof(Dav1dContentLightLevel));
             if (!ref) return DAV1D_ERR(ENOMEM);
+            if (dav1d_ref_charge(ref, c->mem) < 0) {
+                dav1d_ref_dec(&ref);
+                return DAV1D_ERR(ENOMEM);
+            }
             Dav1dContentLightLevel *const content_light = ref->data;
 
             content_light->max_content_light_level = dav1d_get_bits(&gb, 16);
@@ -1440,6 +1570,10 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             Dav1dRef *ref = dav1d_ref_create(ALLOC_OBU_META,
                                              sizeof(Dav1dMasteringDisplay));
             if (!ref) return DAV1D_ERR(ENOMEM);
+            if (dav1d_ref_charge(ref, c->mem) < 0) {
+                dav1d_ref_dec(&ref);
+                return DAV1D_ERR(ENOMEM);
+            }
             Dav1dMasteringDisplay *const mastering_display = ref->data;
 
             for (int i = 0; i < 3; i++) {
@@ -1507,8 +1641,9 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             }
 
             if ((c->n_itut_t35 + 1) > INT_MAX / (int)sizeof(*c->itut_t35)) goto error;
-            struct Dav1dITUTT35 *itut_t35 = dav1d_realloc(ALLOC_OBU_META, c->itut_t35,
-                                                          (c->n_itut_t35 + 1) * sizeof(*c->itut_t35));
+            struct Dav1dITUTT35 *itut_t35 =
+                dav1d_realloc_charged(c->mem, ALLOC_OBU_META, c->itut_t35,
+                                      (c->n_itut_t35 + 1) * sizeof(*c->itut_t35));
             if (!itut_t35) goto error;
             c->itut_t35 = itut_t35;
             memset(c->itut_t35 + c->n_itut_t35, 0, sizeof(*c->itut_t35));
@@ -1516,7 +1651,8 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             struct itut_t35_ctx_context *itut_t35_ctx;
             if (!c->n_itut_t35) {
                 assert(!c->itut_t35_ref);
-                itut_t35_ctx = dav1d_malloc(ALLOC_OBU_META, sizeof(struct itut_t35_ctx_context));
+                itut_t35_ctx = dav1d_malloc_charged(c->mem, ALLOC_OBU_META,
+                                                    sizeof(struct itut_t35_ctx_context));
                 if (!itut_t35_ctx) goto error;
                 c->itut_t35_ref = dav1d_ref_init(&itut_t35_ctx->ref, c->itut_t35,
                                                  dav1d_picture_free_itut_t35, itut_t35_ctx, 0);
@@ -1529,7 +1665,8 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             itut_t35_ctx->n_itut_t35 = c->n_itut_t35 + 1;
 
             Dav1dITUTT35 *const itut_t35_metadata = &c->itut_t35[c->n_itut_t35];
-            itut_t35_metadata->payload = dav1d_malloc(ALLOC_OBU_META, payload_size);
+            itut_t35_metadata->payload =
+                dav1d_malloc_charged(c->mem, ALLOC_OBU_META, payload_size);
             if (!itut_t35_metadata->payload) goto error;
 
             itut_t35_metadata->country_code = country_code;
@@ -1567,8 +1704,13 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
         dav1d_log(c, "Unknown OBU type %d of size %td\n", type, gb.ptr_end - gb.ptr);
         break;
     }
+    // decoding the frame doesn't count as parsing
+    dav1d_stage_time_lap(&c->caller_times.parse, &start);
 
-    if (c->seq_hdr && c->frame_hdr) {
+    if (c->tile_frame) {
+        if (c->n_tile_data && (res = dav1d_submit_tile_groups(c)) < 0)
+            return res;
+    } else if (c->seq_hdr && c->frame_hdr) {
         if (c->frame_hdr->show_existing_frame) {
             if (!c->refs[c->frame_hdr->existing_frame_idx].p.p.frame_hdr) goto error;
             switch (c->refs[c->frame_hdr->existing_frame_idx].p.p.frame_hdr->frame_type) {
@@ -1605,45 +1747,52 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
                 c->event_flags |= dav1d_picture_get_event_flags(&c->refs[c->frame_hdr->existing_frame_idx].p);
             } else {
                 pthread_mutex_lock(&c->task_thread.lock);
-                // need to append this to the frame output queue
-                const unsigned next = c->frame_thread.next++;
-                if (c->frame_thread.next == c->n_fc)
-                    c->frame_thread.next = 0;
-
-                Dav1dFrameContext *const f = &c->fc[next];
-                while (f->n_tile_data > 0)
-                    pthread_cond_wait(&f->task_thread.cond,
-                                      &f->task_thread.ttd->lock);
-                Dav1dThreadPicture *const out_delayed =
-                    &c->frame_thread.out_delayed[next];
-                if (out_delayed->p.data[0] || atomic_load(&f->task_thread.error)) {
-                    unsigned first = atomic_load(&c->task_thread.first);
-                    if (first + 1U < c->n_fc)
-                        atomic_fetch_add(&c->task_thread.first, 1U);
-                    else
-                        atomic_store(&c->task_thread.first, 0);
-                    atomic_compare_exchange_strong(&c->task_thread.reset_task_cur,
-                                                   &first, UINT_MAX);
-                    if (c->task_thread.cur && c->task_thread.cur < c->n_fc)
-                        c->task_thread.cur--;
-                }
-                const int error = f->task_thread.retval;
-                if (error) {
-                    c->cached_error = error;
-                    f->task_thread.retval = 0;
-                    dav1d_data_props_copy(&c->cached_error_props, &out_delayed->p.m);
-                    dav1d_thread_picture_unref(out_delayed);
-                } else if (out_delayed->p.data[0]) {
-                    const unsigned progress = atomic_load_explicit(&out_delayed->progress[1],
-                                                                   memory_order_relaxed);
-                    if ((out_delayed->visible || c->output_invisible_frames) &&
-                        progress != FRAME_ERROR)
-                    {
-                        dav1d_thread_picture_ref(&c->out, out_delayed);
-                        c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
+                // need to append this to the frame output queue, after
+                // outputting the oldest frame once the frame delay is reached
+                if (c->frame_thread.n_busy >= c->frame_thread.delay) {
+                    const unsigned next = c->frame_thread.next++;
+                    if (c->frame_thread.next == c->n_fc)
+                        c->frame_thread.next = 0;
+                    c->frame_thread.n_busy--;
+
+                    Dav1dFrameContext *const f = &c->fc[next];
+                    while (f->n_tile_data > 0)
+                        pthread_cond_wait(&f->task_thread.cond,
+                                          &f->task_thread.ttd->lock);
+                    Dav1dThreadPicture *const out_delayed =
+                        &c->frame_thread.out_delayed[next];
+                    if (out_delayed->p.data[0] || atomic_load(&f->task_thread.error)) {
+                        unsigned first = atomic_load(&c->task_thread.first);
+                        if (first + 1U < c->n_fc)
+                            atomic_fetch_add(&c->task_thread.first, 1U);
+                        else
+                            atomic_store(&c->task_thread.first, 0);
+                    }
+                    const int error = f->task_thread.retval;
+                    if (error) {
+                        c->cached_error = error;
+                        f->task_thread.retval = 0;
+                        dav1d_data_props_copy(&c->cached_error_props, &out_delayed->p.m);
+                        dav1d_thread_picture_unref(out_delayed);
+                    } else if (out_delayed->p.data[0]) {
+                        const unsigned progress = atomic_load_explicit(&out_delayed->progress[1],
+                                                                       memory_order_relaxed);
+                        if ((out_delayed->visible || c->output_invisible_frames) &&
+                            progress != FRAME_ERROR && !f->frame_thread.early_output)
+                        {
+                            dav1d_thread_picture_ref(&c->out, out_delayed);
+                            c->event_flags |= dav1d_picture_get_event_flags(out_delayed);
+                        }
+                        dav1d_thread_picture_unref(out_delayed);
                     }
-                    dav1d_thread_picture_unref(out_delayed);
                 }
+
+                unsigned slot = c->frame_thread.next + c->frame_thread.n_busy++;
+                if (slot >= c->n_fc) slot -= c->n_fc;
+                c->fc[slot].frame_thread.done_time = 0;
+                c->fc[slot].frame_thread.early_output = 0;
+                Dav1dThreadPicture *const out_delayed =
+                    &c->frame_thread.out_delayed[slot];
                 dav1d_thread_picture_ref(out_delayed,
                                          &c->refs[c->frame_hdr->existing_frame_idx].p);
                 out_delayed->visible = 1;
@@ -1680,7 +1829,9 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
                 }
             }
             c->frame_hdr = NULL;
-        } else if (c->n_tiles == c->frame_hdr->tiling.cols * c->frame_hdr->tiling.rows) {
+        } else if (c->n_tiles == c->frame_hdr->tiling.cols * c->frame_hdr->tiling.rows ||
+                   (c->early_tile_groups && c->n_tile_data))
+        {
             switch (c->frame_hdr->frame_type) {
             case DAV1D_FRAME_TYPE_INTER:
             case DAV1D_FRAME_TYPE_SWITCH:
@@ -1703,8 +1854,10 @@ ptrdiff_t dav1d_parse_obus(Dav1dContext *const c, Dav1dData *const in) {
             if ((res = dav1d_submit_frame(c)) < 0)
                 return res;
             assert(!c->n_tile_data);
-            c->frame_hdr = NULL;
-            c->n_tiles = 0;
+            if (!c->tile_frame) {
+                c->frame_hdr = NULL;
+                c->n_tiles = 0;
+            }
         }
     }
 
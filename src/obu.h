@@ -33,4 +33,11 @@
 
 ptrdiff_t dav1d_parse_obus(Dav1dContext *c, Dav1dData *in);
 
+// the frame size limit for content of the given bit-depth (0 = unlimited)
+static inline unsigned dav1d_get_frame_size_limit(const Dav1dContext *const c,
+                                                  const int hbd)
+{
+    return hbd ? c->hbd_frame_size_limit : c->frame_size_limit;
+}
+
 #endif /* DAV1D_SRC_OBU_H */
@@ -89,6 +89,8 @@ void dav1d_default_picture_release(Dav1dPicture *const p, void *const cookie) {
 struct pic_ctx_context {
     Dav1dPicAllocator allocator;
     Dav1dPicture pic;
+    Dav1dPicture scaled; // reduced resolution copy for output, if any
+    atomic_uint *progress; // decoding progress with frame threading, or NULL
     Dav1dRef ref;
     void *extra_data[];
 };
@@ -97,6 +99,8 @@ static void free_buffer(const uint8_t *const data, void *const user_data) {
     Dav1dMemPoolBuffer *buf = (Dav1dMemPoolBuffer *)data;
     struct pic_ctx_context *pic_ctx = buf->data;
 
+    if (pic_ctx->scaled.data[0])
+        dav1d_picture_unref_internal(&pic_ctx->scaled);
     pic_ctx->allocator.release_picture_callback(&pic_ctx->pic,
                                                 pic_ctx->allocator.cookie);
     dav1d_mem_pool_push(user_data, buf);
@@ -106,9 +110,9 @@ void dav1d_picture_free_itut_t35(const uint8_t *const data, void *const user_dat
     struct itut_t35_ctx_context *itut_t35_ctx = user_data;
 
     for (size_t i = 0; i < itut_t35_ctx->n_itut_t35; i++)
-        dav1d_free(itut_t35_ctx->itut_t35[i].payload);
-    dav1d_free(itut_t35_ctx->itut_t35);
-    dav1d_free(itut_t35_ctx);
+        dav1d_free_charged(itut_t35_ctx->itut_t35[i].payload);
+    dav1d_free_charged(itut_t35_ctx->itut_t35);
+    dav1d_free_charged(itut_t35_ctx);
 }
 
 static int picture_alloc(Dav1dContext *const c,
@@ -127,7 +131,9 @@ static int picture_alloc(Dav1dContext *const c,
     }
     assert(bpc > 0 && bpc <= 16);
 
-    size_t extra = c->n_fc > 1 ? sizeof(atomic_int) * 2 : 0;
+    // the progress counters are reserved even without frame threading,
+    // since the decoder may switch to it while this picture is a reference
+    size_t extra = extra_ptr ? sizeof(atomic_int) * 2 : 0;
     Dav1dMemPoolBuffer *buf = dav1d_mem_pool_pop(c->pic_ctx_pool,
                                                  extra + sizeof(struct pic_ctx_context));
     if (buf == NULL)
@@ -150,6 +156,8 @@ static int picture_alloc(Dav1dContext *const c,
 
     pic_ctx->allocator = *p_allocator;
     pic_ctx->pic = *p;
+    memset(&pic_ctx->scaled, 0, sizeof(pic_ctx->scaled));
+    pic_ctx->progress = extra ? (atomic_uint *) pic_ctx->extra_data : NULL;
     p->ref = dav1d_ref_init(&pic_ctx->ref, buf, free_buffer, c->pic_ctx_pool, 0);
 
     p->seq_hdr_ref = seq_hdr_ref;
@@ -158,7 +166,7 @@ static int picture_alloc(Dav1dContext *const c,
     p->frame_hdr_ref = frame_hdr_ref;
     if (frame_hdr_ref) dav1d_ref_inc(frame_hdr_ref);
 
-    if (extra && extra_ptr)
+    if (extra)
         *extra_ptr = &pic_ctx->extra_data;
 
     return 0;
@@ -219,12 +227,25 @@ int dav1d_thread_picture_alloc(Dav1dContext *const c, Dav1dFrameContext *const f
     p->flags = c->frame_flags;
     c->frame_flags &= flags_mask;
 
+    if (f->task_thread.node >= 0 &&
+        c->allocator.alloc_picture_callback == dav1d_default_picture_alloc)
+    {
+        // all planes are in a single buffer
+        const int ss_ver = p->p.p.layout == DAV1D_PIXEL_LAYOUT_I420;
+        uint8_t *const start = p->p.data[0];
+        const uint8_t *const end = p->p.data[2] ?
+            (uint8_t *) p->p.data[2] + p->p.stride[1] * ((p->p.p.h + ss_ver) >> ss_ver) :
+            start + p->p.stride[0] * p->p.p.h;
+        dav1d_mem_bind_node(start, end - start, f->task_thread.node);
+    }
+
     p->visible = f->frame_hdr->show_frame;
     p->showable = f->frame_hdr->showable_frame;
-    if (c->n_fc > 1) {
-        atomic_init(&p->progress[0], 0);
-        atomic_init(&p->progress[1], 0);
-    }
+    // without frame threading, the picture is complete by the time it can
+    // be referenced by another frame
+    const unsigned progress = c->n_fc > 1 ? 0 : UINT_MAX;
+    atomic_init(&p->progress[0], progress);
+    atomic_init(&p->progress[1], progress);
     return res;
 }
 
@@ -248,6 +269,47 @@ int dav1d_picture_alloc_copy(Dav1dContext *const c, Dav1dPicture *const dst, con
     return 0;
 }
 
+int dav1d_picture_alloc_scaled(Dav1dContext *const c, const Dav1dPicture *const p,
+                               const int shift)
+{
+    Dav1dMemPoolBuffer *const buf = (Dav1dMemPoolBuffer *)p->ref->const_data;
+    struct pic_ctx_context *const pic_ctx = buf->data;
+    Dav1dPicture *const scaled = &pic_ctx->scaled;
+    const int res = picture_alloc(c, scaled, (p->p.w + (1 << shift) - 1) >> shift,
+                                  (p->p.h + (1 << shift) - 1) >> shift,
+                                  p->seq_hdr, p->seq_hdr_ref,
+                                  p->frame_hdr, p->frame_hdr_ref,
+                                  p->p.bpc, &p->m, &pic_ctx->allocator,
+                                  NULL);
+    if (res) return res;
+
+    dav1d_picture_copy_props(scaled, p->content_light, p->content_light_ref,
+                             p->mastering_display, p->mastering_display_ref,
+                             p->itut_t35, p->itut_t35_ref, p->n_itut_t35,
+                             &p->m);
+
+    return 0;
+}
+
+Dav1dPicture *dav1d_picture_get_scaled(const Dav1dPicture *const p) {
+    if (!p->ref) return NULL;
+    const Dav1dMemPoolBuffer *const buf = (const Dav1dMemPoolBuffer *)p->ref->const_data;
+    struct pic_ctx_context *const pic_ctx = buf->data;
+    return pic_ctx->scaled.data[0] ? &pic_ctx->scaled : NULL;
+}
+
+unsigned dav1d_picture_get_progress(const Dav1dPicture *const p) {
+    if (!p->ref) return UINT_MAX;
+    const Dav1dMemPoolBuffer *const buf = (const Dav1dMemPoolBuffer *)p->ref->const_data;
+    const struct pic_ctx_context *const pic_ctx = buf->data;
+    if (!pic_ctx->progress) return UINT_MAX;
+    const unsigned progress = atomic_load(&pic_ctx->progress[1]);
+    if (progress == FRAME_ERROR || progress == UINT_MAX) return progress;
+    // the bottom 8 rows of the published sbrows are only final once the
+    // post-filters have run on the next sbrow
+    return progress > 8 ? progress - 8 : 0;
+}
+
 void dav1d_picture_ref(Dav1dPicture *const dst, const Dav1dPicture *const src) {
     assert(dst != NULL);
     assert(dst->data[0] == NULL);
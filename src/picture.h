@@ -82,6 +82,24 @@ int dav1d_thread_picture_alloc(Dav1dContext *c, Dav1dFrameContext *f, const int
 int dav1d_picture_alloc_copy(Dav1dContext *c, Dav1dPicture *dst, const int w,
                              const Dav1dPicture *src);
 
+/**
+ * Allocate a copy of a picture at a resolution reduced by 1 << shift, which
+ * is output in its place. The copy shares the lifetime of the picture.
+ */
+int dav1d_picture_alloc_scaled(Dav1dContext *c, const Dav1dPicture *p, int shift);
+
+/**
+ * Get the reduced resolution copy of a picture, or NULL if it has none.
+ */
+Dav1dPicture *dav1d_picture_get_scaled(const Dav1dPicture *p);
+
+/**
+ * Get the number of final luma rows of a picture which may still be decoding
+ * (see Dav1dThreadPicture.progress), UINT_MAX if it is complete or
+ * FRAME_ERROR if its decoding failed.
+ */
+unsigned dav1d_picture_get_progress(const Dav1dPicture *p);
+
 /**
  * Create a copy of a picture.
  */
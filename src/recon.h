@@ -49,6 +49,10 @@ typedef decl_recon_b_inter_fn(*recon_b_inter_fn);
 void (name)(Dav1dFrameContext *f, int sby)
 typedef decl_filter_sbrow_fn(*filter_sbrow_fn);
 
+#define decl_downscale_sbrows_fn(name) \
+void (name)(const Dav1dFrameContext *f, int sby_start, int sby_end)
+typedef decl_downscale_sbrows_fn(*downscale_sbrows_fn);
+
 #define decl_backup_ipred_edge_fn(name) \
 void (name)(Dav1dTaskContext *t)
 typedef decl_backup_ipred_edge_fn(*backup_ipred_edge_fn);
@@ -88,6 +92,9 @@ decl_filter_sbrow_fn(dav1d_filter_sbrow_resize_16bpc);
 decl_filter_sbrow_fn(dav1d_filter_sbrow_lr_8bpc);
 decl_filter_sbrow_fn(dav1d_filter_sbrow_lr_16bpc);
 
+decl_downscale_sbrows_fn(dav1d_downscale_sbrows_8bpc);
+decl_downscale_sbrows_fn(dav1d_downscale_sbrows_16bpc);
+
 decl_backup_ipred_edge_fn(dav1d_backup_ipred_edge_8bpc);
 decl_backup_ipred_edge_fn(dav1d_backup_ipred_edge_16bpc);
 
@@ -723,6 +723,77 @@ static int decode_coefs(Dav1dTaskContext *const t,
     return eob;
 }
 
+// With frame threading, the coefficients of a transform block are kept
+// between the two passes as their first eob + 1 values in scan order, rather
+// than in the (mostly empty) dense layout of the inverse transforms. This
+// moves the coefficients decoded into cf (which is cleared again) to the
+// tile's coefficient buffer.
+static void store_coefs(Dav1dTileState *const ts, coef *const cf,
+                        const enum RectTxfmSize tx, const enum TxfmType txtp,
+                        const int eob)
+{
+    if (eob < 0) return;
+    coef *const dst = ts->frame_thread[1].cf;
+    switch (dav1d_tx_type_class[txtp]) {
+    case TX_CLASS_2D: {
+        const uint16_t *const scan = dav1d_scans[tx];
+        for (int i = 0; i <= eob; i++) {
+            dst[i] = cf[scan[i]];
+            cf[scan[i]] = 0;
+        }
+        break;
+    }
+    case TX_CLASS_H:
+        memcpy(dst, cf, (eob + 1) * sizeof(*cf));
+        memset(cf, 0, (eob + 1) * sizeof(*cf));
+        break;
+    case TX_CLASS_V: {
+        const TxfmInfo *const t_dim = &dav1d_txfm_dimensions[tx];
+        const unsigned shift = t_dim->lw + 2, shift2 = t_dim->lh + 2;
+        const unsigned mask = 4 * imin(t_dim->w, 8) - 1;
+        for (unsigned i = 0; i <= (unsigned) eob; i++) {
+            const unsigned rc = ((i & mask) << shift2) | (i >> shift);
+            dst[i] = cf[rc];
+            cf[rc] = 0;
+        }
+        break;
+    }
+    }
+    ts->frame_thread[1].cf = dst + eob + 1;
+}
+
+// expands the coefficients stored by store_coefs() into the (cleared) input
+// buffer of the inverse transforms, which is returned
+static coef *load_coefs(Dav1dTaskContext *const t, const enum RectTxfmSize tx,
+                        const enum TxfmType txtp, const int eob)
+{
+    Dav1dTileState *const ts = t->ts;
+    coef *const cf = bitfn(t->cf);
+    if (eob < 0) return cf;
+    const coef *const src = ts->frame_thread[0].cf;
+    switch (dav1d_tx_type_class[txtp]) {
+    case TX_CLASS_2D: {
+        const uint16_t *const scan = dav1d_scans[tx];
+        for (int i = 0; i <= eob; i++)
+            cf[scan[i]] = src[i];
+        break;
+    }
+    case TX_CLASS_H:
+        memcpy(cf, src, (eob + 1) * sizeof(*cf));
+        break;
+    case TX_CLASS_V: {
+        const TxfmInfo *const t_dim = &dav1d_txfm_dimensions[tx];
+        const unsigned shift = t_dim->lw + 2, shift2 = t_dim->lh + 2;
+        const unsigned mask = 4 * imin(t_dim->w, 8) - 1;
+        for (unsigned i = 0; i <= (unsigned) eob; i++)
+            cf[((i & mask) << shift2) | (i >> shift)] = src[i];
+        break;
+    }
+    }
+    ts->frame_thread[0].cf += eob + 1;
+    return cf;
+}
+
 static void read_coef_tree(Dav1dTaskContext *const t,
                            const enum BlockSize bs, const Av1Block *const b,
                            const enum RectTxfmSize ytx, const int depth,
@@ -771,15 +842,8 @@ static void read_coef_tree(Dav1dTaskContext *const t,
         int eob;
         coef *cf;
 
-        if (t->frame_thread.pass) {
-            const int p = t->frame_thread.pass & 1;
-            assert(ts->frame_thread[p].cf);
-            cf = ts->frame_thread[p].cf;
-            ts->frame_thread[p].cf += imin(t_dim->w, 8) * imin(t_dim->h, 8) * 16;
-        } else {
-            cf = bitfn(t->cf);
-        }
         if (t->frame_thread.pass != 2) {
+            cf = bitfn(t->cf);
             eob = decode_coefs(t, &t->a->lcoef[bx4], &t->l.lcoef[by4],
                                ytx, bs, b, 0, 0, cf, &txtp, &cf_ctx);
             if (DEBUG_BLOCK_INFO)
@@ -801,12 +865,15 @@ static void read_coef_tree(Dav1dTaskContext *const t,
             uint8_t *txtp_map = &t->scratch.txtp_map[by4 * 32 + bx4];
             case_set_upto16(txw,,,);
 #undef set_ctx
-            if (t->frame_thread.pass == 1)
+            if (t->frame_thread.pass == 1) {
                 *ts->frame_thread[1].cbi++ = eob * (1 << 5) + txtp;
+                store_coefs(ts, cf, ytx, txtp, eob);
+            }
         } else {
             const int cbi = *ts->frame_thread[0].cbi++;
             eob  = cbi >> 5;
             txtp = cbi & 0x1f;
+            cf = load_coefs(t, ytx, txtp, eob);
         }
         if (!(t->frame_thread.pass & 1)) {
             assert(dst);
@@ -884,12 +951,12 @@ void bytefn(dav1d_read_coef_blocks)(Dav1dTaskContext *const t,
                         const int eob =
                             decode_coefs(t, &t->a->lcoef[bx4 + x],
                                          &t->l.lcoef[by4 + y], b->tx, bs, b, 1,
-                                         0, ts->frame_thread[1].cf, &txtp, &cf_ctx);
+                                         0, bitfn(t->cf), &txtp, &cf_ctx);
                         if (DEBUG_BLOCK_INFO)
                             printf("Post-y-cf-blk[tx=%d,txtp=%d,eob=%d]: r=%d\n",
                                    b->tx, txtp, eob, ts->msac.rng);
                         *ts->frame_thread[1].cbi++ = eob * (1 << 5) + txtp;
-                        ts->frame_thread[1].cf += imin(t_dim->w, 8) * imin(t_dim->h, 8) * 16;
+                        store_coefs(ts, bitfn(t->cf), b->tx, txtp, eob);
 #define set_ctx(type, dir, diridx, off, mul, rep_macro) \
                         rep_macro(type, t->dir lcoef, off, mul * cf_ctx)
 #define default_memset(dir, diridx, off, sz) \
@@ -925,14 +992,14 @@ void bytefn(dav1d_read_coef_blocks)(Dav1dTaskContext *const t,
                         const int eob =
                             decode_coefs(t, &t->a->ccoef[pl][cbx4 + x],
                                          &t->l.ccoef[pl][cby4 + y], b->uvtx, bs,
-                                         b, b->intra, 1 + pl, ts->frame_thread[1].cf,
+                                         b, b->intra, 1 + pl, bitfn(t->cf),
                                          &txtp, &cf_ctx);
                         if (DEBUG_BLOCK_INFO)
                             printf("Post-uv-cf-blk[pl=%d,tx=%d,"
                                    "txtp=%d,eob=%d]: r=%d\n",
                                    pl, b->uvtx, txtp, eob, ts->msac.rng);
                         *ts->frame_thread[1].cbi++ = eob * (1 << 5) + txtp;
-                        ts->frame_thread[1].cf += uv_t_dim->w * uv_t_dim->h * 16;
+                        store_coefs(ts, bitfn(t->cf), b->uvtx, txtp, eob);
 #define set_ctx(type, dir, diridx, off, mul, rep_macro) \
                         rep_macro(type, t->dir ccoef[pl], off, mul * cf_ctx)
 #define default_memset(dir, diridx, off, sz) \
@@ -1316,10 +1383,9 @@ void bytefn(dav1d_recon_b_intra)(Dav1dTaskContext *const t, const enum BlockSize
                         if (t->frame_thread.pass) {
                             const int p = t->frame_thread.pass & 1;
                             const int cbi = *ts->frame_thread[p].cbi++;
-                            cf = ts->frame_thread[p].cf;
-                            ts->frame_thread[p].cf += imin(t_dim->w, 8) * imin(t_dim->h, 8) * 16;
                             eob  = cbi >> 5;
                             txtp = cbi & 0x1f;
+                            cf = load_coefs(t, b->tx, txtp, eob);
                         } else {
                             uint8_t cf_ctx;
                             cf = bitfn(t->cf);
@@ -1539,10 +1605,9 @@ void bytefn(dav1d_recon_b_intra)(Dav1dTaskContext *const t, const enum BlockSize
                             if (t->frame_thread.pass) {
                                 const int p = t->frame_thread.pass & 1;
                                 const int cbi = *ts->frame_thread[p].cbi++;
-                                cf = ts->frame_thread[p].cf;
-                                ts->frame_thread[p].cf += uv_t_dim->w * uv_t_dim->h * 16;
                                 eob  = cbi >> 5;
                                 txtp = cbi & 0x1f;
+                                cf = load_coefs(t, b->uvtx, txtp, eob);
                             } else {
                                 uint8_t cf_ctx;
                                 cf = bitfn(t->cf);
@@ -1706,8 +1771,7 @@ int bytefn(dav1d_recon_b_inter)(Dav1dTaskContext *const t, const enum BlockSize
                              r[-1][t->bx - 1].mv.mv[0],
                              &f->refp[r[-1][t->bx - 1].ref.ref[0] - 1],
                              r[-1][t->bx - 1].ref.ref[0] - 1,
-                             t->frame_thread.pass != 2 ? t->tl_4x4_filter :
-                                 f->frame_thread.b[((t->by - 1) * f->b4_stride) + t->bx - 1].filter2d);
+                             t->tl_4x4_filter);
                     if (res) return res;
                 }
                 v_off = 2 * PXSTRIDE(f->cur.stride[1]);
@@ -1722,8 +1786,7 @@ int bytefn(dav1d_recon_b_inter)(Dav1dTaskContext *const t, const enum BlockSize
                              t->by, 1 + pl, r[0][t->bx - 1].mv.mv[0],
                              &f->refp[r[0][t->bx - 1].ref.ref[0] - 1],
                              r[0][t->bx - 1].ref.ref[0] - 1,
-                             t->frame_thread.pass != 2 ? left_filter_2d :
-                                 f->frame_thread.b[(t->by * f->b4_stride) + t->bx - 1].filter2d);
+                             left_filter_2d);
                     if (res) return res;
                 }
                 h_off = 2;
@@ -1737,8 +1800,7 @@ int bytefn(dav1d_recon_b_inter)(Dav1dTaskContext *const t, const enum BlockSize
                              1 + pl, r[-1][t->bx].mv.mv[0],
                              &f->refp[r[-1][t->bx].ref.ref[0] - 1],
                              r[-1][t->bx].ref.ref[0] - 1,
-                             t->frame_thread.pass != 2 ? top_filter_2d :
-                                 f->frame_thread.b[((t->by - 1) * f->b4_stride) + t->bx].filter2d);
+                             top_filter_2d);
                     if (res) return res;
                 }
                 v_off = 2 * PXSTRIDE(f->cur.stride[1]);
@@ -1981,10 +2043,9 @@ int bytefn(dav1d_recon_b_inter)(Dav1dTaskContext *const t, const enum BlockSize
                         if (t->frame_thread.pass) {
                             const int p = t->frame_thread.pass & 1;
                             const int cbi = *ts->frame_thread[p].cbi++;
-                            cf = ts->frame_thread[p].cf;
-                            ts->frame_thread[p].cf += uvtx->w * uvtx->h * 16;
                             eob  = cbi >> 5;
                             txtp = cbi & 0x1f;
+                            cf = load_coefs(t, b->uvtx, txtp, eob);
                         } else {
                             uint8_t cf_ctx;
                             cf = bitfn(t->cf);
@@ -2159,6 +2220,64 @@ void bytefn(dav1d_filter_sbrow)(Dav1dFrameContext *const f, const int sby) {
         bytefn(dav1d_filter_sbrow_lr)(f, sby);
 }
 
+// Averages boxes of (1 << shift) x (1 << shift) pixels, which are clipped to
+// the plane at the right and bottom edges.
+static void downscale_plane(pixel *dst, const ptrdiff_t dst_stride,
+                            const pixel *src, const ptrdiff_t src_stride,
+                            const int dst_w, const int src_w, const int src_h,
+                            const int y_start, const int y_end, const int shift)
+{
+    const int n = 1 << shift;
+    dst += y_start * PXSTRIDE(dst_stride);
+    src += (y_start << shift) * PXSTRIDE(src_stride);
+    for (int y = y_start; y < y_end; y++) {
+        const int h = imin(n, src_h - (y << shift));
+        for (int x = 0; x < dst_w; x++) {
+            const int w = imin(n, src_w - (x << shift));
+            const pixel *s = &src[x << shift];
+            unsigned sum = 0;
+            for (int j = 0; j < h; j++, s += PXSTRIDE(src_stride))
+                for (int i = 0; i < w; i++)
+                    sum += s[i];
+            const int cnt = w * h;
+            assert(cnt > 0);
+            dst[x] = cnt == n * n ? (sum + (cnt >> 1)) >> (shift * 2) :
+                                    (sum + (cnt >> 1)) / cnt;
+        }
+        dst += PXSTRIDE(dst_stride);
+        src += PXSTRIDE(src_stride) << shift;
+    }
+}
+
+void bytefn(dav1d_downscale_sbrows)(const Dav1dFrameContext *const f,
+                                    const int sby_start, const int sby_end)
+{
+    const Dav1dPicture *const scaled = dav1d_picture_get_scaled(&f->sr_cur.p);
+    if (!scaled) return;
+    const int shift = f->c->output_downscale;
+    const int sbsz = f->sb_step * 4;
+    const int h = f->sr_cur.p.p.h;
+    // the bottom 8 rows of an sbrow are only final once the post-filters
+    // have run on the next one
+    const int y_start = sby_start ? sby_start * sbsz - 8 : 0;
+    const int y_end = sby_end == f->sbh ? h : sby_end * sbsz - 8;
+    const enum Dav1dPixelLayout layout = f->sr_cur.p.p.layout;
+    const int has_chroma = layout != DAV1D_PIXEL_LAYOUT_I400;
+    for (int pl = 0; pl < 1 + 2 * has_chroma; pl++) {
+        const int ss_ver = pl && layout == DAV1D_PIXEL_LAYOUT_I420;
+        const int ss_hor = pl && layout != DAV1D_PIXEL_LAYOUT_I444;
+        const int dst_h = (scaled->p.h + ss_ver) >> ss_ver;
+        const int start = (y_start >> ss_ver) >> shift;
+        const int end = y_end == h ? dst_h : (y_end >> ss_ver) >> shift;
+        if (start >= end) continue;
+        downscale_plane(scaled->data[pl], scaled->stride[!!pl],
+                        f->sr_cur.p.data[pl], f->sr_cur.p.stride[!!pl],
+                        (scaled->p.w + ss_hor) >> ss_hor,
+                        (f->sr_cur.p.p.w + ss_hor) >> ss_hor,
+                        (h + ss_ver) >> ss_ver, start, end, shift);
+    }
+}
+
 void bytefn(dav1d_backup_ipred_edge)(Dav1dTaskContext *const t) {
     const Dav1dFrameContext *const f = t->f;
     Dav1dTileState *const ts = t->ts;
@@ -45,6 +45,10 @@ Dav1dRef *dav1d_ref_create(const enum AllocationType type, size_t size) {
     atomic_init(&res->ref_cnt, 1);
     res->free_ref = 0;
     res->free_callback = default_free_callback;
+    res->alloc_sz = size + sizeof(Dav1dRef);
+    res->alloc_type = type;
+    atomic_init(&res->charged, 0);
+    res->acct = NULL;
 
     return res;
 }
@@ -67,6 +71,9 @@ Dav1dRef *dav1d_ref_create_using_pool(Dav1dMemPool *const pool, size_t size) {
     res->free_ref = 0;
     res->free_callback = pool_free_callback;
     res->user_data = buf;
+    res->alloc_sz = 0; // charged by the pool
+    atomic_init(&res->charged, 0);
+    res->acct = NULL;
 
     return res;
 }
@@ -80,7 +87,25 @@ void dav1d_ref_dec(Dav1dRef **const pref) {
     *pref = NULL;
     if (atomic_fetch_sub(&ref->ref_cnt, 1) == 1) {
         const int free_ref = ref->free_ref;
+        Dav1dMemAccount *const acct = ref->acct;
+        const enum AllocationType alloc_type = ref->alloc_type;
+        const size_t alloc_sz = ref->alloc_sz;
         ref->free_callback(ref->const_data, ref->user_data);
         if (free_ref) dav1d_free(ref);
+        if (acct) dav1d_mem_account_release_unref(acct, alloc_type, alloc_sz);
     }
 }
+
+// Charges the memory allocated by dav1d for ref to acct, unless it was already
+// charged to a decoder, until ref is freed. Fails if that exceeds the limit.
+int dav1d_ref_charge(Dav1dRef *const ref, Dav1dMemAccount *const acct) {
+    if (!ref->alloc_sz || atomic_exchange(&ref->charged, 1)) return 0;
+
+    const int res = dav1d_mem_account_charge_ref(acct, ref->alloc_type, ref->alloc_sz);
+    if (res < 0) {
+        atomic_store(&ref->charged, 0);
+        return res;
+    }
+    ref->acct = acct;
+    return 0;
+}
@@ -43,15 +43,18 @@ struct Dav1dRef {
     int free_ref;
     void (*free_callback)(const uint8_t *data, void *user_data);
     void *user_data;
+    // memory allocated by dav1d, which is charged to the account of the
+    // first decoder using it until it's freed (see dav1d_ref_charge())
+    size_t alloc_sz;
+    enum AllocationType alloc_type;
+    atomic_int charged;
+    Dav1dMemAccount *acct;
 };
 
-#if !TRACK_HEAP_ALLOCATIONS
-#define dav1d_ref_create(type, size) dav1d_ref_create(size)
-#endif
-
 Dav1dRef *dav1d_ref_create(enum AllocationType type, size_t size);
 Dav1dRef *dav1d_ref_create_using_pool(Dav1dMemPool *pool, size_t size);
 void dav1d_ref_dec(Dav1dRef **ref);
+int dav1d_ref_charge(Dav1dRef *ref, Dav1dMemAccount *acct);
 
 static inline Dav1dRef *dav1d_ref_init(Dav1dRef *const ref, const void *const ptr,
                                        void (*const free_callback)(const uint8_t *data, void *user_data),
@@ -63,6 +66,9 @@ static inline Dav1dRef *dav1d_ref_init(Dav1dRef *const ref, const void *const pt
     ref->free_ref = free_ref;
     ref->free_callback = free_callback;
     ref->user_data = user_data;
+    ref->alloc_sz = 0;
+    atomic_init(&ref->charged, 0);
+    ref->acct = NULL;
     return ref;
 }
 
@@ -803,7 +803,8 @@ int dav1d_refmvs_init_frame(refmvs_frame *const rf,
                             refmvs_temporal_block *const rp,
                             const unsigned ref_ref_poc[7][7],
                             /*const*/ refmvs_temporal_block *const rp_ref[7],
-                            const int n_tile_threads, const int n_frame_threads)
+                            const int n_tile_threads, const int n_frame_threads,
+                            Dav1dMemAccount *const acct, const int huge_pages)
 {
     const int rp_stride = ((frm_hdr->width[0] + 127) & ~127) >> 3;
     const int n_tile_rows = n_tile_threads > 1 ? frm_hdr->tiling.rows : 1;
@@ -825,12 +826,23 @@ int dav1d_refmvs_init_frame(refmvs_frame *const rf,
         const size_t rp_proj_sz = sizeof(*rf->rp_proj) * 16 * n_blocks;
         /* Note that sizeof(*rf->r) == 12, but it's accessed using 16-byte unaligned
          * loads in save_tmvs() asm which can overread 4 bytes into rp_proj. */
-        dav1d_free_aligned(rf->r);
-        rf->r = dav1d_alloc_aligned(ALLOC_REFMVS, r_sz + rp_proj_sz, 64);
+        if (huge_pages)
+            dav1d_free_huge(rf->r);
+        else
+            dav1d_free_aligned(rf->r);
+        dav1d_mem_account_release(acct, ALLOC_REFMVS, rf->r_sz);
+        rf->r = NULL;
+        rf->r_sz = 0;
+        rf->n_blocks = 0;
+        if (dav1d_mem_account_charge(acct, ALLOC_REFMVS, r_sz + rp_proj_sz))
+            return DAV1D_ERR(ENOMEM);
+        rf->r = huge_pages ? dav1d_alloc_huge(acct, ALLOC_REFMVS, r_sz + rp_proj_sz, 64) :
+                             dav1d_alloc_aligned(ALLOC_REFMVS, r_sz + rp_proj_sz, 64);
         if (!rf->r) {
-            rf->n_blocks = 0;
+            dav1d_mem_account_release(acct, ALLOC_REFMVS, r_sz + rp_proj_sz);
             return DAV1D_ERR(ENOMEM);
         }
+        rf->r_sz = r_sz + rp_proj_sz;
 
         rf->rp_proj = (refmvs_temporal_block*)((uintptr_t)rf->r + r_sz);
         rf->n_blocks = n_blocks;
@@ -35,6 +35,7 @@
 #include "common/intops.h"
 
 #include "src/intra_edge.h"
+#include "src/mem.h"
 #include "src/tables.h"
 
 #define INVALID_MV 0x80008000
@@ -79,6 +80,7 @@ typedef struct refmvs_frame {
     ptrdiff_t rp_stride;
 
     refmvs_block *r; // 35 x r_stride memory
+    size_t r_sz; // allocated size of r and rp_proj, charged to the memory budget
     int n_tile_threads, n_frame_threads;
 } refmvs_frame;
 
@@ -129,7 +131,8 @@ int dav1d_refmvs_init_frame(refmvs_frame *rf,
                             refmvs_temporal_block *rp,
                             const unsigned ref_ref_poc[7][7],
                             /*const*/ refmvs_temporal_block *const rp_ref[7],
-                            int n_tile_threads, int n_frame_threads);
+                            int n_tile_threads, int n_frame_threads,
+                            Dav1dMemAccount *acct, int huge_pages);
 
 // cache the current tile/sbrow (or frame/sbrow)'s projectable motion vectors
 // into buffers for use in future frame's temporal MV prediction
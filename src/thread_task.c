@@ -27,73 +27,20 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "common/frame.h"
 
 #include "src/thread_task.h"
 #include "src/fg_apply.h"
-
-// This function resets the cur pointer to the first frame theoretically
-// executable after a task completed (ie. each time we update some progress or
-// insert some tasks in the queue).
-// When frame_idx is set, it can be either from a completed task, or from tasks
-// inserted in the queue, in which case we have to make sure the cur pointer
-// isn't past this insert.
-// The special case where frame_idx is UINT_MAX is to handle the reset after
-// completing a task and locklessly signaling progress. In this case we don't
-// enter a critical section, which is needed for this function, so we set an
-// atomic for a delayed handling, happening here. Meaning we can call this
-// function without any actual update other than what's in the atomic, hence
-// this special case.
-static inline int reset_task_cur(const Dav1dContext *const c,
-                                 struct TaskThreadData *const ttd,
-                                 unsigned frame_idx)
-{
-    const unsigned first = atomic_load(&ttd->first);
-    unsigned reset_frame_idx = atomic_exchange(&ttd->reset_task_cur, UINT_MAX);
-    if (reset_frame_idx < first) {
-        if (frame_idx == UINT_MAX) return 0;
-        reset_frame_idx = UINT_MAX;
-    }
-    if (!ttd->cur && c->fc[first].task_thread.task_cur_prev == NULL)
-        return 0;
-    if (reset_frame_idx != UINT_MAX) {
-        if (frame_idx == UINT_MAX) {
-            if (reset_frame_idx > first + ttd->cur)
-                return 0;
-            ttd->cur = reset_frame_idx - first;
-            goto cur_found;
-        }
-    } else if (frame_idx == UINT_MAX)
-        return 0;
-    if (frame_idx < first) frame_idx += c->n_fc;
-    const unsigned min_frame_idx = umin(reset_frame_idx, frame_idx);
-    const unsigned cur_frame_idx = first + ttd->cur;
-    if (ttd->cur < c->n_fc && cur_frame_idx < min_frame_idx)
-        return 0;
-    for (ttd->cur = min_frame_idx - first; ttd->cur < c->n_fc; ttd->cur++)
-        if (c->fc[(first + ttd->cur) % c->n_fc].task_thread.task_head)
-            break;
-cur_found:
-    for (unsigned i = ttd->cur; i < c->n_fc; i++)
-        c->fc[(first + i) % c->n_fc].task_thread.task_cur_prev = NULL;
-    return 1;
-}
-
-static inline void reset_task_cur_async(struct TaskThreadData *const ttd,
-                                        unsigned frame_idx, unsigned n_frames)
-{
-    const unsigned first = atomic_load(&ttd->first);
-    if (frame_idx < first) frame_idx += n_frames;
-    unsigned last_idx = frame_idx;
-    do {
-        frame_idx = last_idx;
-        last_idx = atomic_exchange(&ttd->reset_task_cur, frame_idx);
-    } while (last_idx < frame_idx);
-    if (frame_idx == first && atomic_load(&ttd->first) != first) {
-        unsigned expected = frame_idx;
-        atomic_compare_exchange_strong(&ttd->reset_task_cur, &expected, UINT_MAX);
-    }
-}
+#include "src/trace.h"
 
 static void insert_tasks_between(Dav1dFrameContext *const f,
                                  Dav1dTask *const first, Dav1dTask *const last,
@@ -107,9 +54,8 @@ static void insert_tasks_between(Dav1dFrameContext *const f,
     else a->next = first;
     if (!b) f->task_thread.task_tail = last;
     last->next = b;
-    reset_task_cur(f->c, ttd, first->frame_idx);
     if (cond_signal && !atomic_fetch_or(&ttd->cond_signaled, 1))
-        pthread_cond_signal(&ttd->cond);
+        dav1d_task_signal(ttd);
 }
 
 static void insert_tasks(Dav1dFrameContext *const f,
@@ -210,9 +156,9 @@ static inline int merge_pending(const Dav1dContext *const c) {
     return res;
 }
 
-static int create_filter_sbrow(Dav1dFrameContext *const f,
-                               const int pass, Dav1dTask **res_t)
-{
+// sets up the post-filter tasks of all sbrows, which are queued once their
+// dependencies are resolved (refer to resolve_filter_dep())
+static int create_filter_sbrow(Dav1dFrameContext *const f, const int pass) {
     const int has_deblock = f->frame_hdr->loopfilter.level_y[0] ||
                             f->frame_hdr->loopfilter.level_y[1];
     const int has_cdef = f->seq_hdr->cdef;
@@ -224,44 +170,54 @@ static int create_filter_sbrow(Dav1dFrameContext *const f,
     int num_tasks = f->sbh * (1 + uses_2pass);
     if (num_tasks > f->task_thread.num_tasks) {
         const size_t size = sizeof(Dav1dTask) * num_tasks;
-        tasks = dav1d_realloc(ALLOC_COMMON_CTX, f->task_thread.tasks, size);
+        tasks = dav1d_realloc_charged(f->c->mem, ALLOC_COMMON_CTX, f->task_thread.tasks, size);
         if (!tasks) return -1;
         memset(tasks, 0, size);
         f->task_thread.tasks = tasks;
+        atomic_int *const deps =
+            dav1d_realloc_charged(f->c->mem, ALLOC_COMMON_CTX, f->task_thread.filter_deps,
+                                  (num_tasks + f->sbh) * sizeof(*deps));
+        if (!deps) return -1;
+        f->task_thread.filter_deps = deps;
+        f->task_thread.filter_row_deps = deps + num_tasks;
         f->task_thread.num_tasks = num_tasks;
     }
     tasks += f->sbh * (pass & 1);
+    atomic_int *const deps = f->task_thread.filter_deps + f->sbh * (pass & 1);
 
-    if (pass & 1) {
-        f->frame_thread.entropy_progress = 0;
-    } else {
+    if (!(pass & 1)) {
         const int prog_sz = ((f->sbh + 31) & ~31) >> 5;
         if (prog_sz > f->frame_thread.prog_sz) {
-            atomic_uint *const prog = dav1d_realloc(ALLOC_COMMON_CTX, f->frame_thread.frame_progress,
-                                                    2 * prog_sz * sizeof(*prog));
+            atomic_uint *const prog =
+                dav1d_realloc_charged(f->c->mem, ALLOC_COMMON_CTX,
+                                      f->frame_thread.frame_progress,
+                                      prog_sz * sizeof(*prog));
             if (!prog) return -1;
             f->frame_thread.frame_progress = prog;
-            f->frame_thread.copy_lpf_progress = prog + prog_sz;
         }
         f->frame_thread.prog_sz = prog_sz;
         memset(f->frame_thread.frame_progress, 0, prog_sz * sizeof(atomic_uint));
-        memset(f->frame_thread.copy_lpf_progress, 0, prog_sz * sizeof(atomic_uint));
-        atomic_store(&f->frame_thread.deblock_progress, 0);
+        for (int sby = 0; sby < f->sbh; sby++)
+            atomic_init(&f->task_thread.filter_row_deps[sby], 0);
+        f->task_thread.downscale_sby = 0;
+    }
+
+    const enum TaskType type =
+        pass == 1 ? DAV1D_TASK_TYPE_ENTROPY_PROGRESS :
+        has_deblock ? DAV1D_TASK_TYPE_DEBLOCK_COLS :
+        has_cdef || has_lr /* i.e. LR backup */ ? DAV1D_TASK_TYPE_DEBLOCK_ROWS :
+        has_resize ? DAV1D_TASK_TYPE_SUPER_RESOLUTION :
+        DAV1D_TASK_TYPE_RECONSTRUCTION_PROGRESS;
+    for (int sby = 0; sby < f->sbh; sby++) {
+        Dav1dTask *const t = &tasks[sby];
+        t->sby = sby;
+        t->recon_progress = sby + 1;
+        t->type = type;
+        t->frame_idx = (int)(f - f->c->fc);
+        // the tiles of the sbrow, and the preceding sbrow's task
+        atomic_init(&deps[sby], f->frame_hdr->tiling.cols + !!sby);
     }
-    f->frame_thread.next_tile_row[pass & 1] = 0;
 
-    Dav1dTask *t = &tasks[0];
-    t->sby = 0;
-    t->recon_progress = 1;
-    t->deblock_progress = 0;
-    t->type = pass == 1 ? DAV1D_TASK_TYPE_ENTROPY_PROGRESS :
-              has_deblock ? DAV1D_TASK_TYPE_DEBLOCK_COLS :
-              has_cdef || has_lr /* i.e. LR backup */ ? DAV1D_TASK_TYPE_DEBLOCK_ROWS :
-              has_resize ? DAV1D_TASK_TYPE_SUPER_RESOLUTION :
-              DAV1D_TASK_TYPE_RECONSTRUCTION_PROGRESS;
-    t->frame_idx = (int)(f - f->c->fc);
-
-    *res_t = t;
     return 0;
 }
 
@@ -275,7 +231,8 @@ int dav1d_task_create_tile_sbrow(Dav1dFrameContext *const f, const int pass,
         int alloc_num_tasks = num_tasks * (1 + uses_2pass);
         if (alloc_num_tasks > f->task_thread.num_tile_tasks) {
             const size_t size = sizeof(Dav1dTask) * alloc_num_tasks;
-            tasks = dav1d_realloc(ALLOC_COMMON_CTX, f->task_thread.tile_tasks[0], size);
+            tasks = dav1d_realloc_charged(f->c->mem, ALLOC_COMMON_CTX,
+                                          f->task_thread.tile_tasks[0], size);
             if (!tasks) return -1;
             memset(tasks, 0, size);
             f->task_thread.tile_tasks[0] = tasks;
@@ -285,8 +242,7 @@ int dav1d_task_create_tile_sbrow(Dav1dFrameContext *const f, const int pass,
     }
     tasks += num_tasks * (pass & 1);
 
-    Dav1dTask *pf_t;
-    if (create_filter_sbrow(f, pass, &pf_t))
+    if (create_filter_sbrow(f, pass))
         return -1;
 
     Dav1dTask *prev_t = NULL;
@@ -294,13 +250,7 @@ int dav1d_task_create_tile_sbrow(Dav1dFrameContext *const f, const int pass,
         Dav1dTileState *const ts = &f->ts[tile_idx];
         Dav1dTask *t = &tasks[tile_idx];
         t->sby = ts->tiling.row_start >> f->sb_shift;
-        if (pf_t && t->sby) {
-            prev_t->next = pf_t;
-            prev_t = pf_t;
-            pf_t = NULL;
-        }
         t->recon_progress = 0;
-        t->deblock_progress = 0;
         t->deps_skip = 0;
         t->type = pass != 1 ? DAV1D_TASK_TYPE_TILE_RECONSTRUCTION :
                               DAV1D_TASK_TYPE_TILE_ENTROPY;
@@ -308,10 +258,6 @@ int dav1d_task_create_tile_sbrow(Dav1dFrameContext *const f, const int pass,
         if (prev_t) prev_t->next = t;
         prev_t = t;
     }
-    if (pf_t) {
-        prev_t->next = pf_t;
-        prev_t = pf_t;
-    }
     prev_t->next = NULL;
 
     atomic_store(&f->task_thread.done[pass & 1], 0);
@@ -342,10 +288,30 @@ void dav1d_task_frame_init(Dav1dFrameContext *const f) {
     t->type = DAV1D_TASK_TYPE_INIT;
     t->frame_idx = (int)(f - c->fc);
     t->sby = 0;
-    t->recon_progress = t->deblock_progress = 0;
+    t->recon_progress = 0;
     insert_task(f, t, 1);
 }
 
+// queues the tile tasks which were waiting for the tile groups just received,
+// and wakes up the workers to run them; expects ttd->lock to be held
+void dav1d_task_tiles_received(Dav1dFrameContext *const f) {
+    struct TaskThreadData *const ttd = f->task_thread.ttd;
+    const int n_tiles_ready = atomic_load(&f->n_tiles_ready);
+    Dav1dTask **pt = &f->task_thread.data_waiters;
+    while (*pt) {
+        Dav1dTask *const t = *pt;
+        const int tp = t->type == DAV1D_TASK_TYPE_TILE_ENTROPY;
+        if (t - f->task_thread.tile_tasks[tp] < n_tiles_ready) {
+            *pt = t->next;
+            insert_task(f, t, 0);
+        } else {
+            pt = &t->next;
+        }
+    }
+    if (!atomic_fetch_or(&ttd->cond_signaled, 1))
+        dav1d_task_signal(ttd);
+}
+
 void dav1d_task_delayed_fg(Dav1dContext *const c, Dav1dPicture *const out,
                            const Dav1dPicture *const in)
 {
@@ -358,45 +324,74 @@ void dav1d_task_delayed_fg(Dav1dContext *const c, Dav1dPicture *const out,
     pthread_mutex_lock(&ttd->lock);
     ttd->delayed_fg.exec = 1;
     ttd->delayed_fg.finished = 0;
-    pthread_cond_signal(&ttd->cond);
+    dav1d_task_signal(ttd);
     do {
         pthread_cond_wait(&ttd->delayed_fg.cond, &ttd->lock);
     } while (!ttd->delayed_fg.finished);
     pthread_mutex_unlock(&ttd->lock);
 }
 
-static inline int ensure_progress(struct TaskThreadData *const ttd,
-                                  Dav1dFrameContext *const f,
-                                  Dav1dTask *const t, const enum TaskType type,
-                                  atomic_int *const state, int *const target)
+// resolves one of the dependencies of the post-filter task of sbrow sby in
+// pass p (1: entropy, 0: reconstruction), and queues the task if it was the
+// last one; returns whether it was queued
+static inline int resolve_filter_dep(Dav1dFrameContext *const f,
+                                     const int p, const int sby)
 {
-    // deblock_rows (non-LR portion) depends on deblock of previous sbrow,
-    // so ensure that completed. if not, re-add to task-queue; else, fall-through
-    int p1 = atomic_load(state);
-    if (p1 < t->sby) {
-        t->type = type;
-        t->recon_progress = t->deblock_progress = 0;
-        *target = t->sby;
-        add_pending(f, t);
-        pthread_mutex_lock(&ttd->lock);
-        return 1;
-    }
-    return 0;
+    const int idx = f->sbh * p + sby;
+    if (atomic_fetch_sub(&f->task_thread.filter_deps[idx], 1) != 1)
+        return 0;
+    add_pending(f, &f->task_thread.tasks[idx]);
+    return 1;
+}
+
+// continues the post-filter task t with the given type once the preceding
+// sbrow was deblocked, i.e. parks it until release_filter_row() is called for
+// that sbrow if it wasn't yet; returns whether it was parked
+static inline int wait_filter_row(Dav1dFrameContext *const f,
+                                  Dav1dTask *const t, const enum TaskType type)
+{
+    if (!t->sby) return 0;
+    t->type = type;
+    t->recon_progress = 0;
+    return !atomic_exchange(&f->task_thread.filter_row_deps[t->sby], 2);
+}
+
+// lets the post-filter task of the sbrow following sby continue, queueing it
+// again if it was parked by wait_filter_row(); returns whether it was
+static inline int release_filter_row(Dav1dFrameContext *const f, const int sby) {
+    if (sby + 1 >= f->sbh) return 0;
+    if (atomic_exchange(&f->task_thread.filter_row_deps[sby + 1], 1) != 2)
+        return 0;
+    add_pending(f, &f->task_thread.tasks[sby + 1]);
+    return 1;
 }
 
-static inline int check_tile(Dav1dTask *const t, Dav1dFrameContext *const f,
-                             const int frame_mt)
+// what a tile task is waiting for, refer to check_tile()
+enum TileTaskWait {
+    TILE_TASK_READY,
+    TILE_TASK_WAIT_TILE, // progress of its tile in the same pass
+    TILE_TASK_WAIT_DATA, // its tile data, which wasn't received yet
+    TILE_TASK_WAIT_ENTROPY, // entropy decoding of the same tile sbrow
+    TILE_TASK_WAIT_REF, // progress of refp[t->deps_skip], see t->ref_progress
+};
+
+static inline enum TileTaskWait check_tile(Dav1dTask *const t,
+                                           Dav1dFrameContext *const f,
+                                           const int frame_mt)
 {
     const int tp = t->type == DAV1D_TASK_TYPE_TILE_ENTROPY;
     const int tile_idx = (int)(t - f->task_thread.tile_tasks[tp]);
     Dav1dTileState *const ts = &f->ts[tile_idx];
+    // the tile data is only needed by the (first) entropy decoding pass
+    if ((tp || !frame_mt) && tile_idx >= atomic_load(&f->n_tiles_ready))
+        return TILE_TASK_WAIT_DATA;
     const int p1 = atomic_load(&ts->progress[tp]);
-    if (p1 < t->sby) return 1;
+    if (p1 < t->sby) return TILE_TASK_WAIT_TILE;
     int error = p1 == TILE_ERROR;
     error |= atomic_fetch_or(&f->task_thread.error, error);
     if (!error && frame_mt && !tp) {
         const int p2 = atomic_load(&ts->progress[1]);
-        if (p2 <= t->sby) return 1;
+        if (p2 <= t->sby) return TILE_TASK_WAIT_ENTROPY;
         error = p2 == TILE_ERROR;
         error |= atomic_fetch_or(&f->task_thread.error, error);
     }
@@ -425,10 +420,136 @@ static inline int check_tile(Dav1dTask *const t, Dav1dFrameContext *const f,
                 lowest = iclip(max, 1, f->refp[n].p.p.h);
             }
             const unsigned p3 = atomic_load(&f->refp[n].progress[!tp]);
-            if (p3 < lowest) return 1;
+            if (p3 < lowest) {
+                t->ref_progress = lowest;
+                return TILE_TASK_WAIT_REF;
+            }
             atomic_fetch_or(&f->task_thread.error, p3 == FRAME_ERROR);
         }
     }
+    return TILE_TASK_READY;
+}
+
+// returns the frame context decoding the picture referenced by refp[n] of f,
+// or NULL if it isn't in flight anymore; expects ttd->lock to be held
+static Dav1dFrameContext *ref_producer(const Dav1dContext *const c,
+                                       const Dav1dFrameContext *const f,
+                                       const int n)
+{
+    for (unsigned i = 0; i < c->n_fc; i++)
+        if (c->fc[i].sr_cur.progress == f->refp[n].progress)
+            return &c->fc[i];
+    return NULL;
+}
+
+// parks the tile task t, which was removed from the task queue since it waits
+// for its tile data, the entropy decoding of its sbrow or the progress of the
+// frame producing one of its references (producer), until that dependency is
+// resolved and it is queued again; it is thus only checked once per progress
+// update it depends on, rather than on each scan of the task queue. Expects
+// ttd->lock to be held, and returns 0 if the dependency was resolved meanwhile.
+static int park_tile_task(Dav1dFrameContext *const f, Dav1dTask *const t,
+                          const enum TileTaskWait wait,
+                          Dav1dFrameContext *const producer)
+{
+    switch (wait) {
+    case TILE_TASK_WAIT_DATA:
+        // refer to dav1d_task_tiles_received(), called with ttd->lock held
+        t->next = f->task_thread.data_waiters;
+        f->task_thread.data_waiters = t;
+        return 1;
+    case TILE_TASK_WAIT_ENTROPY: {
+        // refer to release_tile_recon()
+        Dav1dTileState *const ts = &f->ts[t - f->task_thread.tile_tasks[0]];
+        atomic_store(&ts->recon_waiting, 1);
+        if (atomic_load(&ts->progress[1]) <= t->sby) return 1;
+        // take the task back, unless the entropy decoding queued it already
+        return !atomic_exchange(&ts->recon_waiting, 0);
+    }
+    case TILE_TASK_WAIT_REF: {
+        // refer to take_ref_waiters()
+        const int tp = t->type == DAV1D_TASK_TYPE_TILE_ENTROPY;
+        int parked = 0;
+        pthread_mutex_lock(&producer->task_thread.lock);
+        if (atomic_load(&f->refp[t->deps_skip].progress[!tp]) < t->ref_progress) {
+            t->next = producer->task_thread.ref_waiters;
+            producer->task_thread.ref_waiters = t;
+            parked = 1;
+        }
+        pthread_mutex_unlock(&producer->task_thread.lock);
+        return parked;
+    }
+    default: abort();
+    }
+}
+
+// queues the reconstruction task of the tile again if it was parked waiting
+// for the entropy decoding progress just signaled; returns whether it was
+static inline int release_tile_recon(Dav1dFrameContext *const f,
+                                     Dav1dTileState *const ts)
+{
+    if (!atomic_exchange(&ts->recon_waiting, 0)) return 0;
+    add_pending(f, &f->task_thread.tile_tasks[0][ts - f->ts]);
+    return 1;
+}
+
+// removes the tile tasks whose reference progress was reached from the
+// waiters of their producer f, and returns them as a list to be queued again
+// with queue_ref_waiters(); expects f->task_thread.lock to be held
+static Dav1dTask *take_ref_waiters(Dav1dFrameContext *const f) {
+    Dav1dTask *ready = NULL, **pt = &f->task_thread.ref_waiters;
+    while (*pt) {
+        Dav1dTask *const t = *pt;
+        const Dav1dFrameContext *const wf = &f->c->fc[t->frame_idx];
+        const int tp = t->type == DAV1D_TASK_TYPE_TILE_ENTROPY;
+        if (atomic_load(&wf->refp[t->deps_skip].progress[!tp]) >= t->ref_progress) {
+            *pt = t->next;
+            t->next = ready;
+            ready = t;
+        } else {
+            pt = &t->next;
+        }
+    }
+    return ready;
+}
+
+// returns whether there were any tasks to queue
+static int queue_ref_waiters(const Dav1dContext *const c, Dav1dTask *t) {
+    const int res = !!t;
+    while (t) {
+        Dav1dTask *const next = t->next;
+        add_pending(&c->fc[t->frame_idx], t);
+        t = next;
+    }
+    return res;
+}
+
+// queues the tile tasks which were waiting for the progress of f just
+// signaled again; returns whether there were any
+static int release_ref_waiters(Dav1dFrameContext *const f) {
+    pthread_mutex_lock(&f->task_thread.lock);
+    Dav1dTask *const ready = take_ref_waiters(f);
+    pthread_mutex_unlock(&f->task_thread.lock);
+    return queue_ref_waiters(f->c, ready);
+}
+
+// checks whether another worker could find something to run, so that we
+// don't wake up threads which would just contend for the lock and go back
+// to sleep; tile tasks found blocked are parked off the queues (refer to
+// park_tile_task()), so queued tasks are not known to be blocked; expects
+// ttd->lock to be held
+static inline int has_queued_tasks(const Dav1dContext *const c,
+                                   const struct TaskThreadData *const ttd)
+{
+    if (ttd->delayed_fg.exec) return 1;
+    for (unsigned i = 0; i < c->n_fc; i++) {
+        const Dav1dFrameContext *const f = &c->fc[i];
+        if (f->task_thread.task_head ||
+            atomic_load(&f->task_thread.pending_tasks.merge))
+        {
+            return 1;
+        }
+    }
     return 0;
 }
 
@@ -450,6 +571,16 @@ static inline int get_frame_progress(const Dav1dContext *const c,
     return ((idx << 5) | prog) - 1;
 }
 
+// wake up the threads waiting for this frame, and notify the user if it is
+// the oldest frame in flight, i.e. its picture is the next one to be output
+static inline void frame_done(Dav1dFrameContext *const f) {
+    const Dav1dContext *const c = f->c;
+    f->n_tile_data = 0;
+    pthread_cond_signal(&f->task_thread.cond);
+    if (c->frame_thread.n_busy && f == &c->fc[c->frame_thread.next])
+        dav1d_picture_ready_notify(c);
+}
+
 static inline void abort_frame(Dav1dFrameContext *const f, const int error) {
     atomic_store(&f->task_thread.error, error == DAV1D_ERR(EINVAL) ? 1 : -1);
     atomic_store(&f->task_thread.task_counter, 0);
@@ -457,12 +588,13 @@ static inline void abort_frame(Dav1dFrameContext *const f, const int error) {
     atomic_store(&f->task_thread.done[1], 1);
     atomic_store(&f->sr_cur.progress[0], FRAME_ERROR);
     atomic_store(&f->sr_cur.progress[1], FRAME_ERROR);
+    release_ref_waiters(f);
     dav1d_decode_frame_exit(f, error);
-    f->n_tile_data = 0;
-    pthread_cond_signal(&f->task_thread.cond);
+    frame_done(f);
 }
 
-static inline void delayed_fg_task(const Dav1dContext *const c,
+static inline void delayed_fg_task(Dav1dTaskContext *const tc,
+                                   const Dav1dContext *const c,
                                    struct TaskThreadData *const ttd)
 {
     const Dav1dPicture *const in = ttd->delayed_fg.in;
@@ -476,7 +608,7 @@ static inline void delayed_fg_task(const Dav1dContext *const c,
     case DAV1D_TASK_TYPE_FG_PREP:
         ttd->delayed_fg.exec = 0;
         if (atomic_load(&ttd->cond_signaled))
-            pthread_cond_signal(&ttd->cond);
+            dav1d_task_signal(ttd);
         pthread_mutex_unlock(&ttd->lock);
         switch (out->p.bpc) {
 #if CONFIG_8BPC
@@ -497,8 +629,11 @@ static inline void delayed_fg_task(const Dav1dContext *const c,
         default: abort();
         }
         ttd->delayed_fg.type = DAV1D_TASK_TYPE_FG_APPLY;
+        dav1d_trace_task_end(tc);
         pthread_mutex_lock(&ttd->lock);
         ttd->delayed_fg.exec = 1;
+        dav1d_trace_task_begin(tc, DAV1D_TASK_TYPE_FG_APPLY, UINT_MAX, -1,
+                               out->m.timestamp);
         // fall-through
     case DAV1D_TASK_TYPE_FG_APPLY:;
         int row = atomic_fetch_add(&ttd->delayed_fg.progress[0], 1);
@@ -506,7 +641,7 @@ static inline void delayed_fg_task(const Dav1dContext *const c,
         int progmax = (out->p.h + FG_BLOCK_SIZE - 1) / FG_BLOCK_SIZE;
         while (row < progmax) {
             if (row + 1 < progmax)
-                pthread_cond_signal(&ttd->cond);
+                dav1d_task_signal(ttd);
             else {
                 pthread_mutex_lock(&ttd->lock);
                 ttd->delayed_fg.exec = 0;
@@ -533,6 +668,7 @@ static inline void delayed_fg_task(const Dav1dContext *const c,
             row = atomic_fetch_add(&ttd->delayed_fg.progress[0], 1);
             atomic_fetch_add(&ttd->delayed_fg.progress[1], 1);
         }
+        dav1d_trace_task_end(tc);
         pthread_mutex_lock(&ttd->lock);
         ttd->delayed_fg.exec = 0;
         int done = atomic_fetch_add(&ttd->delayed_fg.progress[1], 1) + 1;
@@ -547,29 +683,40 @@ static inline void delayed_fg_task(const Dav1dContext *const c,
     }
 }
 
-void *dav1d_worker_task(void *data) {
-    Dav1dTaskContext *const tc = data;
+// maximum number of tasks a pool worker runs for one context before moving
+// on to the next one, so that a single busy stream can't starve the others
+#define POOL_TASK_QUANTUM 16
+
+// runs tasks of tc's context, expects ttd->lock to be held; returns the
+// number of tasks executed
+static int run_tasks(Dav1dTaskContext *const tc) {
     const Dav1dContext *const c = tc->c;
     struct TaskThreadData *const ttd = tc->task_thread.ttd;
+    int n_run = 0;
 
-    dav1d_set_thread_name("dav1d-worker");
-
-    pthread_mutex_lock(&ttd->lock);
     for (;;) {
         if (tc->task_thread.die) break;
         if (atomic_load(c->flush)) goto park;
+        if (ttd->pool && n_run >= POOL_TASK_QUANTUM) break;
 
         merge_pending(c);
         if (ttd->delayed_fg.exec) { // run delayed film grain first
-            delayed_fg_task(c, ttd);
+            dav1d_trace_task_begin(tc, ttd->delayed_fg.type, UINT_MAX, -1,
+                                   ttd->delayed_fg.out->m.timestamp);
+            delayed_fg_task(tc, c, ttd);
             continue;
         }
         Dav1dFrameContext *f;
         Dav1dTask *t, *prev_t = NULL;
         if (c->n_fc > 1) { // run init tasks second
-            for (unsigned i = 0; i < c->n_fc; i++) {
+            // pinned workers look at frames whose memory is local to them
+            // first, since initialization is when most of it is touched
+            const int node = tc->task_thread.node;
+            for (unsigned i = 0; i < c->n_fc * (1 + (node >= 0)); i++) {
                 const unsigned first = atomic_load(&ttd->first);
                 f = &c->fc[(first + i) % c->n_fc];
+                if (node >= 0 && i < c->n_fc && f->task_thread.node != node)
+                    continue;
                 if (atomic_load(&f->task_thread.init_done)) continue;
                 t = f->task_thread.task_head;
                 if (!t) continue;
@@ -591,12 +738,12 @@ void *dav1d_worker_task(void *data) {
                 }
             }
         }
-        while (ttd->cur < c->n_fc) { // run decoding tasks last
-            const unsigned first = atomic_load(&ttd->first);
-            f = &c->fc[(first + ttd->cur) % c->n_fc];
+        const unsigned first = atomic_load(&ttd->first);
+        for (unsigned i = 0; i < c->n_fc; i++) { // run decoding tasks last
+            f = &c->fc[(first + i) % c->n_fc];
             merge_pending_frame(f);
-            prev_t = f->task_thread.task_cur_prev;
-            t = prev_t ? prev_t->next : f->task_thread.task_head;
+            prev_t = NULL;
+            t = f->task_thread.task_head;
             while (t) {
                 if (t->type == DAV1D_TASK_TYPE_INIT_CDF) goto next;
                 else if (t->type == DAV1D_TASK_TYPE_TILE_ENTROPY ||
@@ -604,69 +751,58 @@ void *dav1d_worker_task(void *data) {
                 {
                     // if not bottom sbrow of tile, this task will be re-added
                     // after it's finished
-                    if (!check_tile(t, f, c->n_fc > 1))
-                        goto found;
-                } else if (t->recon_progress) {
-                    const int p = t->type == DAV1D_TASK_TYPE_ENTROPY_PROGRESS;
-                    int error = atomic_load(&f->task_thread.error);
-                    assert(!atomic_load(&f->task_thread.done[p]) || error);
-                    const int tile_row_base = f->frame_hdr->tiling.cols *
-                                              f->frame_thread.next_tile_row[p];
-                    if (p) {
-                        atomic_int *const prog = &f->frame_thread.entropy_progress;
-                        const int p1 = atomic_load(prog);
-                        if (p1 < t->sby) goto next;
-                        atomic_fetch_or(&f->task_thread.error, p1 == TILE_ERROR);
-                    }
-                    for (int tc = 0; tc < f->frame_hdr->tiling.cols; tc++) {
-                        Dav1dTileState *const ts = &f->ts[tile_row_base + tc];
-                        const int p2 = atomic_load(&ts->progress[p]);
-                        if (p2 < t->recon_progress) goto next;
-                        atomic_fetch_or(&f->task_thread.error, p2 == TILE_ERROR);
+                    const enum TileTaskWait wait = check_tile(t, f, c->n_fc > 1);
+                    if (!wait) goto found;
+                    Dav1dFrameContext *const producer =
+                        wait == TILE_TASK_WAIT_REF ? ref_producer(c, f, t->deps_skip) : NULL;
+                    if (wait == TILE_TASK_WAIT_TILE ||
+                        (wait == TILE_TASK_WAIT_REF && !producer))
+                    {
+                        goto next;
                     }
-                    if (t->sby + 1 < f->sbh) {
-                        // add sby+1 to list to replace this one
-                        Dav1dTask *next_t = &t[1];
-                        *next_t = *t;
-                        next_t->sby++;
-                        const int ntr = f->frame_thread.next_tile_row[p] + 1;
-                        const int start = f->frame_hdr->tiling.row_start_sb[ntr];
-                        if (next_t->sby == start)
-                            f->frame_thread.next_tile_row[p] = ntr;
-                        next_t->recon_progress = next_t->sby + 1;
-                        insert_task(f, next_t, 0);
+                    // take it out of the queue until it can run
+                    Dav1dTask *const next_t = t->next;
+                    if (prev_t) prev_t->next = next_t;
+                    else f->task_thread.task_head = next_t;
+                    if (!next_t) f->task_thread.task_tail = prev_t;
+                    if (!park_tile_task(f, t, wait, producer)) {
+                        t->next = NULL;
+                        if (!check_tile(t, f, c->n_fc > 1)) goto found_unlinked;
+                        add_pending(f, t);
                     }
-                    goto found;
-                } else if (t->type == DAV1D_TASK_TYPE_CDEF) {
-                    atomic_uint *prog = f->frame_thread.copy_lpf_progress;
-                    const int p1 = atomic_load(&prog[(t->sby - 1) >> 5]);
-                    if (p1 & (1U << ((t->sby - 1) & 31)))
-                        goto found;
+                    t = next_t;
+                    continue;
                 } else {
-                    assert(t->deblock_progress);
-                    const int p1 = atomic_load(&f->frame_thread.deblock_progress);
-                    if (p1 >= t->deblock_progress) {
-                        atomic_fetch_or(&f->task_thread.error, p1 == TILE_ERROR);
-                        goto found;
+                    // post-filter tasks are only queued once they can run;
+                    // starting one lets the next sbrow's task be queued,
+                    // while entropy progress is signaled in order
+                    if (t->recon_progress &&
+                        t->type != DAV1D_TASK_TYPE_ENTROPY_PROGRESS &&
+                        t->sby + 1 < f->sbh)
+                    {
+                        resolve_filter_dep(f, 0, t->sby + 1);
                     }
+                    goto found;
                 }
             next:
                 prev_t = t;
                 t = t->next;
-                f->task_thread.task_cur_prev = prev_t;
             }
-            ttd->cur++;
         }
-        if (reset_task_cur(c, ttd, UINT_MAX)) continue;
         if (merge_pending(c)) continue;
     park:
+        if (ttd->pool) {
+            // return the worker to the pool, which will be signaled
+            // next time progress is made
+            atomic_store(&ttd->cond_signaled, 0);
+            break;
+        }
         tc->task_thread.flushed = 1;
         pthread_cond_signal(&tc->task_thread.td.cond);
         // we want to be woken up next time progress is signaled
         atomic_store(&ttd->cond_signaled, 0);
         pthread_cond_wait(&ttd->cond, &ttd->lock);
         tc->task_thread.flushed = 0;
-        reset_task_cur(c, ttd, UINT_MAX);
         continue;
 
     found:
@@ -674,16 +810,23 @@ void *dav1d_worker_task(void *data) {
         if (prev_t) prev_t->next = t->next;
         else f->task_thread.task_head = t->next;
         if (!t->next) f->task_thread.task_tail = prev_t;
-        if (t->type > DAV1D_TASK_TYPE_INIT_CDF && !f->task_thread.task_head)
-            ttd->cur++;
         t->next = NULL;
-        // we don't need to check cond_signaled here, since we found a task
-        // after the last signal so we want to re-signal the next waiting thread
-        // and again won't need to signal after that
-        atomic_store(&ttd->cond_signaled, 1);
-        pthread_cond_signal(&ttd->cond);
+    found_unlinked:
+        // let the next progress update wake up a thread, unless there is
+        // a task to pick up already; clearing cond_signaled before the check
+        // ensures that progress made meanwhile is either seen by it or
+        // signaled
+        atomic_store(&ttd->cond_signaled, 0);
+        if (has_queued_tasks(c, ttd)) {
+            atomic_store(&ttd->cond_signaled, 1);
+            dav1d_task_signal(ttd);
+        }
         pthread_mutex_unlock(&ttd->lock);
     found_unlocked:;
+        n_run++;
+        dav1d_trace_task_end(tc);
+        dav1d_trace_task_begin(tc, t->type, t->frame_idx, t->sby,
+                               f->sr_cur.p.m.timestamp);
         const int flush = atomic_load(c->flush);
         int error = atomic_fetch_or(&f->task_thread.error, flush) | flush;
 
@@ -696,13 +839,14 @@ void *dav1d_worker_task(void *data) {
             int res = dav1d_decode_frame_init(f);
             int p1 = f->in_cdf.progress ? atomic_load(f->in_cdf.progress) : 1;
             if (res || p1 == TILE_ERROR) {
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
                 abort_frame(f, res ? res : DAV1D_ERR(EINVAL));
-                reset_task_cur(c, ttd, t->frame_idx);
             } else {
                 t->type = DAV1D_TASK_TYPE_INIT_CDF;
                 if (p1) goto found_unlocked;
                 add_pending(f, t);
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
             }
             continue;
@@ -720,6 +864,7 @@ void *dav1d_worker_task(void *data) {
                 for (int p = 1; p <= 2; p++) {
                     const int res = dav1d_task_create_tile_sbrow(f, p, 0);
                     if (res) {
+                        dav1d_trace_task_end(tc);
                         pthread_mutex_lock(&ttd->lock);
                         // memory allocation failed
                         atomic_store(&f->task_thread.done[2 - p], 1);
@@ -728,21 +873,22 @@ void *dav1d_worker_task(void *data) {
                                          f->frame_hdr->tiling.cols *
                                          f->frame_hdr->tiling.rows + f->sbh);
                         atomic_store(&f->sr_cur.progress[p - 1], FRAME_ERROR);
+                        release_ref_waiters(f);
                         if (p == 2 && atomic_load(&f->task_thread.done[1])) {
                             assert(!atomic_load(&f->task_thread.task_counter));
                             dav1d_decode_frame_exit(f, DAV1D_ERR(ENOMEM));
-                            f->n_tile_data = 0;
-                            pthread_cond_signal(&f->task_thread.cond);
+                            frame_done(f);
                         } else {
                             pthread_mutex_unlock(&ttd->lock);
                         }
                     }
                 }
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
             } else {
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
                 abort_frame(f, res);
-                reset_task_cur(c, ttd, t->frame_idx);
                 atomic_store(&f->task_thread.init_done, 1);
             }
             continue;
@@ -766,20 +912,32 @@ void *dav1d_worker_task(void *data) {
             if (((sby + 1) << f->sb_shift) < ts->tiling.row_end) {
                 t->sby++;
                 t->deps_skip = 0;
-                if (!check_tile(t, f, uses_2pass)) {
+                if (!(ttd->pool && n_run >= POOL_TASK_QUANTUM) &&
+                    !check_tile(t, f, uses_2pass))
+                {
                     atomic_store(&ts->progress[p], progress);
-                    reset_task_cur_async(ttd, t->frame_idx, c->n_fc);
-                    if (!atomic_fetch_or(&ttd->cond_signaled, 1))
-                        pthread_cond_signal(&ttd->cond);
+                    // only wake up another worker if there is something new
+                    // to run: the post-filter task of the sbrow, or the
+                    // reconstruction of the tile waiting for its entropy
+                    // decoding
+                    int queued = resolve_filter_dep(f, p, sby);
+                    if (p) queued |= release_tile_recon(f, ts);
+                    if (queued && !atomic_fetch_or(&ttd->cond_signaled, 1))
+                        dav1d_task_signal(ttd);
                     goto found_unlocked;
                 }
                 atomic_store(&ts->progress[p], progress);
+                resolve_filter_dep(f, p, sby);
+                if (p) release_tile_recon(f, ts);
                 add_pending(f, t);
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
             } else {
+                dav1d_trace_task_end(tc);
                 pthread_mutex_lock(&ttd->lock);
                 atomic_store(&ts->progress[p], progress);
-                reset_task_cur(c, ttd, t->frame_idx);
+                resolve_filter_dep(f, p, sby);
+                if (p) release_tile_recon(f, ts);
                 error = atomic_load(&f->task_thread.error);
                 if (f->frame_hdr->refresh_context &&
                     tc->frame_thread.pass <= 1 && f->task_thread.update_set &&
@@ -798,69 +956,64 @@ void *dav1d_worker_task(void *data) {
                     error = atomic_load(&f->task_thread.error);
                     dav1d_decode_frame_exit(f, error == 1 ? DAV1D_ERR(EINVAL) :
                                             error ? DAV1D_ERR(ENOMEM) : 0);
-                    f->n_tile_data = 0;
-                    pthread_cond_signal(&f->task_thread.cond);
+                    frame_done(f);
                 }
                 assert(atomic_load(&f->task_thread.task_counter) >= 0);
                 if (!atomic_fetch_or(&ttd->cond_signaled, 1))
-                    pthread_cond_signal(&ttd->cond);
+                    dav1d_task_signal(ttd);
             }
             continue;
         }
         case DAV1D_TASK_TYPE_DEBLOCK_COLS:
             if (!atomic_load(&f->task_thread.error))
                 f->bd_fn.filter_sbrow_deblock_cols(f, sby);
-            if (ensure_progress(ttd, f, t, DAV1D_TASK_TYPE_DEBLOCK_ROWS,
-                                &f->frame_thread.deblock_progress,
-                                &t->deblock_progress)) continue;
+            // deblock_rows (non-LR portion) depends on deblock of previous sbrow
+            if (wait_filter_row(f, t, DAV1D_TASK_TYPE_DEBLOCK_ROWS)) {
+                dav1d_trace_task_end(tc);
+                pthread_mutex_lock(&ttd->lock);
+                continue;
+            }
             // fall-through
         case DAV1D_TASK_TYPE_DEBLOCK_ROWS:
+            dav1d_trace_task_next(tc, DAV1D_TASK_TYPE_DEBLOCK_ROWS);
             if (!atomic_load(&f->task_thread.error))
                 f->bd_fn.filter_sbrow_deblock_rows(f, sby);
-            // signal deblock progress
-            if (f->frame_hdr->loopfilter.level_y[0] ||
-                f->frame_hdr->loopfilter.level_y[1])
+            // signal deblock progress (or the LR backup of this sbrow)
+            if (release_filter_row(f, sby) &&
+                !atomic_fetch_or(&ttd->cond_signaled, 1))
             {
-                error = atomic_load(&f->task_thread.error);
-                atomic_store(&f->frame_thread.deblock_progress,
-                             error ? TILE_ERROR : sby + 1);
-                reset_task_cur_async(ttd, t->frame_idx, c->n_fc);
-                if (!atomic_fetch_or(&ttd->cond_signaled, 1))
-                    pthread_cond_signal(&ttd->cond);
-            } else if (f->seq_hdr->cdef || f->lf.restore_planes) {
-                atomic_fetch_or(&f->frame_thread.copy_lpf_progress[sby >> 5],
-                                1U << (sby & 31));
-                // CDEF needs the top buffer to be saved by lr_copy_lpf of the
-                // previous sbrow
-                if (sby) {
-                    int prog = atomic_load(&f->frame_thread.copy_lpf_progress[(sby - 1) >> 5]);
-                    if (~prog & (1U << ((sby - 1) & 31))) {
-                        t->type = DAV1D_TASK_TYPE_CDEF;
-                        t->recon_progress = t->deblock_progress = 0;
-                        add_pending(f, t);
-                        pthread_mutex_lock(&ttd->lock);
-                        continue;
-                    }
-                }
+                dav1d_task_signal(ttd);
+            }
+            // without deblocking, CDEF needs the top buffer to be saved by
+            // lr_copy_lpf of the previous sbrow
+            if (!f->frame_hdr->loopfilter.level_y[0] &&
+                !f->frame_hdr->loopfilter.level_y[1] &&
+                wait_filter_row(f, t, DAV1D_TASK_TYPE_CDEF))
+            {
+                dav1d_trace_task_end(tc);
+                pthread_mutex_lock(&ttd->lock);
+                continue;
             }
             // fall-through
         case DAV1D_TASK_TYPE_CDEF:
             if (f->seq_hdr->cdef) {
+                dav1d_trace_task_next(tc, DAV1D_TASK_TYPE_CDEF);
                 if (!atomic_load(&f->task_thread.error))
                     f->bd_fn.filter_sbrow_cdef(tc, sby);
-                reset_task_cur_async(ttd, t->frame_idx, c->n_fc);
-                if (!atomic_fetch_or(&ttd->cond_signaled, 1))
-                    pthread_cond_signal(&ttd->cond);
             }
             // fall-through
         case DAV1D_TASK_TYPE_SUPER_RESOLUTION:
-            if (f->frame_hdr->width[0] != f->frame_hdr->width[1])
+            if (f->frame_hdr->width[0] != f->frame_hdr->width[1]) {
+                dav1d_trace_task_next(tc, DAV1D_TASK_TYPE_SUPER_RESOLUTION);
                 if (!atomic_load(&f->task_thread.error))
                     f->bd_fn.filter_sbrow_resize(f, sby);
+            }
             // fall-through
         case DAV1D_TASK_TYPE_LOOP_RESTORATION:
-            if (!atomic_load(&f->task_thread.error) && f->lf.restore_planes)
+            if (!atomic_load(&f->task_thread.error) && f->lf.restore_planes) {
+                dav1d_trace_task_next(tc, DAV1D_TASK_TYPE_LOOP_RESTORATION);
                 f->bd_fn.filter_sbrow_lr(f, sby);
+            }
             // fall-through
         case DAV1D_TASK_TYPE_RECONSTRUCTION_PROGRESS:
             // dummy to cover for no post-filters
@@ -877,28 +1030,26 @@ void *dav1d_worker_task(void *data) {
             error = atomic_load(&f->task_thread.error);
             const unsigned y = sby + 1 == sbh ? UINT_MAX : (unsigned)(sby + 1) * sbsz;
             assert(c->n_fc > 1);
-            if (f->sr_cur.p.data[0] /* upon flush, this can be free'ed already */)
+            if (f->sr_cur.p.data[0] /* upon flush, this can be free'ed already */) {
                 atomic_store(&f->sr_cur.progress[0], error ? FRAME_ERROR : y);
-            atomic_store(&f->frame_thread.entropy_progress,
-                         error ? TILE_ERROR : sby + 1);
+                release_ref_waiters(f);
+            }
+            if (sby + 1 < sbh)
+                resolve_filter_dep(f, 1, sby + 1);
             if (sby + 1 == sbh)
                 atomic_store(&f->task_thread.done[1], 1);
+            dav1d_trace_task_end(tc);
             pthread_mutex_lock(&ttd->lock);
             const int num_tasks = atomic_fetch_sub(&f->task_thread.task_counter, 1) - 1;
-            if (sby + 1 < sbh && num_tasks) {
-                reset_task_cur(c, ttd, t->frame_idx);
-                continue;
-            }
+            if (sby + 1 < sbh && num_tasks) continue;
             if (!num_tasks && atomic_load(&f->task_thread.done[0]) &&
                 atomic_load(&f->task_thread.done[1]))
             {
                 error = atomic_load(&f->task_thread.error);
                 dav1d_decode_frame_exit(f, error == 1 ? DAV1D_ERR(EINVAL) :
                                         error ? DAV1D_ERR(ENOMEM) : 0);
-                f->n_tile_data = 0;
-                pthread_cond_signal(&f->task_thread.cond);
+                frame_done(f);
             }
-            reset_task_cur(c, ttd, t->frame_idx);
             continue;
         }
     // t->type != DAV1D_TASK_TYPE_ENTROPY_PROGRESS
@@ -908,29 +1059,191 @@ void *dav1d_worker_task(void *data) {
         sby = get_frame_progress(c, f);
         error = atomic_load(&f->task_thread.error);
         const unsigned y = sby + 1 == sbh ? UINT_MAX : (unsigned)(sby + 1) * sbsz;
-        if (c->n_fc > 1 && f->sr_cur.p.data[0] /* upon flush, this can be free'ed already */)
+        Dav1dTask *ready = NULL;
+        if (c->n_fc > 1 && f->sr_cur.p.data[0] /* upon flush, this can be free'ed already */) {
             atomic_store(&f->sr_cur.progress[1], error ? FRAME_ERROR : y);
+            ready = take_ref_waiters(f);
+        }
+        // claim the sbrows which became final for downscaling them, so that
+        // it happens while they are still in cache
+        const int downscale_start = f->task_thread.downscale_sby;
+        if (sby + 1 > downscale_start)
+            f->task_thread.downscale_sby = sby + 1;
         pthread_mutex_unlock(&f->task_thread.lock);
+        queue_ref_waiters(c, ready);
+        if (c->output_downscale && sby + 1 > downscale_start && !error &&
+            f->sr_cur.p.data[0])
+        {
+            f->bd_fn.downscale_sbrows(f, downscale_start, sby + 1);
+        }
         if (sby + 1 == sbh)
             atomic_store(&f->task_thread.done[0], 1);
+        dav1d_trace_task_end(tc);
         pthread_mutex_lock(&ttd->lock);
         const int num_tasks = atomic_fetch_sub(&f->task_thread.task_counter, 1) - 1;
-        if (sby + 1 < sbh && num_tasks) {
-            reset_task_cur(c, ttd, t->frame_idx);
-            continue;
-        }
+        if (sby + 1 < sbh && num_tasks) continue;
         if (!num_tasks && atomic_load(&f->task_thread.done[0]) &&
             (!uses_2pass || atomic_load(&f->task_thread.done[1])))
         {
             error = atomic_load(&f->task_thread.error);
             dav1d_decode_frame_exit(f, error == 1 ? DAV1D_ERR(EINVAL) :
                                     error ? DAV1D_ERR(ENOMEM) : 0);
-            f->n_tile_data = 0;
-            pthread_cond_signal(&f->task_thread.cond);
+            frame_done(f);
         }
-        reset_task_cur(c, ttd, t->frame_idx);
     }
+
+    return n_run;
+}
+
+void dav1d_picture_ready_notify(const Dav1dContext *const c) {
+    if (c->picture_notifier.callback)
+        c->picture_notifier.callback(c->picture_notifier.cookie);
+#ifdef HAVE_EVENTFD
+    if (c->picture_fd >= 0) {
+        const uint64_t one = 1;
+        // this only fails if the counter would overflow, in which case the
+        // descriptor is readable already
+        while (write(c->picture_fd, &one, sizeof(one)) < 0 && errno == EINTR) ;
+    }
+#endif
+}
+
+static void set_thread_priority(const enum Dav1dThreadPriority prio) {
+    if (prio == DAV1D_THREADPRIORITY_DEFAULT) return;
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), prio == DAV1D_THREADPRIORITY_IDLE ?
+                      THREAD_PRIORITY_IDLE : THREAD_PRIORITY_BELOW_NORMAL);
+#elif defined(__linux__)
+    // on Linux, these only apply to the calling thread
+    if (prio == DAV1D_THREADPRIORITY_IDLE) {
+        const struct sched_param param = { 0 };
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    } else {
+        errno = 0;
+        const int nice = getpriority(PRIO_PROCESS, 0);
+        if (!errno) setpriority(PRIO_PROCESS, 0, imin(nice + 10, 19));
+    }
+#endif
+}
+
+void *dav1d_worker_task(void *data) {
+    Dav1dTaskContext *const tc = data;
+    struct TaskThreadData *const ttd = tc->task_thread.ttd;
+
+    dav1d_set_thread_name("dav1d-worker");
+    set_thread_priority(tc->c->thread_priority);
+#ifdef __linux__
+    atomic_store(&tc->task_thread.os_tid, (int) syscall(SYS_gettid));
+#endif
+
+    pthread_mutex_lock(&ttd->lock);
+    run_tasks(tc);
     pthread_mutex_unlock(&ttd->lock);
 
     return NULL;
 }
+
+// claims an idle task context of the next attached decoder in round-robin
+// order, expects pool->lock to be held
+static Dav1dTaskContext *pool_claim_tc(Dav1dThreadPool *const pool) {
+    for (int n = 0; n < pool->n_ctx; n++) {
+        if (pool->next_ctx >= pool->n_ctx) pool->next_ctx = 0;
+        Dav1dContext *const c = pool->ctx[pool->next_ctx++];
+        for (unsigned i = 0; i < c->n_tc; i++) {
+            Dav1dTaskContext *const tc = &c->tc[i];
+            if (tc->task_thread.claimed) continue;
+            tc->task_thread.claimed = 1;
+            c->task_thread.pool_active++;
+            return tc;
+        }
+    }
+    return NULL;
+}
+
+// runs tasks of each attached decoder with an idle task context on the
+// calling thread, expects pool->lock to be held; returns the number of tasks
+// executed
+static int pool_run_tasks(Dav1dThreadPool *const pool) {
+    int n_run = 0;
+    for (int n = pool->n_ctx; n > 0 && !pool->die; n--) {
+        Dav1dTaskContext *const tc = pool_claim_tc(pool);
+        if (!tc) break;
+        pthread_mutex_unlock(&pool->lock);
+
+        struct TaskThreadData *const ttd = tc->task_thread.ttd;
+        pthread_mutex_lock(&ttd->lock);
+        tc->task_thread.flushed = 0;
+        n_run += run_tasks(tc);
+        tc->task_thread.flushed = 1;
+        pthread_cond_signal(&tc->task_thread.td.cond);
+        pthread_mutex_unlock(&ttd->lock);
+
+        pthread_mutex_lock(&pool->lock);
+        tc->task_thread.claimed = 0;
+        if (!--ttd->pool_active)
+            pthread_cond_broadcast(&pool->idle_cond);
+    }
+    return n_run;
+}
+
+void *dav1d_pool_worker_task(void *data) {
+    Dav1dThreadPool *const pool = data;
+
+    dav1d_set_thread_name("dav1d-worker");
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->die) {
+        const unsigned signal_cnt = pool->signal_cnt;
+        const int n_run = pool_run_tasks(pool);
+        // sleep only if no task was found and no new work was signaled
+        // while we were scanning
+        if (!n_run && signal_cnt == pool->signal_cnt && !pool->die)
+            pthread_cond_wait(&pool->cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+int dav1d_pool_run_tasks(Dav1dThreadPool *const pool) {
+    pthread_mutex_lock(&pool->lock);
+    const int n_run = pool_run_tasks(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    return n_run;
+}
+
+int dav1d_thread_pool_attach(Dav1dThreadPool *const pool, Dav1dContext *const c) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->n_ctx == pool->n_ctx_alloc) {
+        const int n_alloc = pool->n_ctx_alloc ? pool->n_ctx_alloc * 2 : 4;
+        Dav1dContext **const ctx =
+            dav1d_malloc(ALLOC_THREAD_CTX, n_alloc * sizeof(*pool->ctx));
+        if (!ctx) {
+            pthread_mutex_unlock(&pool->lock);
+            return DAV1D_ERR(ENOMEM);
+        }
+        if (pool->n_ctx)
+            memcpy(ctx, pool->ctx, pool->n_ctx * sizeof(*pool->ctx));
+        dav1d_free(pool->ctx);
+        pool->ctx = ctx;
+        pool->n_ctx_alloc = n_alloc;
+    }
+    pool->ctx[pool->n_ctx++] = c;
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void dav1d_thread_pool_detach(Dav1dThreadPool *const pool, Dav1dContext *const c) {
+    pthread_mutex_lock(&pool->lock);
+    for (int n = 0; n < pool->n_ctx; n++) {
+        if (pool->ctx[n] != c) continue;
+        pool->ctx[n] = pool->ctx[--pool->n_ctx];
+        if (pool->next_ctx > n) pool->next_ctx--;
+        break;
+    }
+    // wait for workers still running tasks of this context
+    while (c->task_thread.pool_active)
+        pthread_cond_wait(&pool->idle_cond, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
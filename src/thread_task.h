@@ -38,16 +38,44 @@
 // these functions assume the task scheduling lock is already taken
 int dav1d_task_create_tile_sbrow(Dav1dFrameContext *f, int pass, int cond_signal);
 void dav1d_task_frame_init(Dav1dFrameContext *f);
+void dav1d_task_tiles_received(Dav1dFrameContext *f);
 
 void dav1d_task_delayed_fg(Dav1dContext *c, Dav1dPicture *out, const Dav1dPicture *in);
 
 void *dav1d_worker_task(void *data);
+void *dav1d_pool_worker_task(void *data);
+int dav1d_pool_run_tasks(Dav1dThreadPool *pool);
 
+int dav1d_thread_pool_attach(Dav1dThreadPool *pool, Dav1dContext *c);
+void dav1d_thread_pool_detach(Dav1dThreadPool *pool, Dav1dContext *c);
+
+// wake up a worker to look for new tasks of this context
+static inline void dav1d_task_signal(struct TaskThreadData *const ttd) {
+    Dav1dThreadPool *const pool = ttd->pool;
+    if (pool) {
+        pthread_mutex_lock(&pool->lock);
+        pool->signal_cnt++;
+        pthread_cond_signal(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+        if (pool->executor.task_available)
+            pool->executor.task_available(pool->executor.cookie);
+    } else {
+        pthread_cond_signal(&ttd->cond);
+    }
+}
+
+// notify the user that a picture can be retrieved with dav1d_get_picture()
+void dav1d_picture_ready_notify(const Dav1dContext *c);
+
+int dav1d_decode_frame_prepare(Dav1dFrameContext *f, const Dav1dSequenceHeader *seq_hdr,
+                               const ptrdiff_t stride[2]);
 int dav1d_decode_frame_init(Dav1dFrameContext *f);
 int dav1d_decode_frame_init_cdf(Dav1dFrameContext *f);
 int dav1d_decode_frame_main(Dav1dFrameContext *f);
 void dav1d_decode_frame_exit(Dav1dFrameContext *f, int retval);
-int dav1d_decode_frame(Dav1dFrameContext *f);
+void dav1d_decode_frame_trim(Dav1dContext *c, Dav1dFrameContext *f);
+void dav1d_decode_frame_free(Dav1dContext *c, Dav1dFrameContext *f);
+int dav1d_decode_frame(Dav1dContext *c, Dav1dFrameContext *f);
 int dav1d_decode_tile_sbrow(Dav1dTaskContext *t);
 
 #endif /* DAV1D_SRC_THREAD_TASK_H */
@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "config.h"
+
+#include <stdint.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+#include "src/internal.h"
+#include "src/trace.h"
+
+uint64_t dav1d_get_time_nanos(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    uint64_t seconds = t.QuadPart / frequency.QuadPart;
+    uint64_t fractions = t.QuadPart % frequency.QuadPart;
+    return 1000000000 * seconds + 1000000000 * fractions / frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+#elif defined(__APPLE__)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return mach_absolute_time() * info.numer / info.denom;
+#else
+    return 0;
+#endif
+}
+
+void dav1d_trace_task_begin(Dav1dTaskContext *const tc, const enum TaskType type,
+                            const unsigned frame_idx, const int sby,
+                            const int64_t timestamp)
+{
+    const Dav1dContext *const c = tc->c;
+    if (!c->trace_tasks) return;
+
+    Dav1dTaskTraceEvent *const ev = &tc->trace.event;
+    ev->thread_id = (unsigned)(tc - c->tc);
+    ev->frame_idx = frame_idx;
+    ev->sby = sby;
+    ev->timestamp = timestamp;
+    ev->type = (enum Dav1dTaskTraceType) type;
+    tc->trace.active = 1;
+    ev->start = dav1d_get_time_nanos();
+}
+
+void dav1d_trace_task_end(Dav1dTaskContext *const tc) {
+    if (!tc->trace.active) return;
+
+    const Dav1dTaskTraceEvent *const ev = &tc->trace.event;
+    tc->trace.event.end = dav1d_get_time_nanos();
+    tc->trace.active = 0;
+    tc->trace.stage_ns[ev->type] += ev->end - ev->start;
+#if CONFIG_TRACE
+    const Dav1dContext *const c = tc->c;
+    if (c->tracer.callback)
+        c->tracer.callback(c->tracer.cookie, ev);
+#endif
+}
+
+void dav1d_trace_task_next(Dav1dTaskContext *const tc, const enum TaskType type) {
+    if (!tc->trace.active) return;
+    if (tc->trace.event.type == (enum Dav1dTaskTraceType) type) return;
+
+    const Dav1dTaskTraceEvent prev = tc->trace.event;
+    dav1d_trace_task_end(tc);
+    dav1d_trace_task_begin(tc, type, prev.frame_idx, prev.sby, prev.timestamp);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DAV1D_SRC_TRACE_H
+#define DAV1D_SRC_TRACE_H
+
+#include "config.h"
+
+#include "src/internal.h"
+
+// monotonic time in nanoseconds, or 0 if no clock is available
+uint64_t dav1d_get_time_nanos(void);
+
+// starts measuring a stage run outside of task events, returns 0 if stage
+// times weren't requested
+static inline uint64_t dav1d_stage_time_start(const Dav1dContext *const c) {
+    return c->stage_times ? dav1d_get_time_nanos() : 0;
+}
+
+// adds the time since *start, if measured, to *total and restarts from now
+static inline void dav1d_stage_time_lap(uint64_t *const total, uint64_t *const start) {
+    if (!*start) return;
+    const uint64_t now = dav1d_get_time_nanos();
+    *total += now - *start;
+    *start = now;
+}
+
+// task events are timed when stage times were requested, and additionally
+// reported to the tracer callback in builds with tracing support
+void dav1d_trace_task_begin(Dav1dTaskContext *tc, enum TaskType type,
+                            unsigned frame_idx, int sby, int64_t timestamp);
+void dav1d_trace_task_end(Dav1dTaskContext *tc);
+// ends the current event and starts a new one for the same frame and sbrow,
+// used when a task falls through to the next post-filter stage
+void dav1d_trace_task_next(Dav1dTaskContext *tc, enum TaskType type);
+
+#endif /* DAV1D_SRC_TRACE_H */
@@ -0,0 +1,161 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 12
+
+typedef struct {
+    uint64_t hash[N_FRAMES];
+    int n_out, n_err;
+    size_t peak; // highest memory use, in bytes
+} Output;
+
+// Keeps the last output picture until the next one, as a player displaying it
+// would, so that the decoder has to do with the references it holds itself.
+static int get_pictures(Dav1dContext *const c, Dav1dPicture *const shown,
+                        Output *const out)
+{
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while ((res = dav1d_get_picture(c, &p)) != DAV1D_ERR(EAGAIN)) {
+        if (res < 0) {
+            out->n_err++;
+            continue;
+        }
+        dav1d_picture_unref(shown);
+        *shown = p;
+        memset(&p, 0, sizeof(p));
+        if (out->n_out == N_FRAMES) return -1;
+        out->hash[out->n_out++] = synth_hash_picture(shown);
+    }
+    return 0;
+}
+
+static int decode(const SynthStream *const stream, const Dav1dSettings *const s,
+                  Output *const out)
+{
+    Dav1dPicture shown = { 0 };
+    Dav1dContext *c;
+    int res = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (dav1d_open(&c, s)) return -1;
+
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        Dav1dData data = { 0 };
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+        if (ptr) memcpy(ptr, tu.data, tu.sz);
+        synth_tu_free(&tu);
+        if (!ptr) {
+            res = -1;
+            break;
+        }
+        do {
+            const int ret = dav1d_send_data(c, &data);
+            if (ret < 0 && ret != DAV1D_ERR(EAGAIN)) {
+                out->n_err++;
+                dav1d_data_unref(&data);
+            }
+            res = get_pictures(c, &shown, out);
+        } while (!res && data.sz);
+        dav1d_data_unref(&data);
+    }
+    if (!res) res = get_pictures(c, &shown, out);
+    dav1d_picture_unref(&shown);
+
+    Dav1dMemoryStats stats;
+    if (!res && !(res = dav1d_get_memory_stats(c, &stats)))
+        out->peak = stats.peak;
+    dav1d_close(&c);
+    return res;
+}
+
+/*
+ * The memory budget must not reject what fits in it: a budget just above the
+ * peak memory use of decoding a stream without budget keeps the same frame
+ * delay, and decodes the stream as before.
+ */
+int main(void) {
+    static const struct {
+        int n_threads, max_frame_delay, frame_size_limit;
+    } configs[] = {
+        { 1, 1, 0 }, { 4, 1, 0 }, { 4, 2, 1280 * 720 },
+    };
+    // 8-bit 720p, with all references distinct as in real streams
+    const SynthStream stream = {
+        .width = 1280, .height = 720, .n_frames = N_FRAMES, .all_refs = 1,
+    };
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(*configs); i++) {
+        Dav1dSettings s;
+        Output ref, out;
+
+        dav1d_default_settings(&s);
+        s.n_threads = configs[i].n_threads;
+        s.max_frame_delay = configs[i].max_frame_delay;
+        s.frame_size_limit = configs[i].frame_size_limit;
+        if (decode(&stream, &s, &ref) || ref.n_out != N_FRAMES || ref.n_err) {
+            fprintf(stderr, "Failed to decode reference with %d threads, "
+                    "frame delay %d (%d pictures, %d errors)\n", s.n_threads,
+                    s.max_frame_delay, ref.n_out, ref.n_err);
+            ret = 1;
+            continue;
+        }
+
+        const int frame_delay = dav1d_get_frame_delay(&s);
+        s.memory_budget = ref.peak + ref.peak / 8;
+        if (dav1d_get_frame_delay(&s) != frame_delay) {
+            fprintf(stderr, "Budget of %zu bytes for a peak of %zu reduces the "
+                    "frame delay from %d to %d\n", s.memory_budget, ref.peak,
+                    frame_delay, dav1d_get_frame_delay(&s));
+            ret = 1;
+        }
+        if (decode(&stream, &s, &out) || out.n_err || out.n_out != N_FRAMES ||
+            memcmp(out.hash, ref.hash, sizeof(ref.hash)))
+        {
+            fprintf(stderr, "Budget of %zu bytes for a peak of %zu: mismatch "
+                    "with %d threads, frame delay %d (%d pictures, %d errors)\n",
+                    s.memory_budget, ref.peak, s.n_threads, s.max_frame_delay,
+                    out.n_out, out.n_err);
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
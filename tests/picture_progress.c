@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 16
+
+typedef struct {
+    uint8_t *data[3];
+    int h[3];
+    size_t w[3];
+} PlaneCopy;
+
+// compares the rows of p which were reported final with the copy, then adds
+// the rows which became final since to it
+static int update_copy(PlaneCopy *const copy, const Dav1dPicture *const p,
+                       const int rows, const int prev_rows)
+{
+    const int ss_ver = p->p.layout == DAV1D_PIXEL_LAYOUT_I420;
+    const int n_planes = p->p.layout == DAV1D_PIXEL_LAYOUT_I400 ? 1 : 3;
+
+    for (int pl = 0; pl < n_planes; pl++) {
+        const int ss = pl ? ss_ver : 0;
+        const int h = rows == p->p.h ? copy->h[pl] : rows >> ss;
+        const int prev_h = prev_rows == p->p.h ? copy->h[pl] : prev_rows >> ss;
+        const ptrdiff_t stride = p->stride[!!pl];
+        const uint8_t *const src = p->data[pl];
+
+        for (int y = 0; y < prev_h; y++)
+            if (memcmp(&copy->data[pl][y * copy->w[pl]], &src[y * stride], copy->w[pl]))
+                return -1;
+        for (int y = prev_h; y < h; y++)
+            memcpy(&copy->data[pl][y * copy->w[pl]], &src[y * stride], copy->w[pl]);
+    }
+    return 0;
+}
+
+// follows the progress of a picture until it is complete, checking that its
+// final rows never change
+static int check_picture(const Dav1dPicture *const p, int *const n_partial) {
+    const int ss_ver = p->p.layout == DAV1D_PIXEL_LAYOUT_I420;
+    const int ss_hor = p->p.layout != DAV1D_PIXEL_LAYOUT_I444;
+    const int hbd = p->p.bpc > 8;
+    PlaneCopy copy = { 0 };
+    int res = -1, rows = 0;
+
+    for (int pl = 0; pl < 3; pl++) {
+        copy.w[pl] = (size_t) (pl ? (p->p.w + ss_hor) >> ss_hor : p->p.w) << hbd;
+        copy.h[pl] = pl ? (p->p.h + ss_ver) >> ss_ver : p->p.h;
+        if (!(copy.data[pl] = malloc(copy.w[pl] * copy.h[pl]))) goto end;
+    }
+
+    do {
+        const int progress = dav1d_get_picture_progress(p);
+        if (progress < rows || progress > p->p.h) {
+            fprintf(stderr, "Invalid progress %d after %d rows\n", progress, rows);
+            goto end;
+        }
+        if (progress > rows && progress < p->p.h) ++*n_partial;
+        if (update_copy(&copy, p, progress, rows)) {
+            fprintf(stderr, "Rows changed after being reported final "
+                    "(%d of %d rows final)\n", progress, p->p.h);
+            goto end;
+        }
+        rows = progress;
+    } while (rows < p->p.h);
+    res = update_copy(&copy, p, rows, rows);
+
+end:
+    for (int pl = 0; pl < 3; pl++)
+        free(copy.data[pl]);
+    return res;
+}
+
+static int decode(const SynthStream *const stream, const int early_output,
+                  uint64_t *const hash, int *const n_partial)
+{
+    Dav1dSettings s;
+    Dav1dContext *c;
+    Dav1dPicture p = { 0 };
+    int res = 0, n_out = 0;
+
+    dav1d_default_settings(&s);
+    s.n_threads = early_output ? 4 : 1;
+    s.max_frame_delay = early_output ? 4 : 1;
+    s.early_output = early_output;
+    if (dav1d_open(&c, &s)) return -1;
+
+    for (int n = 0; !res && n <= stream->n_frames; n++) {
+        Dav1dData data = { 0 };
+        if (n < stream->n_frames) {
+            SynthTU tu;
+            if ((res = synth_tu(&tu, stream, n)) < 0) break;
+            uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+            if (ptr) memcpy(ptr, tu.data, tu.sz);
+            synth_tu_free(&tu);
+            if (!ptr) {
+                res = -1;
+                break;
+            }
+        }
+        do {
+            if (data.sz && (res = dav1d_send_data(c, &data)) < 0 &&
+                res != DAV1D_ERR(EAGAIN))
+            {
+                dav1d_data_unref(&data);
+                break;
+            }
+            while (!(res = dav1d_get_picture(c, &p))) {
+                if (n_out == stream->n_frames ||
+                    (early_output && check_picture(&p, n_partial)))
+                {
+                    dav1d_picture_unref(&p);
+                    res = -1;
+                    break;
+                }
+                hash[n_out++] = synth_hash_picture(&p);
+                dav1d_picture_unref(&p);
+            }
+            if (res == DAV1D_ERR(EAGAIN)) res = 0;
+        } while (!res && data.sz);
+    }
+    if (!res && n_out != stream->n_frames) res = -1;
+
+    dav1d_close(&c);
+    return res;
+}
+
+int main(void) {
+    const SynthStream stream = {
+        .width = 256, .height = 256, .n_frames = N_FRAMES,
+    };
+    uint64_t ref[N_FRAMES], hash[N_FRAMES];
+    int n_partial = 0;
+
+    if (decode(&stream, 0, ref, &n_partial)) {
+        fprintf(stderr, "Failed to decode reference\n");
+        return 1;
+    }
+    if (decode(&stream, 1, hash, &n_partial)) {
+        fprintf(stderr, "Failed to decode with early output\n");
+        return 1;
+    }
+    if (memcmp(hash, ref, sizeof(ref))) {
+        fprintf(stderr, "Mismatch with early output\n");
+        return 1;
+    }
+    printf("%d intermediate progress steps\n", n_partial);
+
+    return 0;
+}
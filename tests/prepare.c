@@ -0,0 +1,184 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 12
+
+typedef struct {
+    uint64_t hash[N_FRAMES];
+    int n_out;
+} Output;
+
+static int get_pictures(Dav1dContext *const c, Output *const out) {
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while (!(res = dav1d_get_picture(c, &p))) {
+        if (out->n_out == N_FRAMES) {
+            dav1d_picture_unref(&p);
+            return -1;
+        }
+        out->hash[out->n_out++] = synth_hash_picture(&p);
+        dav1d_picture_unref(&p);
+    }
+    return res == DAV1D_ERR(EAGAIN) ? 0 : res;
+}
+
+// prepares the decoder twice, the second time of which must allocate nothing
+static int prepare(Dav1dContext *const c, const SynthStream *const stream,
+                   uint64_t *const misses)
+{
+    Dav1dSequenceHeader seq_hdr;
+    Dav1dPicturePoolStats pool[2];
+    Dav1dMemoryStats mem[2];
+    SynthTU tu;
+    int res;
+
+    if ((res = synth_tu(&tu, stream, 0)) < 0) return res;
+    res = dav1d_parse_sequence_header(&seq_hdr, tu.data, tu.sz);
+    synth_tu_free(&tu);
+    if (res < 0) return res;
+
+    for (int i = 0; i < 2; i++) {
+        if ((res = dav1d_prepare(c, &seq_hdr)) < 0) {
+            fprintf(stderr, "Preparing failed with %d\n", res);
+            return res;
+        }
+        if ((res = dav1d_get_picture_pool_stats(c, &pool[i])) < 0 ||
+            (res = dav1d_get_memory_stats(c, &mem[i])) < 0)
+        {
+            return res;
+        }
+    }
+    if (mem[1].current != mem[0].current || pool[1].misses != pool[0].misses) {
+        fprintf(stderr, "Preparing again allocated more memory (%zu bytes and "
+                "%u pictures)\n", mem[1].current - mem[0].current,
+                (unsigned) (pool[1].misses - pool[0].misses));
+        return -1;
+    }
+    *misses = pool[0].misses;
+    return 0;
+}
+
+static int decode(const SynthStream *const stream, const Dav1dSettings *const s,
+                  const int prepared, Output *const out)
+{
+    Dav1dPicturePoolStats pool;
+    Dav1dContext *c;
+    uint64_t misses = 0;
+    int res = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (dav1d_open(&c, s)) return -1;
+    if (prepared && (res = prepare(c, stream, &misses)) < 0) goto end;
+
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        Dav1dData data = { 0 };
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+        if (ptr) memcpy(ptr, tu.data, tu.sz);
+        synth_tu_free(&tu);
+        if (!ptr) {
+            res = -1;
+            break;
+        }
+        do {
+            if ((res = dav1d_send_data(c, &data)) < 0 &&
+                res != DAV1D_ERR(EAGAIN))
+            {
+                dav1d_data_unref(&data);
+                break;
+            }
+            res = get_pictures(c, out);
+        } while (!res && data.sz);
+    }
+    if (!res) res = get_pictures(c, out);
+    if (!res && out->n_out != stream->n_frames) res = -1;
+
+    // all pictures were allocated ahead of decoding
+    if (!res && prepared && !(res = dav1d_get_picture_pool_stats(c, &pool)) &&
+        pool.misses != misses)
+    {
+        fprintf(stderr, "%u pictures allocated after preparing\n",
+                (unsigned) (pool.misses - misses));
+        res = -1;
+    }
+
+end:
+    dav1d_close(&c);
+    return res;
+}
+
+/*
+ * Preparing a decoder before its first frame allocates what decoding the
+ * stream needs, preparing it again allocates nothing more, and neither
+ * changes the output.
+ */
+int main(void) {
+    static const struct {
+        int n_threads, max_frame_delay;
+    } configs[] = {
+        { 1, 1 }, { 4, 1 }, { 4, 4 },
+    };
+    const SynthStream stream = {
+        .width = 640, .height = 360, .n_frames = N_FRAMES, .all_refs = 1,
+    };
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(*configs); i++) {
+        Dav1dSettings s;
+        Output ref, out;
+
+        dav1d_default_settings(&s);
+        s.n_threads = configs[i].n_threads;
+        s.max_frame_delay = configs[i].max_frame_delay;
+        if (decode(&stream, &s, 0, &ref)) {
+            fprintf(stderr, "Failed to decode reference with %d threads, "
+                    "frame delay %d\n", s.n_threads, s.max_frame_delay);
+            ret = 1;
+            continue;
+        }
+        if (decode(&stream, &s, 1, &out) ||
+            memcmp(out.hash, ref.hash, sizeof(ref.hash)))
+        {
+            fprintf(stderr, "Mismatch after preparing with %d threads, "
+                    "frame delay %d\n", s.n_threads, s.max_frame_delay);
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+#include "vcs_version.h"
+#include "cli_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "input/input.h"
+#include "input/demuxer.h"
+#include "dav1d_cli_parse.h"
+
+// number of temporal units decoded between two reconfigurations
+#define RECONFIGURE_INTERVAL 3
+
+const Demuxer annexb_demuxer = { .name = "" };
+const Demuxer section5_demuxer = { .name = "" };
+
+typedef struct {
+    uint64_t *hash;
+    unsigned n, sz;
+} HashList;
+
+static uint64_t hash_picture(const Dav1dPicture *const p) {
+    const int hbd = p->p.bpc > 8;
+    const int ss_ver = p->p.layout == DAV1D_PIXEL_LAYOUT_I420;
+    const int ss_hor = p->p.layout != DAV1D_PIXEL_LAYOUT_I444;
+    const int n_planes = p->p.layout == DAV1D_PIXEL_LAYOUT_I400 ? 1 : 3;
+    uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+
+    for (int pl = 0; pl < n_planes; pl++) {
+        const int w = (pl ? (p->p.w + ss_hor) >> ss_hor : p->p.w) << hbd;
+        const int ph = pl ? (p->p.h + ss_ver) >> ss_ver : p->p.h;
+        const uint8_t *row = p->data[pl];
+        for (int y = 0; y < ph; y++, row += p->stride[!!pl])
+            for (int x = 0; x < w; x++)
+                h = (h ^ row[x]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// outputs the picture to the list of hashes, or checks it against them
+static int handle_picture(HashList *const list, const int check,
+                          Dav1dPicture *const p)
+{
+    const uint64_t h = hash_picture(p);
+    dav1d_picture_unref(p);
+
+    if (check) {
+        if (list->n >= list->sz || list->hash[list->n] != h) {
+            fprintf(stderr, "Mismatch at picture %u\n", list->n);
+            return -1;
+        }
+    } else {
+        if (list->n == list->sz) {
+            const unsigned sz = list->sz ? list->sz * 2 : 64;
+            uint64_t *const hash = realloc(list->hash, sz * sizeof(*hash));
+            if (!hash) return -1;
+            list->hash = hash;
+            list->sz = sz;
+        }
+        list->hash[list->n] = h;
+    }
+    list->n++;
+    return 0;
+}
+
+static int get_pictures(Dav1dContext *const c, HashList *const list,
+                        const int check)
+{
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while (!(res = dav1d_get_picture(c, &p)))
+        if (handle_picture(list, check, &p)) return -1;
+    if (res != DAV1D_ERR(EAGAIN)) {
+        fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+        return res;
+    }
+    return 0;
+}
+
+// returns all pending pictures, then changes the threading configuration
+static int reconfigure(Dav1dContext *const c, const Dav1dSettings *const s,
+                       HashList *const list)
+{
+    int res;
+
+    while ((res = dav1d_reconfigure(c, s)) == DAV1D_ERR(EAGAIN)) {
+        Dav1dPicture p = { 0 };
+        if ((res = dav1d_get_picture(c, &p)) < 0) {
+            if (res == DAV1D_ERR(EAGAIN)) continue;
+            fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+            return res;
+        }
+        if (handle_picture(list, 1, &p)) return -1;
+    }
+    if (res < 0)
+        fprintf(stderr, "Error reconfiguring decoder: %s\n", strerror(DAV1D_ERR(res)));
+    return res;
+}
+
+/*
+ * Decodes the whole input. Without configs, the hashes of the output pictures
+ * are stored; otherwise the decoder is reconfigured to the next config every
+ * RECONFIGURE_INTERVAL temporal units, and the output is checked against the
+ * stored hashes.
+ */
+static int decode(const CLISettings *const cli_settings,
+                  const Dav1dSettings *const s, HashList *const list,
+                  const Dav1dSettings *const configs, const int n_configs)
+{
+    DemuxerContext *in;
+    Dav1dContext *c;
+    Dav1dData data;
+    unsigned fps[2], total, timebase[2];
+    int res = -1;
+
+    if (input_open(&in, "ivf", cli_settings->inputfile,
+                   fps, &total, timebase, cli_settings->mmap) < 0)
+    {
+        return -1;
+    }
+    if (dav1d_open(&c, s)) {
+        input_close(in);
+        return -1;
+    }
+
+    list->n = 0;
+    for (int n_tu = 0, n_cfg = 0; !input_read(in, &data) && data.sz;) {
+        do {
+            if ((res = dav1d_send_data(c, &data)) < 0 && res != DAV1D_ERR(EAGAIN)) {
+                fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+                dav1d_data_unref(&data);
+                goto end;
+            }
+            if ((res = get_pictures(c, list, n_configs))) {
+                dav1d_data_unref(&data);
+                goto end;
+            }
+        } while (data.sz);
+
+        if (n_configs && ++n_tu % RECONFIGURE_INTERVAL == 0 &&
+            (res = reconfigure(c, &configs[n_cfg++ % n_configs], list)))
+        {
+            goto end;
+        }
+    }
+    // drain
+    Dav1dPicture p = { 0 };
+    while ((res = dav1d_get_picture(c, &p)) != DAV1D_ERR(EAGAIN)) {
+        if (res < 0) {
+            fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+            goto end;
+        }
+        if ((res = handle_picture(list, n_configs, &p))) goto end;
+    }
+    res = 0;
+    if (n_configs && list->n != list->sz) {
+        fprintf(stderr, "Expected %u pictures, got %u\n", list->sz, list->n);
+        res = -1;
+    }
+
+end:
+    dav1d_close(&c);
+    input_close(in);
+    return res;
+}
+
+int main(const int argc, char *const *const argv) {
+    const char *version = dav1d_version();
+    if (strcmp(version, DAV1D_VERSION)) {
+        fprintf(stderr, "Version mismatch (library: %s, executable: %s)\n",
+                version, DAV1D_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    CLISettings cli_settings;
+    Dav1dSettings lib_settings;
+    HashList list = { 0 };
+
+    parse(argc, argv, &cli_settings, &lib_settings);
+
+    // switch between a single frame context and frame threading, so that
+    // references decoded in one mode are used by frames decoded in the other
+    Dav1dSettings single = lib_settings, configs[4];
+    single.n_threads = single.max_frame_delay = 1;
+    for (int i = 0; i < 4; i++)
+        configs[i] = single;
+    configs[0].n_threads = lib_settings.n_threads ? lib_settings.n_threads : 8;
+    configs[0].max_frame_delay = lib_settings.max_frame_delay ?
+                                 lib_settings.max_frame_delay : 4;
+    configs[2].n_threads = 2; // tile threading only
+
+    // reference output, without any reconfiguration
+    if (decode(&cli_settings, &single, &list, NULL, 0)) {
+        free(list.hash);
+        return EXIT_FAILURE;
+    }
+    list.sz = list.n; // from now on, the number of expected pictures
+
+    // 1 -> N -> 1 -> 2 (tile threads) -> 1 -> N ...
+    const int res = decode(&cli_settings, &single, &list, configs, 4);
+    free(list.hash);
+    return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -173,7 +173,7 @@ int main(const int argc, char *const *const argv) {
     parse(argc, argv, &cli_settings, &lib_settings);
 
     if (input_open(&in, "ivf", cli_settings.inputfile,
-                   i_fps, &total, i_timebase) < 0 ||
+                   i_fps, &total, i_timebase, cli_settings.mmap) < 0 ||
         !i_timebase[0] || !i_timebase[1] ||  !i_fps[0] || !i_fps[1])
     {
         return EXIT_SUCCESS;
@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 8
+
+typedef struct {
+    uint64_t hash[N_FRAMES];
+    int n_out;
+    int n_steps; // number of dav1d_decode_step() calls which decoded something
+    int early_picture; // a picture was output while its frame was in progress
+} Output;
+
+static int get_pictures(Dav1dContext *const c, Output *const out) {
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while (!(res = dav1d_get_picture(c, &p))) {
+        if (out->n_out == N_FRAMES) {
+            dav1d_picture_unref(&p);
+            return -1;
+        }
+        out->hash[out->n_out++] = synth_hash_picture(&p);
+        dav1d_picture_unref(&p);
+    }
+    return res == DAV1D_ERR(EAGAIN) ? 0 : res;
+}
+
+// decodes the pending frame with a budget of 0, i.e. one superblock row per
+// call, checking that its picture is only output once it is complete
+static int decode_steps(Dav1dContext *const c, Output *const out) {
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while ((res = dav1d_decode_step(c, 0)) == 1) {
+        out->n_steps++;
+        if (!dav1d_get_picture(c, &p)) {
+            dav1d_picture_unref(&p);
+            out->early_picture = 1;
+        }
+    }
+    return res;
+}
+
+static int decode(const SynthStream *const stream, const int step_decoding,
+                  Output *const out)
+{
+    Dav1dSettings s;
+    Dav1dContext *c;
+    int res = 0;
+
+    memset(out, 0, sizeof(*out));
+    dav1d_default_settings(&s);
+    s.n_threads = 1;
+    s.max_frame_delay = 1;
+    s.step_decoding = step_decoding;
+    if (dav1d_open(&c, &s)) return -1;
+
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        Dav1dData data = { 0 };
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+        if (ptr) memcpy(ptr, tu.data, tu.sz);
+        synth_tu_free(&tu);
+        if (!ptr) {
+            res = -1;
+            break;
+        }
+        do {
+            if ((res = dav1d_send_data(c, &data)) < 0 &&
+                res != DAV1D_ERR(EAGAIN))
+            {
+                dav1d_data_unref(&data);
+                break;
+            }
+            if (step_decoding && (res = decode_steps(c, out)) < 0) {
+                dav1d_data_unref(&data);
+                break;
+            }
+            res = get_pictures(c, out);
+        } while (!res && data.sz);
+    }
+    if (!res) res = get_pictures(c, out);
+    if (!res && out->n_out != stream->n_frames) res = -1;
+
+    dav1d_close(&c);
+    return res;
+}
+
+/*
+ * A decoding step with no time left decodes a single superblock row, which
+ * bounds the duration of each call; the steps of a frame add up to the same
+ * picture as decoding it in one go.
+ */
+int main(void) {
+    const SynthStream stream = {
+        .width = 640, .height = 360, .n_frames = N_FRAMES,
+    };
+    // 64x64 superblocks, all frames of the same size
+    const int sbh = (stream.height + 63) >> 6;
+    Output ref, out;
+
+    if (decode(&stream, 0, &ref)) {
+        fprintf(stderr, "Failed to decode reference\n");
+        return 1;
+    }
+    if (decode(&stream, 1, &out)) {
+        fprintf(stderr, "Failed to decode in steps\n");
+        return 1;
+    }
+    if (memcmp(out.hash, ref.hash, sizeof(ref.hash))) {
+        fprintf(stderr, "Mismatch when decoding in steps\n");
+        return 1;
+    }
+    if (out.early_picture) {
+        fprintf(stderr, "Picture output before its last decoding step\n");
+        return 1;
+    }
+    // each frame takes one call per sbrow, the last of which returns 0
+    if (out.n_steps != N_FRAMES * (sbh - 1)) {
+        fprintf(stderr, "%d decoding steps for %d frames of %d superblock "
+                "rows\n", out.n_steps, N_FRAMES, sbh);
+        return 1;
+    }
+
+    return 0;
+}
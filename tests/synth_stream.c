@@ -0,0 +1,391 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "synth_stream.h"
+
+enum ObuType {
+    OBU_SEQ_HDR   = 1,
+    OBU_TD        = 2,
+    OBU_FRAME_HDR = 3,
+    OBU_TILE_GRP  = 4,
+    OBU_FRAME     = 6,
+};
+
+typedef struct BitWriter {
+    uint8_t buf[64];
+    int bits;
+} BitWriter;
+
+static void put_bits(BitWriter *const bw, const unsigned v, const int n) {
+    for (int i = n - 1; i >= 0; i--, bw->bits++)
+        if (v >> i & 1)
+            bw->buf[bw->bits >> 3] |= 0x80 >> (bw->bits & 7);
+}
+
+static void put_trailing_bits(BitWriter *const bw) {
+    put_bits(bw, 1, 1);
+    bw->bits = (bw->bits + 7) & ~7;
+}
+
+static void byte_align(BitWriter *const bw) {
+    bw->bits = (bw->bits + 7) & ~7;
+}
+
+static int tile_log2(const int blk, const int target) {
+    int k = 0;
+    while ((blk << k) < target) k++;
+    return k;
+}
+
+static uint32_t rand_next(uint32_t *const state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static size_t tile_sz(const SynthStream *const s) {
+    return (size_t) s->width * s->height / 4;
+}
+
+static void write_seq_hdr(BitWriter *const bw, const SynthStream *const s) {
+    put_bits(bw, 0, 3); // seq_profile
+    put_bits(bw, 0, 1); // still_picture
+    put_bits(bw, 0, 1); // reduced_still_picture_header
+    put_bits(bw, 0, 1); // timing_info_present_flag
+    put_bits(bw, 0, 1); // initial_display_delay_present_flag
+    put_bits(bw, 0, 5); // operating_points_cnt_minus_1
+    put_bits(bw, 0, 12); // operating_point_idc
+    put_bits(bw, 0, 5); // seq_level_idx
+    put_bits(bw, 15, 4); // frame_width_bits_minus_1
+    put_bits(bw, 15, 4); // frame_height_bits_minus_1
+    put_bits(bw, s->width - 1, 16);
+    put_bits(bw, s->height - 1, 16);
+    put_bits(bw, 0, 1); // frame_id_numbers_present_flag
+    put_bits(bw, 0, 1); // use_128x128_superblock
+    // filter_intra, intra_edge, interintra_compound, masked_compound,
+    // warped_motion, dual_filter, order_hint, jnt_comp, ref_frame_mvs
+    put_bits(bw, 0x1ff, 9);
+    put_bits(bw, 1, 1); // seq_choose_screen_content_tools
+    put_bits(bw, 1, 1); // seq_choose_integer_mv
+    put_bits(bw, 6, 3); // order_hint_bits_minus_1
+    put_bits(bw, 0, 1); // enable_superres
+    put_bits(bw, 1, 1); // enable_cdef
+    put_bits(bw, 1, 1); // enable_restoration
+    put_bits(bw, 0, 1); // high_bitdepth
+    put_bits(bw, 0, 1); // mono_chrome
+    put_bits(bw, 0, 1); // color_description_present_flag
+    put_bits(bw, 0, 1); // color_range
+    put_bits(bw, 0, 2); // chroma_sample_position
+    put_bits(bw, 0, 1); // separate_uv_delta_q
+    put_bits(bw, 0, 1); // film_grain_params_present
+    put_trailing_bits(bw);
+}
+
+static void write_frame_hdr(BitWriter *const bw, const SynthStream *const s,
+                            const int n)
+{
+    put_bits(bw, 0, 1); // show_existing_frame
+    if (!n) {
+        put_bits(bw, 0, 2); // frame_type (key)
+        put_bits(bw, 1, 1); // show_frame
+        put_bits(bw, 0, 1); // disable_cdf_update
+        put_bits(bw, 0, 1); // allow_screen_content_tools
+        put_bits(bw, 0, 1); // frame_size_override_flag
+        put_bits(bw, 0, 7); // order_hint
+        put_bits(bw, 0, 1); // render_and_frame_size_different
+    } else {
+        put_bits(bw, 1, 2); // frame_type (inter)
+        put_bits(bw, 1, 1); // show_frame
+        put_bits(bw, 0, 1); // error_resilient_mode
+        put_bits(bw, 0, 1); // disable_cdf_update
+        put_bits(bw, 0, 1); // allow_screen_content_tools
+        put_bits(bw, 0, 1); // frame_size_override_flag
+        put_bits(bw, n & 127, 7); // order_hint
+        put_bits(bw, 7, 3); // primary_ref_frame (none)
+        put_bits(bw, s->all_refs ? 1 << (n & 7) : n % 4 ? 0 : 1, 8); // refresh_frame_flags
+        put_bits(bw, 0, 1); // frame_refs_short_signaling
+        put_bits(bw, 0, 21); // ref_frame_idx[7]
+        put_bits(bw, 0, 1); // render_and_frame_size_different
+        put_bits(bw, 1, 1); // allow_high_precision_mv
+        put_bits(bw, 1, 1); // is_filter_switchable
+        put_bits(bw, 1, 1); // is_motion_mode_switchable
+        put_bits(bw, 0, 1); // use_ref_frame_mvs
+    }
+    put_bits(bw, 0, 1); // disable_frame_end_update_cdf
+
+    // uniformly spaced 2x2 tiles
+    put_bits(bw, 1, 1); // uniform_tile_spacing_flag
+    put_bits(bw, 1, 1); // increment_tile_cols_log2
+    if (tile_log2(1, (s->width + 63) >> 6) > 1)
+        put_bits(bw, 0, 1);
+    put_bits(bw, 1, 1); // increment_tile_rows_log2
+    if (tile_log2(1, (s->height + 63) >> 6) > 1)
+        put_bits(bw, 0, 1);
+    put_bits(bw, 3, 2); // context_update_tile_id
+    put_bits(bw, 3, 2); // tile_size_bytes_minus_1
+
+    put_bits(bw, 120, 8); // base_q_idx
+    put_bits(bw, 0, 3); // delta_coded (y dc, u dc, u ac)
+    put_bits(bw, 0, 1); // using_qmatrix
+    put_bits(bw, 0, 1); // segmentation_enabled
+    put_bits(bw, 0, 1); // delta_q_present
+    put_bits(bw, 10, 6); // loop_filter_level[0]
+    put_bits(bw, 10, 6); // loop_filter_level[1]
+    put_bits(bw, 8, 6); // loop_filter_level[2]
+    put_bits(bw, 8, 6); // loop_filter_level[3]
+    put_bits(bw, 2, 3); // loop_filter_sharpness
+    put_bits(bw, 0, 1); // loop_filter_delta_enabled
+    put_bits(bw, 1, 2); // cdef_damping_minus_3
+    put_bits(bw, 0, 2); // cdef_bits
+    put_bits(bw, 4, 4); // cdef_y_pri_strength
+    put_bits(bw, 1, 2); // cdef_y_sec_strength
+    put_bits(bw, 2, 4); // cdef_uv_pri_strength
+    put_bits(bw, 1, 2); // cdef_uv_sec_strength
+    put_bits(bw, 0, 6); // lr_type[3]
+    put_bits(bw, 1, 1); // tx_mode_select
+    if (n) {
+        put_bits(bw, 0, 1); // reference_select
+        put_bits(bw, 0, 1); // allow_warped_motion
+    }
+    put_bits(bw, 0, 1); // reduced_tx_set
+    if (n)
+        put_bits(bw, 0, 7); // is_global[7]
+}
+
+static void write_tile_grp_hdr(BitWriter *const bw, const int start,
+                               const int end)
+{
+    const int all = start == 0 && end == 3;
+    put_bits(bw, !all, 1); // tile_start_and_end_present_flag
+    if (!all) {
+        put_bits(bw, start, 2);
+        put_bits(bw, end, 2);
+    }
+    byte_align(bw);
+}
+
+typedef struct Writer {
+    SynthTU *tu;
+    size_t alloc;
+} Writer;
+
+static uint8_t *reserve(Writer *const w, const size_t sz) {
+    if (w->tu->sz + sz > w->alloc) {
+        const size_t alloc = (w->tu->sz + sz) * 2;
+        uint8_t *const data = realloc(w->tu->data, alloc);
+        if (!data) return NULL;
+        w->tu->data = data;
+        w->alloc = alloc;
+    }
+    uint8_t *const ptr = w->tu->data + w->tu->sz;
+    w->tu->sz += sz;
+    return ptr;
+}
+
+static int put_bytes(Writer *const w, const void *const src, const size_t sz) {
+    uint8_t *const dst = reserve(w, sz);
+    if (!dst) return DAV1D_ERR(ENOMEM);
+    memcpy(dst, src, sz);
+    return 0;
+}
+
+// starts an OBU with room for a payload of payload_sz bytes
+static int start_obu(Writer *const w, const int type, const size_t payload_sz) {
+    SynthTU *const tu = w->tu;
+    if (tu->n_obus == SYNTH_MAX_OBUS) return DAV1D_ERR(EINVAL);
+    tu->obu_offset[tu->n_obus] = tu->sz;
+    tu->obu_type[tu->n_obus] = type;
+
+    uint8_t hdr[9];
+    int hdr_sz = 0;
+    hdr[hdr_sz++] = type << 3 | 2; // obu_has_size_field
+    size_t sz = payload_sz;
+    do {
+        hdr[hdr_sz++] = (sz & 0x7f) | (sz > 0x7f) << 7;
+        sz >>= 7;
+    } while (sz);
+    const int res = put_bytes(w, hdr, hdr_sz);
+    if (res < 0) return res;
+    tu->obu_sz[tu->n_obus++] = hdr_sz + payload_sz;
+    return 0;
+}
+
+static int put_tiles(Writer *const w, const SynthStream *const s, const int n,
+                     const int start, const int end)
+{
+    const size_t sz = tile_sz(s);
+
+    for (int t = start; t <= end; t++) {
+        if (t != end) {
+            uint8_t tile_size_minus_1[4];
+            for (int i = 0; i < 4; i++)
+                tile_size_minus_1[i] = (sz - 1) >> (8 * i);
+            const int res = put_bytes(w, tile_size_minus_1, 4);
+            if (res < 0) return res;
+        }
+        uint8_t *const dst = reserve(w, sz);
+        if (!dst) return DAV1D_ERR(ENOMEM);
+        // seeded per tile, so that splitting a frame doesn't change its tiles
+        uint32_t state = (n * 4 + t + 1) * 0x9e3779b9U;
+        for (size_t i = 0; i < sz; i++)
+            dst[i] = rand_next(&state) >> 24;
+    }
+    return 0;
+}
+
+static int put_obu(Writer *const w, const int type, const BitWriter *const bw) {
+    const int res = start_obu(w, type, bw->bits >> 3);
+    return res < 0 ? res : put_bytes(w, bw->buf, bw->bits >> 3);
+}
+
+// the size in bytes of the tiles start to end in a tile group
+static size_t tiles_sz(const SynthStream *const s, const int start,
+                       const int end)
+{
+    return (end - start + 1) * tile_sz(s) + (end - start) * 4;
+}
+
+static int write_tu(Writer *const w, const SynthStream *const s, const int n) {
+    BitWriter bw = { 0 };
+    int res;
+
+    if ((res = put_obu(w, OBU_TD, &bw)) < 0) return res;
+    if (!n) {
+        write_seq_hdr(&bw, s);
+        if ((res = put_obu(w, OBU_SEQ_HDR, &bw)) < 0) return res;
+    }
+
+    memset(&bw, 0, sizeof(bw));
+    write_frame_hdr(&bw, s, n);
+    if (!s->split) {
+        byte_align(&bw);
+        write_tile_grp_hdr(&bw, 0, 3);
+        if ((res = start_obu(w, OBU_FRAME, (bw.bits >> 3) + tiles_sz(s, 0, 3))) < 0 ||
+            (res = put_bytes(w, bw.buf, bw.bits >> 3)) < 0)
+        {
+            return res;
+        }
+        return put_tiles(w, s, n, 0, 3);
+    }
+
+    put_trailing_bits(&bw);
+    if ((res = put_obu(w, OBU_FRAME_HDR, &bw)) < 0) return res;
+    static const int groups[3][2] = { { 0, 0 }, { 1, 2 }, { 3, 3 } };
+    for (int i = 0; i < 3; i++) {
+        const int start = groups[i][0], end = groups[i][1];
+        memset(&bw, 0, sizeof(bw));
+        write_tile_grp_hdr(&bw, start, end);
+        if ((res = start_obu(w, OBU_TILE_GRP, (bw.bits >> 3) + tiles_sz(s, start, end))) < 0 ||
+            (res = put_bytes(w, bw.buf, bw.bits >> 3)) < 0 ||
+            (res = put_tiles(w, s, n, start, end)) < 0)
+        {
+            return res;
+        }
+    }
+    return 0;
+}
+
+int synth_tu(SynthTU *const tu, const SynthStream *const s, const int n) {
+    memset(tu, 0, sizeof(*tu));
+    if (s->width < 128 || s->height < 128 || (s->width | s->height) & 7 ||
+        s->width > 0xffff || s->height > 0xffff || n < 0 || n >= s->n_frames)
+    {
+        return DAV1D_ERR(EINVAL);
+    }
+
+    Writer w = { .tu = tu };
+    const int res = write_tu(&w, s, n);
+    if (res < 0) synth_tu_free(tu);
+    return res;
+}
+
+void synth_tu_free(SynthTU *const tu) {
+    free(tu->data);
+    memset(tu, 0, sizeof(*tu));
+}
+
+static void wl32(uint8_t *const p, const uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = v >> (8 * i);
+}
+
+int synth_write_ivf(const char *const filename, const SynthStream *const s) {
+    FILE *const f = fopen(filename, "wb");
+    if (!f) return DAV1D_ERR(errno);
+
+    uint8_t hdr[32] = { 'D', 'K', 'I', 'F', 0, 0, 32, 0, 'A', 'V', '0', '1' };
+    hdr[12] = s->width & 0xff;
+    hdr[13] = s->width >> 8;
+    hdr[14] = s->height & 0xff;
+    hdr[15] = s->height >> 8;
+    wl32(&hdr[16], 25); // timebase denominator
+    wl32(&hdr[20], 1); // timebase numerator
+    wl32(&hdr[24], s->n_frames);
+    int res = fwrite(hdr, sizeof(hdr), 1, f) == 1 ? 0 : DAV1D_ERR(EIO);
+
+    for (int n = 0; !res && n < s->n_frames; n++) {
+        SynthTU tu;
+        if ((res = synth_tu(&tu, s, n)) < 0) break;
+        uint8_t frame_hdr[12] = { 0 };
+        wl32(&frame_hdr[0], (uint32_t) tu.sz);
+        wl32(&frame_hdr[4], n); // timestamp
+        if (fwrite(frame_hdr, sizeof(frame_hdr), 1, f) != 1 ||
+            fwrite(tu.data, tu.sz, 1, f) != 1)
+        {
+            res = DAV1D_ERR(EIO);
+        }
+        synth_tu_free(&tu);
+    }
+
+    if (fclose(f) && !res) res = DAV1D_ERR(EIO);
+    return res;
+}
+
+uint64_t synth_hash_picture(const Dav1dPicture *const p) {
+    const int hbd = p->p.bpc > 8;
+    const int ss_ver = p->p.layout == DAV1D_PIXEL_LAYOUT_I420;
+    const int ss_hor = p->p.layout != DAV1D_PIXEL_LAYOUT_I444;
+    const int n_planes = p->p.layout == DAV1D_PIXEL_LAYOUT_I400 ? 1 : 3;
+    uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a
+
+    for (int pl = 0; pl < n_planes; pl++) {
+        const int w = (pl ? (p->p.w + ss_hor) >> ss_hor : p->p.w) << hbd;
+        const int ph = pl ? (p->p.h + ss_ver) >> ss_ver : p->p.h;
+        const uint8_t *row = p->data[pl];
+        for (int y = 0; y < ph; y++, row += p->stride[!!pl])
+            for (int x = 0; x < w; x++)
+                h = (h ^ row[x]) * 0x100000001b3ULL;
+    }
+    return h;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DAV1D_TESTS_SYNTH_STREAM_H
+#define DAV1D_TESTS_SYNTH_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dav1d/dav1d.h"
+
+#define SYNTH_MAX_OBUS 8
+
+// Describes a synthetic 8-bit 4:2:0 stream of 2x2 tiles: a key frame followed
+// by inter frames, each tile filled with pseudo-random bytes. Such a stream
+// decodes deterministically, which is all the tests need from it, but its
+// tiles lack trailing bits, so it only decodes with strict_std_compliance off.
+typedef struct SynthStream {
+    int width, height; // in pixels, both a multiple of 8 and at least 128
+    int n_frames;
+    int split; // put each frame's tiles into 3 tile groups instead of 1
+    int all_refs; // refresh the 8 reference slots in turn, so that they hold
+                  // distinct pictures, instead of slot 0 every 4th frame
+} SynthStream;
+
+// A temporal unit of a SynthStream, along with the position of its OBUs
+typedef struct SynthTU {
+    uint8_t *data;
+    size_t sz;
+    int n_obus;
+    size_t obu_offset[SYNTH_MAX_OBUS], obu_sz[SYNTH_MAX_OBUS];
+    int obu_type[SYNTH_MAX_OBUS];
+} SynthTU;
+
+// Generates the n-th temporal unit of s. Returns 0 on success, or a negative
+// errno value.
+int synth_tu(SynthTU *tu, const SynthStream *s, int n);
+void synth_tu_free(SynthTU *tu);
+
+// Writes all temporal units of s to an IVF file.
+int synth_write_ivf(const char *filename, const SynthStream *s);
+
+// FNV-1a over the visible pixels of p
+uint64_t synth_hash_picture(const Dav1dPicture *p);
+
+#endif /* DAV1D_TESTS_SYNTH_STREAM_H */
@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 16
+#define N_HOST_THREADS 4
+
+// A minimal application executor: host threads which run the pool's tasks
+// whenever the task_available callback signals some.
+typedef struct {
+    Dav1dThreadPool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int pending, die, error;
+    unsigned n_tasks;
+    pthread_t threads[N_HOST_THREADS];
+} Executor;
+
+static void task_available(void *const cookie) {
+    Executor *const ex = cookie;
+
+    pthread_mutex_lock(&ex->lock);
+    ex->pending++;
+    pthread_cond_signal(&ex->cond);
+    pthread_mutex_unlock(&ex->lock);
+}
+
+static void *host_thread(void *const data) {
+    Executor *const ex = data;
+
+    pthread_mutex_lock(&ex->lock);
+    for (;;) {
+        while (!ex->pending && !ex->die)
+            pthread_cond_wait(&ex->cond, &ex->lock);
+        if (ex->die) break;
+        ex->pending--;
+        pthread_mutex_unlock(&ex->lock);
+
+        int res;
+        unsigned n_tasks = 0;
+        while ((res = dav1d_run_task(ex->pool)) > 0)
+            n_tasks += res;
+
+        pthread_mutex_lock(&ex->lock);
+        ex->n_tasks += n_tasks;
+        if (res < 0) ex->error = 1;
+    }
+    pthread_mutex_unlock(&ex->lock);
+    return NULL;
+}
+
+static void executor_stop(Executor *const ex, const int n_threads) {
+    pthread_mutex_lock(&ex->lock);
+    ex->die = 1;
+    pthread_cond_broadcast(&ex->cond);
+    pthread_mutex_unlock(&ex->lock);
+    for (int i = 0; i < n_threads; i++)
+        pthread_join(ex->threads[i], NULL);
+    dav1d_thread_pool_destroy(&ex->pool);
+    pthread_cond_destroy(&ex->cond);
+    pthread_mutex_destroy(&ex->lock);
+}
+
+static int executor_start(Executor *const ex) {
+    const Dav1dTaskExecutor executor = {
+        .cookie = ex, .task_available = task_available,
+    };
+
+    memset(ex, 0, sizeof(*ex));
+    if (pthread_mutex_init(&ex->lock, NULL)) return -1;
+    if (pthread_cond_init(&ex->cond, NULL)) {
+        pthread_mutex_destroy(&ex->lock);
+        return -1;
+    }
+    if (dav1d_thread_pool_create_external(&ex->pool, N_HOST_THREADS, &executor)) {
+        executor_stop(ex, 0);
+        return -1;
+    }
+    for (int i = 0; i < N_HOST_THREADS; i++)
+        if (pthread_create(&ex->threads[i], NULL, host_thread, ex)) {
+            executor_stop(ex, i);
+            return -1;
+        }
+    return 0;
+}
+
+static int get_pictures(Dav1dContext *const c, uint64_t *const hash,
+                        int *const n_out)
+{
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while (!(res = dav1d_get_picture(c, &p))) {
+        if (*n_out == N_FRAMES) {
+            dav1d_picture_unref(&p);
+            return -1;
+        }
+        hash[(*n_out)++] = synth_hash_picture(&p);
+        dav1d_picture_unref(&p);
+    }
+    return res == DAV1D_ERR(EAGAIN) ? 0 : res;
+}
+
+static int decode(const SynthStream *const stream, const Dav1dSettings *const s,
+                  uint64_t *const hash)
+{
+    Dav1dContext *c;
+    int res = 0, n_out = 0;
+
+    if (dav1d_open(&c, s)) return -1;
+
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        Dav1dData data = { 0 };
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+        if (ptr) memcpy(ptr, tu.data, tu.sz);
+        synth_tu_free(&tu);
+        if (!ptr) {
+            res = -1;
+            break;
+        }
+        do {
+            if ((res = dav1d_send_data(c, &data)) < 0 &&
+                res != DAV1D_ERR(EAGAIN))
+            {
+                dav1d_data_unref(&data);
+                break;
+            }
+            res = get_pictures(c, hash, &n_out);
+        } while (!res && data.sz);
+    }
+    if (!res) res = get_pictures(c, hash, &n_out);
+    if (!res && n_out != stream->n_frames) res = -1;
+
+    dav1d_close(&c);
+    return res;
+}
+
+/*
+ * Decoding with a pool whose tasks are run by the application must give the
+ * same output as decoding with the library's own worker threads.
+ */
+int main(void) {
+    static const int frame_delays[] = { 1, 2, 4 };
+    const SynthStream stream = {
+        .width = 640, .height = 360, .n_frames = N_FRAMES, .all_refs = 1,
+    };
+    uint64_t ref[N_FRAMES], hash[N_FRAMES];
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(frame_delays) / sizeof(*frame_delays); i++) {
+        Dav1dSettings s;
+        Executor ex;
+
+        dav1d_default_settings(&s);
+        s.n_threads = N_HOST_THREADS;
+        s.max_frame_delay = frame_delays[i];
+        if (decode(&stream, &s, ref)) {
+            fprintf(stderr, "Failed to decode reference with frame delay %d\n",
+                    s.max_frame_delay);
+            ret = 1;
+            continue;
+        }
+
+        if (executor_start(&ex)) {
+            fprintf(stderr, "Failed to create the executor\n");
+            return 1;
+        }
+        s.thread_pool = ex.pool;
+        const int res = decode(&stream, &s, hash);
+        executor_stop(&ex, N_HOST_THREADS);
+        if (res || ex.error) {
+            fprintf(stderr, "Failed to decode through the executor with frame "
+                    "delay %d\n", s.max_frame_delay);
+            ret = 1;
+        } else if (memcmp(hash, ref, sizeof(ref))) {
+            fprintf(stderr, "Mismatch through the executor with frame delay "
+                    "%d\n", s.max_frame_delay);
+            ret = 1;
+        } else if (!ex.n_tasks) {
+            fprintf(stderr, "No tasks were run through the executor with frame "
+                    "delay %d\n", s.max_frame_delay);
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 12
+// frame whose last tile group is dropped; frames refer to the last frame with
+// a multiple of 4 as index, so the following frames still decode
+#define TRUNCATED_FRAME 5
+
+typedef struct {
+    uint64_t hash[N_FRAMES];
+    int n_out, n_err;
+} Output;
+
+static int get_pictures(Dav1dContext *const c, Output *const out) {
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while ((res = dav1d_get_picture(c, &p)) != DAV1D_ERR(EAGAIN)) {
+        if (res < 0) {
+            out->n_err++;
+            continue;
+        }
+        if (out->n_out == N_FRAMES) {
+            dav1d_picture_unref(&p);
+            return -1;
+        }
+        out->hash[out->n_out++] = synth_hash_picture(&p);
+        dav1d_picture_unref(&p);
+    }
+    return 0;
+}
+
+static int send(Dav1dContext *const c, const uint8_t *const buf,
+                const size_t sz, Output *const out)
+{
+    Dav1dData data = { 0 };
+    uint8_t *const ptr = dav1d_data_create(&data, sz);
+    if (!ptr) return -1;
+    memcpy(ptr, buf, sz);
+
+    do {
+        const int res = dav1d_send_data(c, &data);
+        if (res < 0 && res != DAV1D_ERR(EAGAIN)) {
+            out->n_err++;
+            dav1d_data_unref(&data);
+        }
+        if (get_pictures(c, out)) {
+            dav1d_data_unref(&data);
+            return -1;
+        }
+    } while (data.sz);
+    return 0;
+}
+
+/*
+ * Decodes the stream, feeding it either in whole temporal units, or OBU by
+ * OBU so that frames are started before all of their tile groups arrived.
+ * The last tile group of drop_frame is left out.
+ */
+static int decode(const SynthStream *const stream, const int n_threads,
+                  const int max_frame_delay, const int per_obu,
+                  const int drop_frame, Output *const out)
+{
+    Dav1dSettings s;
+    Dav1dContext *c;
+    int res = 0;
+
+    dav1d_default_settings(&s);
+    s.n_threads = n_threads;
+    s.max_frame_delay = max_frame_delay;
+    s.early_tile_groups = per_obu;
+    if (dav1d_open(&c, &s)) return -1;
+
+    memset(out, 0, sizeof(*out));
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        if (!per_obu) {
+            res = send(c, tu.data, tu.sz, out);
+        } else {
+            for (int i = 0; !res && i < tu.n_obus; i++) {
+                if (n == drop_frame && i == tu.n_obus - 1) break;
+                res = send(c, tu.data + tu.obu_offset[i], tu.obu_sz[i], out);
+            }
+        }
+        synth_tu_free(&tu);
+    }
+    if (!res) res = get_pictures(c, out);
+
+    dav1d_close(&c);
+    return res;
+}
+
+int main(void) {
+    static const int configs[][2] = {
+        { 1, 1 }, { 2, 1 }, { 2, 2 }, { 3, 2 }, { 4, 1 }, { 4, 4 },
+    };
+    SynthStream stream = {
+        .width = 256, .height = 256, .n_frames = N_FRAMES,
+    };
+    Output ref, out;
+    int ret = 0;
+
+    if (decode(&stream, 1, 1, 0, -1, &ref) || ref.n_out != N_FRAMES || ref.n_err) {
+        fprintf(stderr, "Failed to decode reference (%d pictures, %d errors)\n",
+                ref.n_out, ref.n_err);
+        return 1;
+    }
+
+    stream.split = 1;
+    for (size_t i = 0; i < sizeof(configs) / sizeof(*configs); i++) {
+        const int n_threads = configs[i][0], max_frame_delay = configs[i][1];
+
+        if (decode(&stream, n_threads, max_frame_delay, 1, -1, &out) ||
+            out.n_err || out.n_out != N_FRAMES ||
+            memcmp(out.hash, ref.hash, sizeof(ref.hash)))
+        {
+            fprintf(stderr, "Tile groups: mismatch with %d threads, "
+                    "frame delay %d\n", n_threads, max_frame_delay);
+            ret = 1;
+        }
+
+        // the truncated frame fails, while all others are decoded as usual
+        if (decode(&stream, n_threads, max_frame_delay, 1, TRUNCATED_FRAME, &out) ||
+            !out.n_err || out.n_out != N_FRAMES - 1 ||
+            memcmp(out.hash, ref.hash, TRUNCATED_FRAME * sizeof(*ref.hash)) ||
+            memcmp(&out.hash[TRUNCATED_FRAME], &ref.hash[TRUNCATED_FRAME + 1],
+                   (N_FRAMES - 1 - TRUNCATED_FRAME) * sizeof(*ref.hash)))
+        {
+            fprintf(stderr, "Truncated tile groups: mismatch with %d threads, "
+                    "frame delay %d (%d pictures, %d errors)\n",
+                    n_threads, max_frame_delay, out.n_out, out.n_err);
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2026, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+#include "synth_stream.h"
+
+#define N_FRAMES 12
+#define TRIM_INTERVAL 4
+
+typedef struct {
+    uint64_t hash[N_FRAMES];
+    int n_out;
+    int n_trims; // number of trims which released memory
+} Output;
+
+static int get_pictures(Dav1dContext *const c, Output *const out) {
+    Dav1dPicture p = { 0 };
+    int res;
+
+    while (!(res = dav1d_get_picture(c, &p))) {
+        if (out->n_out == N_FRAMES) {
+            dav1d_picture_unref(&p);
+            return -1;
+        }
+        out->hash[out->n_out++] = synth_hash_picture(&p);
+        dav1d_picture_unref(&p);
+    }
+    return res == DAV1D_ERR(EAGAIN) ? 0 : res;
+}
+
+static size_t current_memory(Dav1dContext *const c) {
+    Dav1dMemoryStats stats;
+    return dav1d_get_memory_stats(c, &stats) ? 0 : stats.current;
+}
+
+// trims the memory of the decoder as a paused player would, draining the
+// frames still being decoded if needed
+static int trim(Dav1dContext *const c, const int n_fc,
+                const enum Dav1dTrimLevel level, Output *const out)
+{
+    const size_t before = current_memory(c);
+    int res;
+
+    for (int n = 0; (res = dav1d_trim_memory(c, level)) == DAV1D_ERR(EAGAIN); n++) {
+        if (level != DAV1D_TRIMLEVEL_FRAME_BUFFERS || n > n_fc) {
+            fprintf(stderr, "Frames still in flight after draining\n");
+            return -1;
+        }
+        if ((res = get_pictures(c, out)) < 0) return res;
+    }
+    if (res < 0) return res;
+
+    const size_t after = current_memory(c);
+    if (after > before) {
+        fprintf(stderr, "Memory use grew from %zu to %zu bytes when trimming\n",
+                before, after);
+        return -1;
+    }
+    out->n_trims += after < before;
+    return 0;
+}
+
+static int decode(const SynthStream *const stream, const Dav1dSettings *const s,
+                  const int trim_level, Output *const out)
+{
+    Dav1dContext *c;
+    int res = 0;
+
+    memset(out, 0, sizeof(*out));
+    if (dav1d_open(&c, s)) return -1;
+    const int n_fc = dav1d_get_frame_delay(s);
+
+    for (int n = 0; !res && n < stream->n_frames; n++) {
+        SynthTU tu;
+        Dav1dData data = { 0 };
+        if ((res = synth_tu(&tu, stream, n)) < 0) break;
+        uint8_t *const ptr = dav1d_data_create(&data, tu.sz);
+        if (ptr) memcpy(ptr, tu.data, tu.sz);
+        synth_tu_free(&tu);
+        if (!ptr) {
+            res = -1;
+            break;
+        }
+        do {
+            if ((res = dav1d_send_data(c, &data)) < 0 &&
+                res != DAV1D_ERR(EAGAIN))
+            {
+                dav1d_data_unref(&data);
+                break;
+            }
+            res = get_pictures(c, out);
+        } while (!res && data.sz);
+        if (!res && trim_level >= 0 && n % TRIM_INTERVAL == TRIM_INTERVAL - 1)
+            res = trim(c, n_fc, trim_level, out);
+    }
+    if (!res) res = get_pictures(c, out);
+    if (!res && out->n_out != stream->n_frames) res = -1;
+
+    dav1d_close(&c);
+    return res;
+}
+
+/*
+ * Trimming the memory of a decoder between frames releases some of it, and
+ * decoding then continues with the same output as without trimming.
+ */
+int main(void) {
+    static const struct {
+        int n_threads, max_frame_delay;
+    } configs[] = {
+        { 1, 1 }, { 4, 1 }, { 4, 4 },
+    };
+    static const enum Dav1dTrimLevel levels[] = {
+        DAV1D_TRIMLEVEL_POOLS, DAV1D_TRIMLEVEL_FRAME_BUFFERS,
+    };
+    const SynthStream stream = {
+        .width = 640, .height = 360, .n_frames = N_FRAMES, .all_refs = 1,
+    };
+    int ret = 0;
+
+    for (size_t i = 0; i < sizeof(configs) / sizeof(*configs); i++) {
+        Dav1dSettings s;
+        Output ref, out;
+
+        dav1d_default_settings(&s);
+        s.n_threads = configs[i].n_threads;
+        s.max_frame_delay = configs[i].max_frame_delay;
+        if (decode(&stream, &s, -1, &ref)) {
+            fprintf(stderr, "Failed to decode reference with %d threads, "
+                    "frame delay %d\n", s.n_threads, s.max_frame_delay);
+            ret = 1;
+            continue;
+        }
+
+        for (size_t j = 0; j < sizeof(levels) / sizeof(*levels); j++) {
+            if (decode(&stream, &s, levels[j], &out) ||
+                memcmp(out.hash, ref.hash, sizeof(ref.hash)))
+            {
+                fprintf(stderr, "Mismatch when trimming to level %d with %d "
+                        "threads, frame delay %d\n", levels[j], s.n_threads,
+                        s.max_frame_delay);
+                ret = 1;
+            } else if (!out.n_trims) {
+                fprintf(stderr, "No memory released when trimming to level %d "
+                        "with %d threads, frame delay %d\n", levels[j],
+                        s.n_threads, s.max_frame_delay);
+                ret = 1;
+            }
+        }
+    }
+
+    return ret;
+}
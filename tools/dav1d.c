@@ -187,6 +187,36 @@ static void signal_handler(const int s) {
     signal_terminate = 1;
 }
 
+#if CONFIG_TRACE
+static void trace_task(void *const cookie, const Dav1dTaskTraceEvent *const ev) {
+    static const char *const names[] = {
+        [DAV1D_TASKTRACE_INIT]                    = "init",
+        [DAV1D_TASKTRACE_INIT_CDF]                = "init_cdf",
+        [DAV1D_TASKTRACE_TILE_ENTROPY]            = "tile_entropy",
+        [DAV1D_TASKTRACE_ENTROPY_PROGRESS]        = "entropy_progress",
+        [DAV1D_TASKTRACE_TILE_RECONSTRUCTION]     = "tile_reconstruction",
+        [DAV1D_TASKTRACE_DEBLOCK_COLS]            = "deblock_cols",
+        [DAV1D_TASKTRACE_DEBLOCK_ROWS]            = "deblock_rows",
+        [DAV1D_TASKTRACE_CDEF]                    = "cdef",
+        [DAV1D_TASKTRACE_SUPER_RESOLUTION]        = "super_resolution",
+        [DAV1D_TASKTRACE_LOOP_RESTORATION]        = "loop_restoration",
+        [DAV1D_TASKTRACE_RECONSTRUCTION_PROGRESS] = "reconstruction_progress",
+        [DAV1D_TASKTRACE_FG_PREP]                 = "fg_prep",
+        [DAV1D_TASKTRACE_FG_APPLY]                = "fg_apply",
+    };
+
+    // a single fprintf() per event, stdio locking keeps the worker threads
+    // from interleaving their output
+    fprintf((FILE *) cookie,
+            "{\"name\":\"%s\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,"
+            "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame_idx\":%d,\"sby\":%d,"
+            "\"timestamp\":%" PRId64 "}},\n",
+            names[ev->type], ev->thread_id, ev->start / 1000.0,
+            (ev->end - ev->start) / 1000.0, (int) ev->frame_idx, ev->sby,
+            ev->timestamp);
+}
+#endif
+
 int main(const int argc, char *const *const argv) {
     const int istty = isatty(fileno(stderr));
     int res = 0;
@@ -201,6 +231,7 @@ int main(const int argc, char *const *const argv) {
     uint64_t nspf, tfirst, elapsed;
     double i_fps;
     FILE *frametimes = NULL;
+    FILE *trace = NULL;
     const unsigned version = dav1d_version_api();
     const int major = DAV1D_API_MAJOR(version);
     const int minor = DAV1D_API_MINOR(version);
@@ -224,7 +255,7 @@ int main(const int argc, char *const *const argv) {
 
     if ((res = input_open(&in, cli_settings.demuxer,
                           cli_settings.inputfile,
-                          fps, &total, timebase)) < 0)
+                          fps, &total, timebase, cli_settings.mmap)) < 0)
     {
         return EXIT_FAILURE;
     }
@@ -259,8 +290,23 @@ int main(const int argc, char *const *const argv) {
     if (cli_settings.limit != 0 && cli_settings.limit < total)
         total = cli_settings.limit;
 
-    if ((res = dav1d_open(&c, &lib_settings)))
+#if CONFIG_TRACE
+    if (cli_settings.trace) {
+        if (!(trace = fopen(cli_settings.trace, "w"))) {
+            fprintf(stderr, "Failed to open %s for writing\n", cli_settings.trace);
+            input_close(in);
+            return EXIT_FAILURE;
+        }
+        fprintf(trace, "[\n");
+        lib_settings.tracer.cookie = trace;
+        lib_settings.tracer.callback = trace_task;
+    }
+#endif
+
+    if ((res = dav1d_open(&c, &lib_settings))) {
+        if (trace) fclose(trace);
         return EXIT_FAILURE;
+    }
 
     if (cli_settings.frametimes)
         frametimes = fopen(cli_settings.frametimes, "w");
@@ -389,5 +435,12 @@ int main(const int argc, char *const *const argv) {
     }
     dav1d_close(&c);
 
+    if (trace) {
+        // metadata event without trailing comma to terminate the array
+        fprintf(trace, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,"
+                "\"args\":{\"name\":\"dav1d\"}}\n]\n");
+        fclose(trace);
+    }
+
     return (res == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,463 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+# include <windows.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+#include "dav1d/dav1d.h"
+
+#include "input/input.h"
+
+#define MAX_THREAD_CONFIGS 16
+#define N_STAGES (DAV1D_TASKTRACE_FG_APPLY + 1)
+
+typedef struct {
+    uint8_t *buf;
+    size_t sz;
+} Packet;
+
+typedef struct {
+    int n_threads;
+    int frame_delay;
+    unsigned n_frames;
+    uint64_t total_ns;
+    uint64_t *latency; // per output frame, in ns
+    size_t n_latency, n_latency_alloc;
+    uint64_t parse_ns;
+    uint64_t stage_ns[N_STAGES];
+    size_t peak_memory; // highest over all iterations, in bytes
+    size_t huge_page_memory; // highest backed by huge pages, in bytes
+} RunStats;
+
+static const char *const stage_names[N_STAGES] = {
+    [DAV1D_TASKTRACE_INIT]                    = "init",
+    [DAV1D_TASKTRACE_INIT_CDF]                = "init_cdf",
+    [DAV1D_TASKTRACE_TILE_ENTROPY]            = "tile_entropy",
+    [DAV1D_TASKTRACE_ENTROPY_PROGRESS]        = "entropy_progress",
+    [DAV1D_TASKTRACE_TILE_RECONSTRUCTION]     = "tile_reconstruction",
+    [DAV1D_TASKTRACE_DEBLOCK_COLS]            = "deblock_cols",
+    [DAV1D_TASKTRACE_DEBLOCK_ROWS]            = "deblock_rows",
+    [DAV1D_TASKTRACE_CDEF]                    = "cdef",
+    [DAV1D_TASKTRACE_SUPER_RESOLUTION]        = "super_resolution",
+    [DAV1D_TASKTRACE_LOOP_RESTORATION]        = "loop_restoration",
+    [DAV1D_TASKTRACE_RECONSTRUCTION_PROGRESS] = "reconstruction_progress",
+    [DAV1D_TASKTRACE_FG_PREP]                 = "fg_prep",
+    [DAV1D_TASKTRACE_FG_APPLY]                = "fg_apply",
+};
+
+static uint64_t get_time_nanos(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER t;
+    QueryPerformanceCounter(&t);
+    uint64_t seconds = t.QuadPart / frequency.QuadPart;
+    uint64_t fractions = t.QuadPart % frequency.QuadPart;
+    return 1000000000 * seconds + 1000000000 * fractions / frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1000000000ULL * ts.tv_sec + ts.tv_nsec;
+#elif defined(__APPLE__)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return mach_absolute_time() * info.numer / info.denom;
+#endif
+}
+
+static void free_noop(const uint8_t *const data, void *const cookie) {
+}
+
+static void usage(const char *const app, const char *const reason, ...) {
+    if (reason) {
+        va_list args;
+
+        va_start(args, reason);
+        vfprintf(stderr, reason, args);
+        va_end(args);
+        fprintf(stderr, "\n\n");
+    }
+    fprintf(stderr, "Usage: %s [options]\n\n", app);
+    fprintf(stderr, "Supported options:\n"
+            " --input/-i $file:      input file\n"
+            " --output/-o $file:     write JSON results to file (default: stdout)\n"
+            " --demuxer $name:       force demuxer type ('ivf', 'section5' or 'annexb'; default: detect from content)\n"
+            " --limit/-l $num:       only load the first $num packets\n"
+            " --iterations/-n $num:  number of times to decode the input per configuration (default: 3)\n"
+            " --threads $list:       comma-separated list of thread counts to benchmark (default: 1,0)\n"
+            " --framedelay $num:     maximum frame delay (default: 0)\n"
+            " --filmgrain $num:      enable film grain application (default: 1)\n"
+            " --hugepages $num:      use huge pages for pictures and frame buffers (default: 0)\n"
+            "\n"
+            "Per-stage timings are summed over all threads.\n");
+    exit(1);
+}
+
+static unsigned parse_unsigned(const char *const app, const char *const optarg,
+                               const char *const optname)
+{
+    char *end;
+    const unsigned long res = strtoul(optarg, &end, 0);
+    if (*end || end == optarg || res > UINT_MAX)
+        usage(app, "Invalid argument \"%s\" for option %s; should be an integer",
+              optarg, optname);
+    return (unsigned) res;
+}
+
+static int load_packets(const char *const demuxer, const char *const filename,
+                        const unsigned limit, Packet **const pkts_out,
+                        unsigned *const n_pkts_out)
+{
+    DemuxerContext *in;
+    unsigned fps[2], total, timebase[2];
+    if (input_open(&in, demuxer, filename, fps, &total, timebase, 0) < 0)
+        return -1;
+
+    Packet *pkts = NULL;
+    unsigned n_pkts = 0, n_alloc = 0;
+    Dav1dData data;
+    while ((!limit || n_pkts < limit) && !input_read(in, &data)) {
+        if (n_pkts == n_alloc) {
+            n_alloc = n_alloc ? n_alloc * 2 : 256;
+            Packet *const tmp = realloc(pkts, n_alloc * sizeof(*pkts));
+            if (!tmp) goto error;
+            pkts = tmp;
+        }
+        Packet *const pkt = &pkts[n_pkts];
+        if (!(pkt->buf = malloc(data.sz))) goto error;
+        memcpy(pkt->buf, data.data, data.sz);
+        pkt->sz = data.sz;
+        n_pkts++;
+        dav1d_data_unref(&data);
+    }
+    input_close(in);
+
+    *pkts_out = pkts;
+    *n_pkts_out = n_pkts;
+    return 0;
+
+error:
+    dav1d_data_unref(&data);
+    input_close(in);
+    for (unsigned n = 0; n < n_pkts; n++)
+        free(pkts[n].buf);
+    free(pkts);
+    return -1;
+}
+
+static int add_latency(RunStats *const st, const uint64_t latency) {
+    if (st->n_latency == st->n_latency_alloc) {
+        const size_t n_alloc = st->n_latency_alloc ? st->n_latency_alloc * 2 : 1024;
+        uint64_t *const tmp = realloc(st->latency, n_alloc * sizeof(*tmp));
+        if (!tmp) return -1;
+        st->latency = tmp;
+        st->n_latency_alloc = n_alloc;
+    }
+    st->latency[st->n_latency++] = latency;
+    return 0;
+}
+
+// decodes all packets once, from memory, without copying the input
+static int decode_run(const Packet *const pkts, const unsigned n_pkts,
+                      const Dav1dSettings *const s, uint64_t *const send_time,
+                      RunStats *const st)
+{
+    Dav1dContext *c;
+    Dav1dData data = { 0 };
+    Dav1dPicture p;
+    unsigned n = 0;
+    int res;
+
+    if (dav1d_open(&c, s) < 0) return -1;
+
+    const uint64_t tstart = get_time_nanos();
+    for (;;) {
+        if (!data.sz && n < n_pkts) {
+            if (dav1d_data_wrap(&data, pkts[n].buf, pkts[n].sz, free_noop, NULL) < 0)
+                goto error;
+            data.m.timestamp = n;
+            send_time[n++] = get_time_nanos();
+        }
+        if (data.sz) {
+            res = dav1d_send_data(c, &data);
+            if (res < 0 && res != DAV1D_ERR(EAGAIN)) {
+                fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+                goto error;
+            }
+        }
+
+        memset(&p, 0, sizeof(p));
+        res = dav1d_get_picture(c, &p);
+        if (!res) {
+            const uint64_t now = get_time_nanos();
+            const int64_t idx = p.m.timestamp;
+            if (idx >= 0 && idx < n_pkts &&
+                add_latency(st, now - send_time[idx]) < 0)
+            {
+                dav1d_picture_unref(&p);
+                goto error;
+            }
+            st->n_frames++;
+            dav1d_picture_unref(&p);
+        } else if (res != DAV1D_ERR(EAGAIN)) {
+            fprintf(stderr, "Error decoding frame: %s\n", strerror(DAV1D_ERR(res)));
+            goto error;
+        } else if (!data.sz && n == n_pkts) {
+            break; // fully drained
+        }
+    }
+    st->total_ns += get_time_nanos() - tstart;
+    Dav1dStageTimes times;
+    if (!dav1d_get_stage_times(c, &times)) {
+        st->parse_ns += times.parse;
+        for (int i = 0; i < N_STAGES; i++)
+            st->stage_ns[i] += times.task[i];
+    }
+    Dav1dMemoryStats mem;
+    if (!dav1d_get_memory_stats(c, &mem) && mem.peak > st->peak_memory)
+        st->peak_memory = mem.peak;
+    Dav1dHugePageUsage huge;
+    if (!dav1d_get_huge_page_usage(&huge) && huge.backed > st->huge_page_memory)
+        st->huge_page_memory = huge.backed;
+    dav1d_close(&c);
+    return 0;
+
+error:
+    if (data.sz) dav1d_data_unref(&data);
+    dav1d_close(&c);
+    return -1;
+}
+
+static int cmp_u64(const void *const a, const void *const b) {
+    const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(const uint64_t *const v, const size_t n, const double q) {
+    if (!n) return 0.0;
+    size_t idx = (size_t)(q * n);
+    if (idx >= n) idx = n - 1;
+    return v[idx] / 1e6;
+}
+
+static void write_run(FILE *const f, const RunStats *const st, const int last) {
+    qsort(st->latency, st->n_latency, sizeof(*st->latency), cmp_u64);
+    uint64_t sum = 0;
+    for (size_t n = 0; n < st->n_latency; n++)
+        sum += st->latency[n];
+    const double total_s = st->total_ns / 1e9;
+
+    fprintf(f, "    {\n"
+            "      \"threads\": %d,\n"
+            "      \"frame_delay\": %d,\n"
+            "      \"frames\": %u,\n"
+            "      \"total_ms\": %.3f,\n"
+            "      \"fps\": %.3f,\n"
+            "      \"peak_memory_bytes\": %.0f,\n"
+            "      \"huge_page_bytes\": %.0f,\n"
+            "      \"latency_ms\": {\n"
+            "        \"mean\": %.3f,\n"
+            "        \"p50\": %.3f,\n"
+            "        \"p90\": %.3f,\n"
+            "        \"p99\": %.3f,\n"
+            "        \"max\": %.3f\n"
+            "      },\n",
+            st->n_threads, st->frame_delay, st->n_frames, st->total_ns / 1e6,
+            total_s > 0.0 ? st->n_frames / total_s : 0.0, (double) st->peak_memory,
+            (double) st->huge_page_memory,
+            st->n_latency ? sum / 1e6 / st->n_latency : 0.0,
+            percentile_ms(st->latency, st->n_latency, 0.50),
+            percentile_ms(st->latency, st->n_latency, 0.90),
+            percentile_ms(st->latency, st->n_latency, 0.99),
+            percentile_ms(st->latency, st->n_latency, 1.00));
+    fprintf(f, "      \"stages_ms\": {\n"
+            "        \"obu_parse\": %.3f,\n", st->parse_ns / 1e6);
+    for (int n = 0; n < N_STAGES; n++)
+        fprintf(f, "        \"%s\": %.3f%s\n", stage_names[n],
+                st->stage_ns[n] / 1e6, n + 1 < N_STAGES ? "," : "");
+    fprintf(f, "      }\n");
+    fprintf(f, "    }%s\n", last ? "" : ",");
+}
+
+enum {
+    ARG_DEMUXER = 256,
+    ARG_THREADS,
+    ARG_FRAME_DELAY,
+    ARG_FILM_GRAIN,
+    ARG_HUGE_PAGES,
+};
+
+static const struct option long_opts[] = {
+    { "input",      1, NULL, 'i' },
+    { "output",     1, NULL, 'o' },
+    { "demuxer",    1, NULL, ARG_DEMUXER },
+    { "limit",      1, NULL, 'l' },
+    { "iterations", 1, NULL, 'n' },
+    { "threads",    1, NULL, ARG_THREADS },
+    { "framedelay", 1, NULL, ARG_FRAME_DELAY },
+    { "filmgrain",  1, NULL, ARG_FILM_GRAIN },
+    { "hugepages",  1, NULL, ARG_HUGE_PAGES },
+    { NULL,         0, NULL, 0 },
+};
+
+int main(const int argc, char *const *const argv) {
+    const char *inputfile = NULL, *outputfile = NULL, *demuxer = NULL;
+    const char *threads = "1,0";
+    unsigned limit = 0, iterations = 3, frame_delay = 0, film_grain = 1;
+    unsigned huge_pages = 0;
+    int thread_cfg[MAX_THREAD_CONFIGS], n_thread_cfg = 0;
+    int o;
+
+    while ((o = getopt_long(argc, argv, "i:o:l:n:", long_opts, NULL)) != -1) {
+        switch (o) {
+        case 'i': inputfile = optarg; break;
+        case 'o': outputfile = optarg; break;
+        case 'l': limit = parse_unsigned(argv[0], optarg, "--limit"); break;
+        case 'n': iterations = parse_unsigned(argv[0], optarg, "--iterations"); break;
+        case ARG_DEMUXER: demuxer = optarg; break;
+        case ARG_THREADS: threads = optarg; break;
+        case ARG_FRAME_DELAY:
+            frame_delay = parse_unsigned(argv[0], optarg, "--framedelay");
+            break;
+        case ARG_FILM_GRAIN:
+            film_grain = !!parse_unsigned(argv[0], optarg, "--filmgrain");
+            break;
+        case ARG_HUGE_PAGES:
+            huge_pages = !!parse_unsigned(argv[0], optarg, "--hugepages");
+            break;
+        default:
+            usage(argv[0], NULL);
+        }
+    }
+    if (optind < argc)
+        usage(argv[0], "Extra/unused arguments found, e.g. '%s'\n", argv[optind]);
+    if (!inputfile)
+        usage(argv[0], "Input file (-i/--input) is required");
+    if (!iterations)
+        usage(argv[0], "At least one iteration (-n/--iterations) is required");
+    if (frame_delay > DAV1D_MAX_FRAME_DELAY)
+        usage(argv[0], "Frame delay (--framedelay) must be at most %d", DAV1D_MAX_FRAME_DELAY);
+
+    for (const char *str = threads; *str;) {
+        char *end;
+        const long n = strtol(str, &end, 10);
+        if (end == str || n < 0 || n > DAV1D_MAX_THREADS ||
+            (*end && *end != ',') || n_thread_cfg == MAX_THREAD_CONFIGS)
+        {
+            usage(argv[0], "Invalid argument \"%s\" for option --threads; should be "
+                  "a comma-separated list of up to %d thread counts (0 - %d)",
+                  threads, MAX_THREAD_CONFIGS, DAV1D_MAX_THREADS);
+        }
+        thread_cfg[n_thread_cfg++] = (int) n;
+        str = *end ? end + 1 : end;
+    }
+    if (!n_thread_cfg)
+        usage(argv[0], "At least one thread count (--threads) is required");
+
+    Packet *pkts;
+    unsigned n_pkts;
+    if (load_packets(demuxer, inputfile, limit, &pkts, &n_pkts) < 0)
+        return EXIT_FAILURE;
+    if (!n_pkts) {
+        fprintf(stderr, "No data in %s\n", inputfile);
+        return EXIT_FAILURE;
+    }
+
+    int res = 0;
+    RunStats stats[MAX_THREAD_CONFIGS] = { 0 };
+    uint64_t *const send_time = malloc(n_pkts * sizeof(*send_time));
+    if (!send_time) {
+        res = -1;
+        goto end;
+    }
+
+    for (int t = 0; t < n_thread_cfg && !res; t++) {
+        RunStats *const st = &stats[t];
+        Dav1dSettings s;
+        dav1d_default_settings(&s);
+        s.n_threads = thread_cfg[t];
+        s.max_frame_delay = frame_delay;
+        s.apply_grain = film_grain;
+        s.huge_pages = huge_pages;
+        s.stage_times = 1;
+        st->n_threads = s.n_threads;
+        st->frame_delay = dav1d_get_frame_delay(&s);
+
+        // warm-up run, so that the first iteration doesn't pay for page
+        // faults and lazy initialization
+        RunStats warmup = { 0 };
+        res = decode_run(pkts, n_pkts, &s, send_time, &warmup);
+        free(warmup.latency);
+        for (unsigned i = 0; i < iterations && !res; i++)
+            res = decode_run(pkts, n_pkts, &s, send_time, st);
+
+        fprintf(stderr, "threads %d: %u frames in %.3f ms\n", st->n_threads,
+                st->n_frames, st->total_ns / 1e6);
+    }
+
+    if (!res) {
+        FILE *const f = outputfile ? fopen(outputfile, "w") : stdout;
+        if (!f) {
+            fprintf(stderr, "Failed to open %s for writing\n", outputfile);
+            res = -1;
+            goto end;
+        }
+        fprintf(f, "{\n"
+                "  \"version\": \"%s\",\n"
+                "  \"packets\": %u,\n"
+                "  \"iterations\": %u,\n"
+                "  \"runs\": [\n",
+                dav1d_version(), n_pkts, iterations);
+        for (int t = 0; t < n_thread_cfg; t++)
+            write_run(f, &stats[t], t + 1 == n_thread_cfg);
+        fprintf(f, "  ]\n}\n");
+        if (f != stdout) fclose(f);
+    }
+
+end:
+    for (int t = 0; t < n_thread_cfg; t++)
+        free(stats[t].latency);
+    free(send_time);
+    for (unsigned n = 0; n < n_pkts; n++)
+        free(pkts[n].buf);
+    free(pkts);
+
+    return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -63,6 +63,17 @@ enum {
     ARG_OUTPUT_INVISIBLE,
     ARG_INLOOP_FILTERS,
     ARG_DECODE_FRAME_TYPE,
+    ARG_TRACE,
+    ARG_MMAP,
+    ARG_DOWNSCALE,
+    ARG_THREAD_PLACEMENT,
+    ARG_THREAD_CPUS,
+    ARG_THREAD_PINNING,
+    ARG_THREAD_PRIORITY,
+    ARG_LATENCY_MS,
+    ARG_LATENCY_FRAMES,
+    ARG_MIN_FPS,
+    ARG_EARLY_TILE_GROUPS,
 };
 
 static const struct option long_opts[] = {
@@ -90,6 +101,17 @@ static const struct option long_opts[] = {
     { "outputinvisible", 1, NULL, ARG_OUTPUT_INVISIBLE },
     { "inloopfilters",   1, NULL, ARG_INLOOP_FILTERS },
     { "decodeframetype", 1, NULL, ARG_DECODE_FRAME_TYPE },
+    { "trace",           1, NULL, ARG_TRACE },
+    { "mmap",            0, NULL, ARG_MMAP },
+    { "downscale",       1, NULL, ARG_DOWNSCALE },
+    { "threadplacement", 1, NULL, ARG_THREAD_PLACEMENT },
+    { "threadcpus",      1, NULL, ARG_THREAD_CPUS },
+    { "threadpinning",   1, NULL, ARG_THREAD_PINNING },
+    { "threadpriority",  1, NULL, ARG_THREAD_PRIORITY },
+    { "latencyms",       1, NULL, ARG_LATENCY_MS },
+    { "latencyframes",   1, NULL, ARG_LATENCY_FRAMES },
+    { "minfps",          1, NULL, ARG_MIN_FPS },
+    { "earlytilegroups", 1, NULL, ARG_EARLY_TILE_GROUPS },
     { NULL,              0, NULL, 0 },
 };
 
@@ -128,6 +150,7 @@ static void usage(const char *const app, const char *const reason, ...) {
             " --input/-i $file:     input file\n"
             " --output/-o $file:    output file (%%n, %%w or %%h will be filled in for per-frame files)\n"
             " --demuxer $name:      force demuxer type ('ivf', 'section5' or 'annexb'; default: detect from content)\n"
+            " --mmap:               memory-map the input file and pass frame data to the decoder without copying\n"
             " --muxer $name:        force muxer type (" AVAILABLE_MUXERS "; default: detect from extension)\n"
             "                       use 'frame' as prefix to write per-frame files; if filename contains %%n, will default to writing per-frame files\n"
             " --quiet/-q:           disable status messages\n"
@@ -153,6 +176,17 @@ static void usage(const char *const app, const char *const reason, ...) {
             " --outputinvisible $num: whether to output invisible (alt-ref) frames (default: 0)\n"
             " --inloopfilters $str: which in-loop filters to enable (none, (no)deblock, (no)cdef, (no)restoration or all; default: all)\n"
             " --decodeframetype $str: which frame types to decode (reference, intra, key or all; default: all)\n"
+            " --downscale $num:     output pictures downscaled by 2^$num (0 - 3; default: 0), film grain is not applied\n"
+            " --threadplacement $str: pin worker threads per NUMA node or L3 cache (none, numa or l3; default: none)\n"
+            " --threadcpus $list:   CPUs worker threads may run on, e.g. 0-3,8 (default: any)\n"
+            " --threadpinning $str: pin each worker thread to a single CPU (none or cpu; default: none)\n"
+            " --threadpriority $str: worker thread priority (default, low or idle; default: default)\n"
+            " --latencyms $num:     adapt the frame delay to output pictures within $num ms (default: 0)\n"
+            " --latencyframes $num: adapt the frame delay to output pictures within $num frames (default: 0)\n"
+            " --minfps $num:        throughput floor when adapting the frame delay (default: 0)\n"
+            " --earlytilegroups $num: start decoding a frame before all of its tile groups were received (default: 0)\n"
+            " --trace $file:        dump the timing of each decoding task to file in Chrome trace-event format;\n"
+            "                       requires a library built with -Dtrace=true\n"
             );
     exit(1);
 }
@@ -186,6 +220,32 @@ static unsigned parse_unsigned(const char *const optarg, const int option,
     return res;
 }
 
+// parses a list of CPU indices and ranges, e.g. "0-3,8"
+static int parse_cpu_list(const char *const optarg, const int option,
+                          const char *const app, int *const cpus, const int max)
+{
+    int n = 0;
+    for (const char *p = optarg;;) {
+        char *end;
+        const unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (end == p) error(app, optarg, option, "a list of CPUs");
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+            if (end == p || last < first) error(app, optarg, option, "a list of CPUs");
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++) {
+            if (n == max || cpu > INT_MAX) error(app, optarg, option, "a list of CPUs");
+            cpus[n++] = (int) cpu;
+        }
+        if (!*end) break;
+        if (*end != ',') error(app, optarg, option, "a list of CPUs");
+        p = end + 1;
+    }
+    return n;
+}
+
 static int parse_optional_fraction(const char *const optarg, const int option,
                                    const char *const app, double *value)
 {
@@ -282,6 +342,23 @@ static const EnumParseTable decode_frame_type_tbl[] = {
     { "key",           DAV1D_DECODEFRAMETYPE_KEY },
 };
 
+static const EnumParseTable thread_placement_tbl[] = {
+    { "none",          DAV1D_THREADPLACEMENT_NONE },
+    { "numa",          DAV1D_THREADPLACEMENT_NUMA },
+    { "l3",            DAV1D_THREADPLACEMENT_L3 },
+};
+
+static const EnumParseTable thread_pinning_tbl[] = {
+    { "none",          DAV1D_THREADPINNING_NONE },
+    { "cpu",           DAV1D_THREADPINNING_CPU },
+};
+
+static const EnumParseTable thread_priority_tbl[] = {
+    { "default",       DAV1D_THREADPRIORITY_DEFAULT },
+    { "low",           DAV1D_THREADPRIORITY_LOW },
+    { "idle",          DAV1D_THREADPRIORITY_IDLE },
+};
+
 #define ARRAY_SIZE(n) (sizeof(n)/sizeof(*(n)))
 
 static unsigned parse_enum(char *optarg, const EnumParseTable *const tbl,
@@ -355,6 +432,13 @@ void parse(const int argc, char *const *const argv,
         case ARG_FRAME_TIMES:
             cli_settings->frametimes = optarg;
             break;
+        case ARG_TRACE:
+#if CONFIG_TRACE
+            cli_settings->trace = optarg;
+#else
+            usage(argv[0], "Task tracing (--trace) requires building with -Dtrace=true");
+#endif
+            break;
         case ARG_REALTIME:
             // workaround to parse an optional argument of the form `--a b`
             // (getopt only allows `--a=b`)
@@ -416,6 +500,9 @@ void parse(const int argc, char *const *const argv,
             dav1d_set_cpu_flags_mask(parse_enum(optarg, cpu_mask_tbl, ARRAY_SIZE(cpu_mask_tbl),
                                                 ARG_CPU_MASK, argv[0]));
             break;
+        case ARG_MMAP:
+            cli_settings->mmap = 1;
+            break;
         case ARG_NEG_STRIDE:
             cli_settings->neg_stride = 1;
             break;
@@ -433,6 +520,49 @@ void parse(const int argc, char *const *const argv,
                 parse_enum(optarg, decode_frame_type_tbl,
                            ARRAY_SIZE(decode_frame_type_tbl), ARG_DECODE_FRAME_TYPE, argv[0]);
             break;
+        case ARG_THREAD_PLACEMENT:
+            lib_settings->thread_placement =
+                parse_enum(optarg, thread_placement_tbl,
+                           ARRAY_SIZE(thread_placement_tbl), ARG_THREAD_PLACEMENT, argv[0]);
+            break;
+        case ARG_THREAD_CPUS: {
+            static int thread_cpus[1024];
+            lib_settings->n_thread_cpus =
+                parse_cpu_list(optarg, ARG_THREAD_CPUS, argv[0], thread_cpus,
+                               ARRAY_SIZE(thread_cpus));
+            lib_settings->thread_cpus = thread_cpus;
+            break;
+        }
+        case ARG_THREAD_PINNING:
+            lib_settings->thread_pinning =
+                parse_enum(optarg, thread_pinning_tbl,
+                           ARRAY_SIZE(thread_pinning_tbl), ARG_THREAD_PINNING, argv[0]);
+            break;
+        case ARG_THREAD_PRIORITY:
+            lib_settings->thread_priority =
+                parse_enum(optarg, thread_priority_tbl,
+                           ARRAY_SIZE(thread_priority_tbl), ARG_THREAD_PRIORITY, argv[0]);
+            break;
+        case ARG_LATENCY_MS:
+            lib_settings->latency_target_ms =
+                parse_unsigned(optarg, ARG_LATENCY_MS, argv[0]);
+            break;
+        case ARG_LATENCY_FRAMES:
+            lib_settings->latency_target_frames =
+                parse_unsigned(optarg, ARG_LATENCY_FRAMES, argv[0]);
+            break;
+        case ARG_MIN_FPS:
+            lib_settings->min_fps =
+                parse_unsigned(optarg, ARG_MIN_FPS, argv[0]);
+            break;
+        case ARG_EARLY_TILE_GROUPS:
+            lib_settings->early_tile_groups =
+                !!parse_unsigned(optarg, ARG_EARLY_TILE_GROUPS, argv[0]);
+            break;
+        case ARG_DOWNSCALE:
+            lib_settings->output_downscale =
+                parse_unsigned(optarg, ARG_DOWNSCALE, argv[0]);
+            break;
         default:
             usage(argv[0], NULL);
         }
@@ -36,6 +36,7 @@ typedef struct {
     const char *demuxer;
     const char *muxer;
     const char *frametimes;
+    const char *trace;
     const char *verify;
     unsigned limit, skip;
     int quiet;
@@ -47,6 +48,7 @@ typedef struct {
     double realtime_fps;
     unsigned realtime_cache;
     int neg_stride;
+    int mmap;
 } CLISettings;
 
 void parse(const int argc, char *const *const argv,
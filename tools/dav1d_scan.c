@@ -0,0 +1,286 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Scans an AV1 stream, parsing only OBU and frame headers, and writes a seek
+ * index with one entry per frame header. Each entry is 24 bytes, all values
+ * little-endian:
+ *
+ *   offset  8  stream offset of the temporal unit (-1 if unknown)
+ *   pts     8  timestamp of the temporal unit, or its index if the
+ *              demuxer provides none
+ *   type    1  frame type (0: key, 1: inter, 2: intra, 3: switch), for a
+ *              shown existing frame the type of the shown frame
+ *   flags   1  SCAN_FLAG_*
+ *   refresh 1  reference slots updated by the frame
+ *   slot    1  reference slot shown by a shown existing frame
+ *   tid     1  temporal id
+ *   sid     1  spatial id
+ *   -       2  reserved
+ *
+ * preceded by the 8-byte magic "DAV1DIDX" and a 32-bit version. Decoding
+ * can start at the temporal unit of any entry with a key frame type which
+ * is not a shown existing frame.
+ */
+
+#include "config.h"
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dav1d/dav1d.h"
+
+#include "input/input.h"
+
+#define SCAN_INDEX_VERSION 1
+#define SCAN_ENTRY_SIZE 24
+
+enum {
+    SCAN_FLAG_SHOW_EXISTING = 1 << 0,
+    SCAN_FLAG_SHOW_FRAME    = 1 << 1,
+    SCAN_FLAG_SHOWABLE      = 1 << 2,
+};
+
+static const char frame_type_chars[4] = { 'K', 'P', 'I', 'S' };
+
+static void usage(const char *const app, const char *const reason, ...) {
+    if (reason) {
+        va_list args;
+
+        va_start(args, reason);
+        vfprintf(stderr, reason, args);
+        va_end(args);
+        fprintf(stderr, "\n\n");
+    }
+    fprintf(stderr, "Usage: %s [options]\n\n", app);
+    fprintf(stderr, "Supported options:\n"
+            " --input/-i $file:     input file\n"
+            " --output/-o $file:    write the binary seek index to file\n"
+            " --demuxer $name:      force demuxer type ('ivf', 'section5' or 'annexb'; default: detect from content)\n"
+            " --mmap:               memory-map the input file instead of reading it\n"
+            " --limit/-l $num:      stop after $num temporal units\n"
+            " --verbose/-v:         print the index entries to stdout\n");
+    exit(1);
+}
+
+static unsigned parse_unsigned(const char *const app, const char *const optarg,
+                               const char *const optname)
+{
+    char *end;
+    const unsigned long res = strtoul(optarg, &end, 0);
+    if (*end || end == optarg || res > UINT_MAX)
+        usage(app, "Invalid argument \"%s\" for option %s; should be an integer",
+              optarg, optname);
+    return (unsigned) res;
+}
+
+static void wl64(uint8_t *const p, const uint64_t v) {
+    for (int n = 0; n < 8; n++)
+        p[n] = (uint8_t) (v >> (n * 8));
+}
+
+static int write_entry(FILE *const f, const int64_t offset, const int64_t pts,
+                       const int frame_type, const int flags,
+                       const Dav1dFrameInfo *const info)
+{
+    uint8_t e[SCAN_ENTRY_SIZE] = { 0 };
+    wl64(&e[0], (uint64_t) offset);
+    wl64(&e[8], (uint64_t) pts);
+    e[16] = (uint8_t) frame_type;
+    e[17] = (uint8_t) flags;
+    e[18] = info->refresh_frame_flags;
+    e[19] = (uint8_t) info->existing_frame_idx;
+    e[20] = (uint8_t) info->temporal_id;
+    e[21] = (uint8_t) info->spatial_id;
+    return fwrite(e, sizeof(e), 1, f) == 1 ? 0 : -1;
+}
+
+enum {
+    ARG_DEMUXER = 256,
+    ARG_MMAP,
+};
+
+static const struct option long_opts[] = {
+    { "input",   1, NULL, 'i' },
+    { "output",  1, NULL, 'o' },
+    { "demuxer", 1, NULL, ARG_DEMUXER },
+    { "mmap",    0, NULL, ARG_MMAP },
+    { "limit",   1, NULL, 'l' },
+    { "verbose", 0, NULL, 'v' },
+    { NULL,      0, NULL, 0 },
+};
+
+int main(const int argc, char *const *const argv) {
+    const char *inputfile = NULL, *outputfile = NULL, *demuxer = NULL;
+    unsigned limit = 0;
+    int use_mmap = 0, verbose = 0;
+    int o;
+
+    while ((o = getopt_long(argc, argv, "i:o:l:v", long_opts, NULL)) != -1) {
+        switch (o) {
+        case 'i': inputfile = optarg; break;
+        case 'o': outputfile = optarg; break;
+        case 'l': limit = parse_unsigned(argv[0], optarg, "--limit"); break;
+        case 'v': verbose = 1; break;
+        case ARG_DEMUXER: demuxer = optarg; break;
+        case ARG_MMAP: use_mmap = 1; break;
+        default:
+            usage(argv[0], NULL);
+        }
+    }
+    if (optind < argc)
+        usage(argv[0], "Extra/unused arguments found, e.g. '%s'\n", argv[optind]);
+    if (!inputfile)
+        usage(argv[0], "Input file (-i/--input) is required");
+    if (!outputfile && !verbose)
+        usage(argv[0], "Output file (-o/--output) or --verbose is required");
+
+    DemuxerContext *in;
+    unsigned fps[2], total, timebase[2];
+    if (input_open(&in, demuxer, inputfile, fps, &total, timebase, use_mmap) < 0)
+        return EXIT_FAILURE;
+
+    FILE *out = NULL;
+    if (outputfile) {
+        static const uint8_t hdr[12] = {
+            'D', 'A', 'V', '1', 'D', 'I', 'D', 'X', SCAN_INDEX_VERSION, 0, 0, 0,
+        };
+        if (!(out = fopen(outputfile, "wb")) || fwrite(hdr, sizeof(hdr), 1, out) != 1) {
+            fprintf(stderr, "Failed to open %s for writing\n", outputfile);
+            if (out) fclose(out);
+            input_close(in);
+            return EXIT_FAILURE;
+        }
+    }
+
+    Dav1dSequenceHeader seq_hdr;
+    int have_seq_hdr = 0, res = 0;
+    // frame type stored in each reference slot, for shown existing frames
+    int ref_type[8] = { 0 };
+    unsigned n_tu = 0, n_entries = 0, n_key = 0, n_errors = 0;
+    // whether the current temporal unit was indexed or reported as broken
+    int tu_done = 1;
+    int64_t last_offset = -1;
+    Dav1dData data;
+    while (!input_read(in, &data)) {
+        // the annexb demuxer returns one OBU at a time
+        if (data.m.offset < 0 || data.m.offset != last_offset || !n_tu) {
+            if (limit && n_tu == limit) {
+                dav1d_data_unref(&data);
+                break;
+            }
+            if (!tu_done) {
+                fprintf(stderr, "No frame header in temporal unit at offset %" PRId64 "\n",
+                        last_offset);
+                n_errors++;
+            }
+            n_tu++;
+            tu_done = 0;
+        }
+        last_offset = data.m.offset;
+        const int64_t pts = data.m.timestamp != INT64_MIN ? data.m.timestamp :
+                                                            (int64_t) n_tu - 1;
+
+        if (!dav1d_parse_sequence_header(&seq_hdr, data.data, data.sz))
+            have_seq_hdr = 1;
+        if (!have_seq_hdr) {
+            tu_done = 1;
+            dav1d_data_unref(&data);
+            continue;
+        }
+
+        const uint8_t *ptr = data.data;
+        size_t sz = data.sz;
+        Dav1dFrameInfo info;
+        int len = 0;
+        while (sz && (len = dav1d_parse_frame_info(&info, &seq_hdr, ptr, sz)) > 0) {
+            ptr += len;
+            sz -= len;
+
+            int frame_type, flags;
+            if (info.show_existing_frame) {
+                frame_type = ref_type[info.existing_frame_idx];
+                flags = SCAN_FLAG_SHOW_EXISTING | SCAN_FLAG_SHOW_FRAME;
+                info.refresh_frame_flags = frame_type == DAV1D_FRAME_TYPE_KEY ? 0xff : 0;
+            } else {
+                frame_type = info.frame_type;
+                flags = (info.show_frame ? SCAN_FLAG_SHOW_FRAME : 0) |
+                        (info.showable_frame ? SCAN_FLAG_SHOWABLE : 0);
+                n_key += frame_type == DAV1D_FRAME_TYPE_KEY;
+            }
+            for (int i = 0; i < 8; i++)
+                if (info.refresh_frame_flags & (1 << i))
+                    ref_type[i] = frame_type;
+
+            if (verbose)
+                printf("%10" PRId64 " %8" PRId64 " %c%s%s refresh=0x%02x\n",
+                       data.m.offset, pts, frame_type_chars[frame_type],
+                       flags & SCAN_FLAG_SHOW_EXISTING ? " existing" : "",
+                       flags & SCAN_FLAG_SHOW_FRAME ? " shown" : "",
+                       info.refresh_frame_flags);
+            if (out && write_entry(out, data.m.offset, pts, frame_type, flags, &info)) {
+                fprintf(stderr, "Failed to write to %s\n", outputfile);
+                res = -1;
+                break;
+            }
+            n_entries++;
+            tu_done = 1;
+        }
+        if (!res && len < 0 && len != DAV1D_ERR(ENOENT)) {
+            // the rest of the temporal unit can't be indexed
+            fprintf(stderr, "Failed to parse frame header at offset %" PRId64 ": %s\n",
+                    data.m.offset + (int64_t) (ptr - data.data), strerror(DAV1D_ERR(len)));
+            n_errors++;
+            tu_done = 1;
+        }
+        dav1d_data_unref(&data);
+        if (res) break;
+    }
+    if (!res && !tu_done) {
+        fprintf(stderr, "No frame header in temporal unit at offset %" PRId64 "\n",
+                last_offset);
+        n_errors++;
+    }
+    input_close(in);
+    if (out && fclose(out)) {
+        fprintf(stderr, "Failed to write to %s\n", outputfile);
+        res = -1;
+    }
+
+    fprintf(stderr, "%u temporal units, %u frame headers, %u key frames\n",
+            n_tu, n_entries, n_key);
+    if (n_errors) {
+        // the index is incomplete
+        fprintf(stderr, "%u temporal units could not be fully indexed\n", n_errors);
+        res = -1;
+    }
+    return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
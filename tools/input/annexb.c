@@ -38,6 +38,7 @@
 #include "dav1d/headers.h"
 
 #include "input/demuxer.h"
+#include "input/mapping.h"
 #include "input/parse.h"
 
 // these functions are based on an implementation from FFmpeg, and relicensed
@@ -121,12 +122,15 @@ static int annexb_probe(const uint8_t *data) {
 
 typedef struct DemuxerPriv {
     FILE *f;
+    InputMapping *map;
     size_t temporal_unit_size;
     size_t frame_unit_size;
+    int64_t temporal_unit_offset;
 } AnnexbInputContext;
 
 static int annexb_open(AnnexbInputContext *const c, const char *const file,
-                       unsigned fps[2], unsigned *const num_frames, unsigned timebase[2])
+                       unsigned fps[2], unsigned *const num_frames, unsigned timebase[2],
+                       const int use_mmap)
 {
     int res;
     size_t len;
@@ -148,6 +152,7 @@ static int annexb_open(AnnexbInputContext *const c, const char *const file,
         fseeko(c->f, len, SEEK_CUR);
     }
     fseeko(c->f, 0, SEEK_SET);
+    c->map = use_mmap ? input_mapping_open(c->f) : NULL;
 
     return 0;
 }
@@ -157,6 +162,7 @@ static int annexb_read(AnnexbInputContext *const c, Dav1dData *const data) {
     int res;
 
     if (!c->temporal_unit_size) {
+        c->temporal_unit_offset = ftello(c->f);
         res = leb128(c->f, &c->temporal_unit_size);
         if (res < 0) return -1;
     }
@@ -167,20 +173,16 @@ static int annexb_read(AnnexbInputContext *const c, Dav1dData *const data) {
     }
     res = leb128(c->f, &len);
     if (res < 0 || (len + res) > c->frame_unit_size) return -1;
-    uint8_t *ptr = dav1d_data_create(data, len);
-    if (!ptr) return -1;
+    if (input_mapping_read(c->map, c->f, data, len)) return -1;
+    data->m.offset = c->temporal_unit_offset;
     c->temporal_unit_size -= len + res;
     c->frame_unit_size -= len + res;
-    if (fread(ptr, len, 1, c->f) != 1) {
-        fprintf(stderr, "Failed to read frame data: %s\n", strerror(errno));
-        dav1d_data_unref(data);
-        return -1;
-    }
 
     return 0;
 }
 
 static void annexb_close(AnnexbInputContext *const c) {
+    input_mapping_close(c->map);
     fclose(c->f);
 }
 
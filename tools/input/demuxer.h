@@ -37,7 +37,8 @@ typedef struct Demuxer {
     int probe_sz;
     int (*probe)(const uint8_t *data);
     int (*open)(DemuxerPriv *ctx, const char *filename,
-                unsigned fps[2], unsigned *num_frames, unsigned timebase[2]);
+                unsigned fps[2], unsigned *num_frames, unsigned timebase[2],
+                int use_mmap);
     int (*read)(DemuxerPriv *ctx, Dav1dData *data);
     int (*seek)(DemuxerPriv *ctx, uint64_t pts);
     void (*close)(DemuxerPriv *ctx);
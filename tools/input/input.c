@@ -56,7 +56,8 @@ static const Demuxer *const demuxers[] = {
 
 int input_open(DemuxerContext **const c_out,
                const char *const name, const char *const filename,
-               unsigned fps[2], unsigned *const num_frames, unsigned timebase[2])
+               unsigned fps[2], unsigned *const num_frames, unsigned timebase[2],
+               const int use_mmap)
 {
     const Demuxer *impl;
     DemuxerContext *c;
@@ -116,7 +117,8 @@ int input_open(DemuxerContext **const c_out,
     }
     c->impl = impl;
     c->data = (DemuxerPriv *) c->priv_data;
-    if ((res = impl->open(c->data, filename, fps, num_frames, timebase)) < 0) {
+    if ((res = impl->open(c->data, filename, fps, num_frames, timebase,
+                          use_mmap)) < 0) {
         free(c);
         return res;
     }
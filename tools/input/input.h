@@ -34,7 +34,8 @@ typedef struct DemuxerContext DemuxerContext;
 
 int input_open(DemuxerContext **const c_out,
                const char *const name, const char *const filename,
-               unsigned fps[2], unsigned *num_frames, unsigned timebase[2]);
+               unsigned fps[2], unsigned *num_frames, unsigned timebase[2],
+               int use_mmap);
 int input_read(DemuxerContext *ctx, Dav1dData *data);
 int input_seek(DemuxerContext *ctx, uint64_t pts);
 void input_close(DemuxerContext *ctx);
@@ -36,9 +36,11 @@
 #include <string.h>
 
 #include "input/demuxer.h"
+#include "input/mapping.h"
 
 typedef struct DemuxerPriv {
     FILE *f;
+    InputMapping *map;
     int broken;
     double timebase;
     uint64_t last_ts;
@@ -64,7 +66,8 @@ static int64_t rl64(const uint8_t *const p) {
 }
 
 static int ivf_open(IvfInputContext *const c, const char *const file,
-                    unsigned fps[2], unsigned *const num_frames, unsigned timebase[2])
+                    unsigned fps[2], unsigned *const num_frames, unsigned timebase[2],
+                    const int use_mmap)
 {
     uint8_t hdr[32];
 
@@ -128,6 +131,7 @@ static int ivf_open(IvfInputContext *const c, const char *const file,
 
     fseeko(c->f, 32, SEEK_SET);
     c->last_ts = 0;
+    c->map = use_mmap ? input_mapping_open(c->f) : NULL;
 
     return 0;
 }
@@ -151,17 +155,11 @@ static inline int ivf_read_header(IvfInputContext *const c, ptrdiff_t *const sz,
 }
 
 static int ivf_read(IvfInputContext *const c, Dav1dData *const buf) {
-    uint8_t *ptr;
     ptrdiff_t sz;
     int64_t off;
     uint64_t ts;
     if (ivf_read_header(c, &sz, &off, &ts)) return -1;
-    if (!(ptr = dav1d_data_create(buf, sz))) return -1;
-    if (fread(ptr, sz, 1, c->f) != 1) {
-        fprintf(stderr, "Failed to read frame data: %s\n", strerror(errno));
-        dav1d_data_unref(buf);
-        return -1;
-    }
+    if (input_mapping_read(c->map, c->f, buf, sz)) return -1;
     buf->m.offset = off;
     buf->m.timestamp = ts;
     c->last_ts = ts;
@@ -188,6 +186,7 @@ error:
 }
 
 static void ivf_close(IvfInputContext *const c) {
+    input_mapping_close(c->map);
     fclose(c->f);
 }
 
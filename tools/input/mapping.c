@@ -0,0 +1,157 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include "input/mapping.h"
+
+struct InputMapping {
+    const uint8_t *data;
+    size_t size;
+    atomic_int ref_cnt;
+#ifdef _WIN32
+    HANDLE handle;
+#endif
+};
+
+InputMapping *input_mapping_open(FILE *const f) {
+#ifdef _WIN32
+    const HANDLE file = (HANDLE) _get_osfhandle(_fileno(f));
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || GetFileType(file) != FILE_TYPE_DISK ||
+        !GetFileSizeEx(file, &size) || size.QuadPart <= 0 ||
+        (uint64_t) size.QuadPart > SIZE_MAX)
+    {
+        return NULL;
+    }
+
+    InputMapping *const map = malloc(sizeof(*map));
+    if (!map) return NULL;
+    map->size = (size_t) size.QuadPart;
+    map->handle = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!map->handle) {
+        free(map);
+        return NULL;
+    }
+    map->data = MapViewOfFile(map->handle, FILE_MAP_READ, 0, 0, 0);
+    if (!map->data) {
+        CloseHandle(map->handle);
+        free(map);
+        return NULL;
+    }
+#else
+    struct stat st;
+    if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+        (uint64_t) st.st_size > SIZE_MAX)
+    {
+        return NULL;
+    }
+
+    InputMapping *const map = malloc(sizeof(*map));
+    if (!map) return NULL;
+    map->size = (size_t) st.st_size;
+    void *const data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+    if (data == MAP_FAILED) {
+        free(map);
+        return NULL;
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(data, map->size, MADV_SEQUENTIAL);
+#endif
+    map->data = data;
+#endif
+    atomic_init(&map->ref_cnt, 1);
+
+    return map;
+}
+
+static void mapping_unref(InputMapping *const map) {
+    if (atomic_fetch_sub(&map->ref_cnt, 1) == 1) {
+#ifdef _WIN32
+        UnmapViewOfFile(map->data);
+        CloseHandle(map->handle);
+#else
+        munmap((void *) map->data, map->size);
+#endif
+        free(map);
+    }
+}
+
+static void mapping_free_callback(const uint8_t *const data, void *const cookie) {
+    mapping_unref(cookie);
+}
+
+int input_mapping_read(InputMapping *const map, FILE *const f,
+                       Dav1dData *const data, const size_t sz)
+{
+    if (!map) {
+        uint8_t *const ptr = dav1d_data_create(data, sz);
+        if (!ptr) return -1;
+        if (fread(ptr, sz, 1, f) != 1) {
+            fprintf(stderr, "Failed to read frame data: %s\n", strerror(errno));
+            dav1d_data_unref(data);
+            return -1;
+        }
+        return 0;
+    }
+
+    const int64_t off = ftello(f);
+    if (off < 0 || (uint64_t) off > map->size || sz > map->size - (size_t) off) {
+        fprintf(stderr, "Failed to read frame data: unexpected end of file\n");
+        return -1;
+    }
+    atomic_fetch_add(&map->ref_cnt, 1);
+    if (dav1d_data_wrap(data, map->data + off, sz, mapping_free_callback, map)) {
+        mapping_unref(map);
+        return -1;
+    }
+    if (fseeko(f, sz, SEEK_CUR)) {
+        fprintf(stderr, "Failed to read frame data: %s\n", strerror(errno));
+        dav1d_data_unref(data);
+        return -1;
+    }
+
+    return 0;
+}
+
+void input_mapping_close(InputMapping *const map) {
+    if (map) mapping_unref(map);
+}
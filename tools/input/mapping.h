@@ -0,0 +1,48 @@
+/*
+ * Copyright © 2024, VideoLAN and dav1d authors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this
+ *    list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DAV1D_INPUT_MAPPING_H
+#define DAV1D_INPUT_MAPPING_H
+
+#include <stdio.h>
+
+#include "data.h"
+
+// A read-only memory mapping of a whole input file. Frame data is handed to
+// the decoder as references into the mapping, which stays alive until both
+// the demuxer and all Dav1dData referencing it have released it.
+typedef struct InputMapping InputMapping;
+
+// Returns NULL if the file can't be mapped (e.g. pipes), in which case
+// input_mapping_read() falls back to regular reads.
+InputMapping *input_mapping_open(FILE *f);
+
+// Reads sz bytes at the current position of f into data, and advances f.
+int input_mapping_read(InputMapping *map, FILE *f, Dav1dData *data, size_t sz);
+
+void input_mapping_close(InputMapping *map);
+
+#endif /* DAV1D_INPUT_MAPPING_H */
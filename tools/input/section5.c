@@ -37,6 +37,7 @@
 #include "dav1d/headers.h"
 
 #include "input/demuxer.h"
+#include "input/mapping.h"
 #include "input/parse.h"
 
 #define PROBE_SIZE 2048
@@ -82,10 +83,12 @@ static int section5_probe(const uint8_t *data) {
 
 typedef struct DemuxerPriv {
     FILE *f;
+    InputMapping *map;
 } Section5InputContext;
 
 static int section5_open(Section5InputContext *const c, const char *const file,
-                         unsigned fps[2], unsigned *const num_frames, unsigned timebase[2])
+                         unsigned fps[2], unsigned *const num_frames, unsigned timebase[2],
+                         const int use_mmap)
 {
     if (!(c->f = fopen(file, "rb"))) {
         fprintf(stderr, "Failed to open %s: %s\n", file, strerror(errno));
@@ -119,12 +122,14 @@ static int section5_open(Section5InputContext *const c, const char *const file,
         fseeko(c->f, len, SEEK_CUR); // skip packet
     }
     fseeko(c->f, 0, SEEK_SET);
+    c->map = use_mmap ? input_mapping_open(c->f) : NULL;
 
     return 0;
 }
 
 static int section5_read(Section5InputContext *const c, Dav1dData *const data) {
     size_t total_bytes = 0;
+    const int64_t offset = ftello(c->f);
 
     for (int first = 1;; first = 0) {
         uint8_t byte[2];
@@ -159,18 +164,13 @@ static int section5_read(Section5InputContext *const c, Dav1dData *const data) {
     }
 
     fseeko(c->f, -(off_t)total_bytes, SEEK_CUR);
-    uint8_t *ptr = dav1d_data_create(data, total_bytes);
-    if (!ptr) return -1;
-    if (fread(ptr, total_bytes, 1, c->f) != 1) {
-        fprintf(stderr, "Failed to read frame data: %s\n", strerror(errno));
-        dav1d_data_unref(data);
-        return -1;
-    }
-
+    if (input_mapping_read(c->map, c->f, data, total_bytes)) return -1;
+    data->m.offset = offset;
     return 0;
 }
 
 static void section5_close(Section5InputContext *const c) {
+    input_mapping_close(c->map);
     fclose(c->f);
 }
 